@@ -0,0 +1,707 @@
+/*
+    Benchmark.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "ClockDiscipline.h"
+#include "CoarseClock.h"
+#include "CompletionQueue.h"
+#include "HybridClock.h"
+#include "MonotonicClock.h"
+#include "NtpCore.h"
+#include "NonceTable.h"
+#include "NtpEngine.h"
+#include "RefId.h"
+#include "Simulation.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace ntp_client::simulation;
+
+
+    constexpr Duration kConvergedError = std::chrono::milliseconds(1); // "Converged" = error below this, for good.
+
+
+    struct Result final
+    {
+        std::vector<Duration> errors_{};   // |selected offset - true offset|, one per poll round.
+        Duration converged_at_{ Duration::max() };
+        double cpu_ns_per_sample_{ 0 };
+    };
+
+
+    // Run one strategy over one scenario:
+    // kDepth = clock filter depth (1 = no filtering, just the latest sample).
+    // kSelect = intersection algorithm and weighted combine (false = plain mean of all servers).
+    template <size_t kDepth, bool kSelect>
+    Result Run(const Scenario& scenario)
+    {
+        Network network{ scenario };
+        std::vector<ClockFilter<kDepth>> filters(scenario.servers_.size());
+        std::vector<Duration> round_times{};
+        Result result{};
+
+        size_t samples{ 0 };
+        std::chrono::steady_clock::duration cpu_time{ 0 };
+
+        for (Duration now{ 0 }; now < scenario.duration_; now += scenario.poll_interval_) {
+            std::vector<std::optional<Sample>> round(filters.size());
+            for (size_t i = 0; i < filters.size(); ++i) {
+                round[i] = network.Exchange(i, now);
+            }
+
+            // (Only the algorithm itself is timed, not the network simulation.)
+            const auto start = std::chrono::steady_clock::now();
+
+            std::array<Candidate, kMaxCandidates> candidates{};
+            size_t count{ 0 };
+            for (size_t i = 0; i < filters.size(); ++i) {
+                if (round[i]) {
+                    filters[i].Add(*round[i]);
+                    ++samples;
+                }
+
+                if (const auto best = filters[i].Best(network.LocalTime(now)); best) {
+                    candidates[count++] = Candidate{ best->offset_, RootDistance(*best) };
+                }
+            }
+
+            std::optional<Duration> offset{};
+            if constexpr (kSelect) {
+                if (const auto selection = Select(std::span<const Candidate>(candidates.data(), count)); selection.valid_) {
+                    offset = selection.offset_;
+                }
+            } else if (count > 0) {
+                Duration sum{ 0 };
+                for (size_t i = 0; i < count; ++i) {
+                    sum += candidates[i].offset_;
+                }
+                offset = sum / static_cast<int64_t>(count);
+            }
+
+            cpu_time += std::chrono::steady_clock::now() - start;
+
+            if (offset) {
+                const Duration error = *offset - network.TrueOffset();
+                result.errors_.push_back(error < Duration(0) ? -error : error);
+                round_times.push_back(now);
+            }
+        }
+
+        // Convergence: The first round after which every later round stays below kConvergedError.
+        for (size_t i = result.errors_.size(); i > 0 && result.errors_[i - 1] < kConvergedError; --i) {
+            result.converged_at_ = round_times[i - 1];
+        }
+
+        result.cpu_ns_per_sample_ = samples > 0 ? static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(cpu_time).count()) / static_cast<double>(samples) : 0;
+        return result;
+    }
+
+
+    // Run the whole chain over one scenario: The filter8/select offset of every round goes to a ClockController that
+    // disciplines a simulated local clock (ClockDiscipline.h). The error is then the local clock's own error (clock minus
+    // true time) at each round, before that round's correction: What an application reading the clock would see.
+    // The local oscillator drifts by kLocalDriftPpm. The controller corrects phase only (no frequency loop), so the drift
+    // shows up as error regrown between rounds, and as filtered samples that age against the uncorrected oscillator.
+    Result RunDiscipline(const Scenario& scenario)
+    {
+        constexpr double kLocalDriftPpm = 1;                       // A temperature-compensated crystal.
+        constexpr Duration kUpdate = std::chrono::milliseconds(10); // How often ClockController::Update ends a slew.
+
+        Network network{ scenario };
+        SimulatedClock clock{ Network::kEpoch, scenario.local_error_ };
+        SimulatedClock free_running{ Network::kEpoch, scenario.local_error_ }; // The same oscillator, never corrected.
+        clock.SetDrift(kLocalDriftPpm);
+        free_running.SetDrift(kLocalDriftPpm);
+        ClockController<SimulatedClock> controller{ clock };
+
+        std::vector<ClockFilter<8>> filters(scenario.servers_.size());
+        std::vector<Duration> round_times{};
+        Result result{};
+
+        size_t samples{ 0 };
+        std::chrono::steady_clock::duration cpu_time{ 0 };
+
+        for (Duration now{ 0 }; now < scenario.duration_; now += scenario.poll_interval_) {
+            // (The clock's error is taken as constant over one exchange: 500 ppm of a round trip is microseconds.)
+            network.SetLocalError(clock.Error());
+
+            const Duration error = clock.Error();
+            result.errors_.push_back(error < Duration(0) ? -error : error);
+            round_times.push_back(now);
+
+            std::vector<std::optional<Sample>> round(filters.size());
+            for (size_t i = 0; i < filters.size(); ++i) {
+                round[i] = network.Exchange(i, now);
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+
+            // The filters keep samples across corrections, so they hold offsets against the uncorrected clock:
+            // Everything the controller has stepped or slewed so far is added back in, and taken out again to apply.
+            const Duration corrected = clock.Error() - free_running.Error();
+
+            std::array<Candidate, kMaxCandidates> candidates{};
+            size_t count{ 0 };
+            for (size_t i = 0; i < filters.size(); ++i) {
+                if (round[i]) {
+                    round[i]->offset_ += corrected;
+                    filters[i].Add(*round[i]);
+                    ++samples;
+                }
+
+                if (const auto best = filters[i].Best(network.LocalTime(now)); best) {
+                    candidates[count++] = Candidate{ best->offset_, RootDistance(*best) };
+                }
+            }
+
+            if (const auto selection = Select(std::span<const Candidate>(candidates.data(), count)); selection.valid_) {
+                controller.Apply(selection.offset_ - corrected);
+            }
+
+            cpu_time += std::chrono::steady_clock::now() - start;
+
+            // Let true time run to the next round.
+            for (Duration elapsed{ 0 }; elapsed < scenario.poll_interval_; elapsed += kUpdate) {
+                const Duration interval = std::min(kUpdate, scenario.poll_interval_ - elapsed);
+                clock.Advance(interval);
+                free_running.Advance(interval);
+                controller.Update();
+            }
+        }
+
+        // Convergence: The first round after which every later round stays below kConvergedError.
+        for (size_t i = result.errors_.size(); i > 0 && result.errors_[i - 1] < kConvergedError; --i) {
+            result.converged_at_ = round_times[i - 1];
+        }
+
+        result.cpu_ns_per_sample_ = samples > 0 ? static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(cpu_time).count()) / static_cast<double>(samples) : 0;
+        return result;
+    }
+
+
+    // Percentile of the (unsorted) errors, in microseconds.
+    double Percentile(std::vector<Duration> errors, const double percentile)
+    {
+        if (errors.empty()) {
+            return 0;
+        }
+
+        const auto rank = static_cast<size_t>(percentile / 100 * static_cast<double>(errors.size() - 1));
+        std::nth_element(errors.begin(), errors.begin() + rank, errors.end());
+        return static_cast<double>(errors[rank].count()) / 1000;
+    }
+
+
+    constexpr auto kClockRun = std::chrono::milliseconds(300); // Per API and thread count.
+
+
+    // Total calls per second of read() over threads threads, all running at once.
+    template <typename Read>
+    double Throughput(const unsigned threads, Read read)
+    {
+        std::atomic<bool> go{ false }, stop{ false };
+        std::atomic<uint64_t> calls{ 0 }, sink{ 0 };
+
+        std::vector<std::thread> workers{};
+        for (unsigned i = 0; i < threads; ++i) {
+            workers.emplace_back([&] {
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+
+                uint64_t count{ 0 }, sum{ 0 };
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (int k = 0; k < 64; ++k) {
+                        sum += read();
+                    }
+                    count += 64;
+                }
+
+                calls += count;
+                sink += sum; // (So the reads cannot be optimized away.)
+            });
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        std::this_thread::sleep_for(kClockRun);
+        stop = true;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(calls.load()) / elapsed.count();
+    }
+
+
+    // Thread counts: 1, 2, 4, ... up to the hardware threads (always included).
+    std::vector<unsigned> ThreadCounts()
+    {
+        const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned> counts{};
+        for (unsigned threads = 1; threads < hardware; threads *= 2) {
+            counts.push_back(threads);
+        }
+        counts.push_back(hardware);
+        return counts;
+    }
+
+
+    template <typename Read>
+    void ReportThroughput(std::ostream& out, const std::string_view api, const std::vector<unsigned>& thread_counts, Read read)
+    {
+        out << std::left << std::setw(24) << api << std::right << std::fixed << std::setprecision(1);
+        for (const unsigned threads : thread_counts) {
+            out << std::setw(12) << Throughput(threads, read) / 1e6;
+        }
+        out << '\n';
+    }
+
+
+    constexpr size_t kQueueCapacity = 4096;
+    constexpr size_t kQueueBatch = 64;
+    constexpr uint64_t kQueueItems = 2'000'000;   // Per throughput run (all producers combined).
+    constexpr size_t kWakeUpSamples = 1000;
+    constexpr auto kWakeUpGap = std::chrono::microseconds(200); // Between wake-up samples, so the consumer is asleep each time.
+
+    using LockFreeQueue = CompletionQueue<uint64_t, kQueueCapacity>;
+
+
+    // **** LockedQueue class ****
+
+    // The baseline: The same bounded queue interface, as a deque under a mutex with a condition variable.
+    class LockedQueue final
+    {
+    public:
+
+        [[nodiscard]] bool TryPush(const uint64_t value)
+        {
+            {
+                const std::lock_guard lock(mutex_);
+                if (items_.size() == kQueueCapacity) {
+                    return false;
+                }
+                items_.push_back(value);
+            }
+
+            ready_.notify_one();
+            return true;
+        }
+
+
+        size_t WaitPop(uint64_t* out, const size_t max_count)
+        {
+            std::unique_lock lock(mutex_);
+            ready_.wait(lock, [this] { return !items_.empty() || closed_; });
+
+            size_t popped{ 0 };
+            for (; popped < max_count && !items_.empty(); ++popped) {
+                out[popped] = items_.front();
+                items_.pop_front();
+            }
+
+            return popped;
+        }
+
+
+        void Close()
+        {
+            {
+                const std::lock_guard lock(mutex_);
+                closed_ = true;
+            }
+            ready_.notify_all();
+        }
+
+    private:
+
+        std::mutex mutex_{};
+        std::condition_variable ready_{};
+        std::deque<uint64_t> items_{};
+        bool closed_{ false };
+    };
+
+
+    // Items per second from producers threads to one consumer (which pops in batches).
+    template <typename Queue>
+    double QueueThroughput(const unsigned producers)
+    {
+        const auto queue = std::make_unique<Queue>();
+        const uint64_t per_producer = kQueueItems / producers;
+        std::atomic<uint64_t> sink{ 0 };
+
+        const auto start = std::chrono::steady_clock::now();
+
+        std::thread consumer([&] {
+            std::array<uint64_t, kQueueBatch> batch{};
+            uint64_t received{ 0 }, sum{ 0 };
+            while (received < per_producer * producers) {
+                const size_t count = queue->WaitPop(batch.data(), batch.size());
+                for (size_t i = 0; i < count; ++i) {
+                    sum += batch[i];
+                }
+                received += count;
+            }
+            sink = sum; // (So the pops cannot be optimized away.)
+        });
+
+        std::vector<std::thread> workers{};
+        for (unsigned i = 0; i < producers; ++i) {
+            workers.emplace_back([&] {
+                for (uint64_t k = 0; k < per_producer; ++k) {
+                    while (!queue->TryPush(k)) {
+                        std::this_thread::yield(); // Full: Let the consumer catch up.
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        consumer.join();
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(per_producer * producers) / elapsed.count();
+    }
+
+
+    // Time from a push to the return of the consumer's WaitPop(), with the consumer asleep before each push.
+    template <typename Queue>
+    std::vector<Duration> WakeUpLatencies()
+    {
+        using std::chrono::steady_clock;
+
+        const auto queue = std::make_unique<Queue>();
+        std::vector<Duration> latencies{};
+        latencies.reserve(kWakeUpSamples);
+
+        std::thread consumer([&] {
+            std::array<uint64_t, kQueueBatch> batch{};
+            while (queue->WaitPop(batch.data(), batch.size()) > 0) {
+                const auto now = static_cast<uint64_t>(steady_clock::now().time_since_epoch().count());
+                latencies.push_back(std::chrono::duration_cast<Duration>(steady_clock::duration(static_cast<steady_clock::rep>(now - batch[0]))));
+            }
+        });
+
+        for (size_t i = 0; i < kWakeUpSamples; ++i) {
+            std::this_thread::sleep_for(kWakeUpGap);
+            (void)queue->TryPush(static_cast<uint64_t>(steady_clock::now().time_since_epoch().count()));
+        }
+
+        std::this_thread::sleep_for(kWakeUpGap);
+        queue->Close();
+        consumer.join();
+        return latencies;
+    }
+
+
+    template <typename Queue>
+    void ReportQueue(std::ostream& out, const std::string_view queue, const std::vector<unsigned>& producer_counts)
+    {
+        out << std::left << std::setw(24) << queue << std::right << std::fixed << std::setprecision(1);
+        for (const unsigned producers : producer_counts) {
+            out << std::setw(12) << QueueThroughput<Queue>(producers) / 1e6;
+        }
+
+        const auto latencies = WakeUpLatencies<Queue>();
+        out << std::setw(12) << Percentile(latencies, 50) << std::setw(12) << Percentile(latencies, 99) << '\n';
+    }
+
+
+    constexpr size_t kExchanges = 500'000; // Per run.
+    constexpr size_t kExchangeRuns = 5;
+    constexpr Duration kEchoOffset = std::chrono::milliseconds(1);
+
+
+    // **** EchoTransport class ****
+
+    // A transport policy that answers in memory: Every request gets a valid stratum 2 reply (kEchoOffset ahead of
+    // the system clock), returned by the next Receive(). So the benchmark times the client, not the network.
+    class EchoTransport final
+    {
+    public:
+
+        bool Send(const Endpoint& to, const std::span<const uint8_t> datagram)
+        {
+            NtpMessage::Packet header{};
+            std::copy_n(datagram.begin(), NtpMessage::kSize, header.begin());
+            const NtpMessage request = NtpMessage::Decode(header);
+
+            NtpMessage reply{};
+            reply.version_ = 4;
+            reply.mode_ = 4; // Server
+            reply.stratum_ = 2;
+            reply.precision_ = static_cast<uint8_t>(SystemClock::kPrecision);
+            reply.orig_ = request.tx_;
+            reply.rx_ = Timestamp::FromUnixTime(clock_.Now() + kEchoOffset);
+            reply.tx_ = reply.rx_;
+
+            reply_ = reply.Encode();
+            from_ = to;
+            pending_ = true;
+            return true;
+        }
+
+
+        int Receive(const std::span<uint8_t> datagram, Endpoint& from)
+        {
+            if (!pending_) {
+                return -1;
+            }
+
+            pending_ = false;
+            std::copy(reply_.begin(), reply_.end(), datagram.begin());
+            from = from_;
+            return static_cast<int>(reply_.size());
+        }
+
+    private:
+
+        SystemClock clock_{};
+        NtpMessage::Packet reply_{};
+        Endpoint from_{};
+        bool pending_{ false };
+    };
+
+
+    // **** HandWrittenClient struct ****
+
+    // The same exchange written out by hand for this one configuration (one server, no authentication, system clock,
+    // depth 8), with the engine's bookkeeping (the table of requests in flight, the kiss-o'-death and timing loop
+    // tests) but no policy templates. Exchange() returns false if the reply was not accepted.
+    struct HandWrittenClient final
+    {
+        bool Exchange()
+        {
+            uint64_t nonce = NewNonce();
+            while (requests_.Find(nonce) != nullptr) {
+                nonce = NewNonce();
+            }
+
+            NtpMessage request{};
+            request.version_ = 4;
+            request.mode_ = 3; // Client
+            request.tx_ = Timestamp::FromUint64(nonce);
+
+            requests_.Insert(NonceTable<>::Request{ nonce, Timestamp::FromUnixTime(clock_.Now()), 0, 0 });
+            transport_.Send(server_, request.Encode());
+
+            std::array<uint8_t, NtpMessage::kSize> datagram{};
+            Endpoint from{};
+            if (transport_.Receive(datagram, from) < static_cast<int>(NtpMessage::kSize)) {
+                return false;
+            }
+
+            const Duration now = clock_.Now();
+            const NtpMessage reply = NtpMessage::Decode(datagram);
+            const NonceTable<>::Request* sent = requests_.Find(reply.orig_.ToUint64());
+            if (sent == nullptr || from != server_ || reply.mode_ != 4) {
+                return false;
+            }
+
+            const Timestamp t1 = sent->sent_;
+            requests_.Erase(sent->nonce_);
+            if (Kiss(reply) != KissCode::kNone || reply.leap_ == 3 || reply.stratum_ > 15 ||
+                (reply.stratum_ >= 2 && local_refids_.Contains(RefId(reply)))) {
+                return false;
+            }
+
+            Sample sample = MakeSample(t1, reply.rx_, reply.tx_, Timestamp::FromUnixTime(now),
+                static_cast<int8_t>(reply.precision_), SystemClock::kPrecision);
+            sample.root_delay_ = reply.RootDelay();
+            sample.root_dispersion_ = reply.RootDispersion();
+            filter_.Add(sample);
+            return true;
+        }
+
+
+        Endpoint server_{};
+        EchoTransport transport_{};
+        SystemClock clock_{};
+        ClockFilter<8> filter_{};
+        NonceTable<> requests_{};
+        RefIdTable<> local_refids_{};
+    };
+
+
+    // Nanoseconds per call of exchange() (which must return true): The best of kExchangeRuns runs of kExchanges calls,
+    // so a scheduler hiccup in one run does not decide the comparison.
+    template <typename Exchange>
+    double NanosecondsPerExchange(Exchange exchange)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (size_t run = 0; run < kExchangeRuns; ++run) {
+            size_t accepted{ 0 };
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < kExchanges; ++i) {
+                accepted += exchange() ? 1 : 0;
+            }
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            if (accepted != kExchanges) {
+                return 0;
+            }
+            best = std::min(best, elapsed.count() / static_cast<double>(kExchanges));
+        }
+
+        return best;
+    }
+
+
+    void Report(std::ostream& out, const std::string_view scenario, const std::string_view strategy, const Result& result)
+    {
+        out << std::left << std::setw(14) << scenario << std::setw(16) << strategy << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << Percentile(result.errors_, 50) << std::setw(12) << Percentile(result.errors_, 95)
+            << std::setw(12) << Percentile(result.errors_, 99);
+
+        if (result.converged_at_ == Duration::max()) {
+            out << std::setw(12) << "never";
+        } else {
+            out << std::setw(12) << std::chrono::duration_cast<std::chrono::seconds>(result.converged_at_).count();
+        }
+
+        out << std::setw(12) << result.cpu_ns_per_sample_ << '\n';
+    }
+
+}
+
+
+namespace ntp_client::benchmark
+{
+
+    // Offline time-accuracy benchmark.
+    void RunAccuracyBenchmark(std::ostream& out)
+    {
+        out << "time accuracy (offset error in us, convergence in s, cpu in ns/sample):\n";
+        out << std::left << std::setw(14) << "scenario" << std::setw(16) << "strategy" << std::right << std::setw(12) << "p50"
+            << std::setw(12) << "p95" << std::setw(12) << "p99" << std::setw(12) << "converged" << std::setw(12) << "cpu" << '\n';
+
+        for (const auto& scenario : Scenarios()) {
+            Report(out, scenario.name_, "latest/mean", Run<1, false>(scenario));
+            Report(out, scenario.name_, "latest/select", Run<1, true>(scenario));
+            Report(out, scenario.name_, "filter8/mean", Run<8, false>(scenario));
+            Report(out, scenario.name_, "filter8/select", Run<8, true>(scenario));
+            Report(out, scenario.name_, "discipline", RunDiscipline(scenario));
+        }
+    }
+
+
+
+    // Clock read throughput benchmark.
+    void RunClockBenchmark(std::ostream& out)
+    {
+        const auto thread_counts = ThreadCounts();
+
+        out << "clock reads (million calls/s, all threads combined; at 1 thread, 1000 / calls = ns per call):\n";
+        out << std::left << std::setw(24) << "api" << std::right;
+        for (const unsigned threads : thread_counts) {
+            out << std::setw(9) << threads << " thr";
+        }
+        out << '\n';
+
+        ReportThroughput(out, "SystemClock::Now", thread_counts, [] {
+            return static_cast<uint64_t>(SystemClock{}.Now().count());
+        });
+
+        const MonotonicClock& monotonic_clock = MonotonicClock::Global();
+        ReportThroughput(out, "MonotonicClock::Now", thread_counts, [&] {
+            return static_cast<uint64_t>(monotonic_clock.Now().count());
+        });
+
+        const CoarseClock coarse_clock{};
+        ReportThroughput(out, "CoarseNow", thread_counts, [] {
+            return static_cast<uint64_t>(CoarseNow().count());
+        });
+
+        HybridClock<> hybrid_clock{};
+        ReportThroughput(out, "HybridClock::Now", thread_counts, [&] {
+            return hybrid_clock.Now().value_;
+        });
+    }
+
+
+
+    // Completion queue benchmark.
+    void RunQueueBenchmark(std::ostream& out)
+    {
+        const auto producer_counts = ThreadCounts();
+
+        out << "completion queues (million items/s from N producers to 1 consumer; consumer wake-up latency in us):\n";
+        out << std::left << std::setw(24) << "queue" << std::right;
+        for (const unsigned producers : producer_counts) {
+            out << std::setw(9) << producers << " thr";
+        }
+        out << std::setw(12) << "wake p50" << std::setw(12) << "wake p99" << '\n';
+
+        ReportQueue<LockFreeQueue>(out, "CompletionQueue", producer_counts);
+        ReportQueue<LockedQueue>(out, "mutex + condvar", producer_counts);
+    }
+
+
+
+    // Policy overhead benchmark.
+    void RunEngineBenchmark(std::ostream& out)
+    {
+        const Endpoint server{ 0x0100007F, 0x7B00 }; // 127.0.0.1:123 (network byte order; never touched).
+
+        using Engine = ClientEngine<EchoTransport>;
+        Engine engine{};
+        engine.AddServer(server);
+
+        // The engine's data members, without the (empty) policy objects:
+        constexpr size_t kStateSize = sizeof(std::vector<Engine::PeerType>) + 2 * sizeof(RefIdTable<>) + sizeof(NonceTable<>) +
+            sizeof(SampleLog*) + sizeof(EngineCounters) + 2 * sizeof(Duration);
+
+        HandWrittenClient client{};
+        client.server_ = server;
+
+        out << "client engine (in-memory transport, ns per exchange: request, reply, validation, filter):\n";
+        out << std::left << std::setw(24) << "hand-written" << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << NanosecondsPerExchange([&] { return client.Exchange(); }) << '\n';
+        out << std::left << std::setw(24) << "ClientEngine" << std::right
+            << std::setw(12) << NanosecondsPerExchange([&] { return engine.Poll(0) && engine.Process() == 1; }) << '\n';
+        out << "policy state: " << static_cast<std::ptrdiff_t>(sizeof(Engine)) - static_cast<std::ptrdiff_t>(sizeof(EchoTransport) + kStateSize)
+            << " bytes (sizeof(ClientEngine) - its transport and data members: the clock and authentication policies)\n";
+    }
+
+}
@@ -0,0 +1,58 @@
+#ifndef AMITG_FC_BENCHMARK
+#define AMITG_FC_BENCHMARK
+
+/*
+    Benchmark.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <ostream>
+
+
+namespace ntp_client::benchmark
+{
+
+    // Offline time-accuracy benchmark:
+    // Runs every filter/selection strategy against every scenario of the simulation library (Simulation.h) and
+    // prints offset error percentiles, convergence time and CPU cost per sample.
+    void RunAccuracyBenchmark(std::ostream& out);
+
+
+    // Clock read throughput benchmark:
+    // Calls per second of each time API, from 1 thread up to one thread per hardware thread.
+    void RunClockBenchmark(std::ostream& out);
+
+
+    // Completion queue benchmark:
+    // Throughput (1 to N producer threads, one consumer) and consumer wake-up latency of CompletionQueue
+    // against a mutex-plus-condition-variable queue.
+    void RunQueueBenchmark(std::ostream& out);
+
+
+    // Policy overhead benchmark:
+    // Time per exchange of ClientEngine (default policies, an in-memory transport) against the same exchange written
+    // out by hand, and the bytes the empty policies add to the engine.
+    void RunEngineBenchmark(std::ostream& out);
+
+}
+
+
+#endif
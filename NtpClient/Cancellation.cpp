@@ -0,0 +1,153 @@
+/*
+    Cancellation.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "Cancellation.h"
+
+#include <algorithm>
+#include <climits> // For INT_MAX.
+#include <optional>
+
+
+namespace // (Anonymous namespace)
+{
+
+    // A loopback UDP socket that a stop request writes to, to wake a thread blocked in WSAPoll (the self-pipe trick:
+    // Winsock has no pipes). One per thread, reused by every wait on that thread.
+    class Waker final
+    {
+    public:
+
+        // Constructor:
+        Waker()
+        {
+            if (wsa_.Error() != 0) {
+                return;
+            }
+
+            address_.sin_family = AF_INET;
+            address_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t address_size = sizeof(address_);
+            u_long non_blocking = 1;
+
+            socket_ = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (socket_ != INVALID_SOCKET && (bind(socket_, reinterpret_cast<const sockaddr*>(&address_), sizeof(address_)) == SOCKET_ERROR ||
+                getsockname(socket_, reinterpret_cast<sockaddr*>(&address_), &address_size) == SOCKET_ERROR ||
+                ioctlsocket(socket_, FIONBIO, &non_blocking) == SOCKET_ERROR)) {
+                closesocket(socket_);
+                socket_ = INVALID_SOCKET;
+            }
+        }
+
+
+        // Destructor:
+        ~Waker()
+        {
+            if (socket_ != INVALID_SOCKET) {
+                closesocket(socket_);
+            }
+        }
+
+        Waker(const Waker&) = delete;
+        Waker& operator=(const Waker&) = delete;
+
+
+        // Make the socket readable. (Any thread.)
+        void Wake() const
+        {
+            const char byte{ 0 };
+            sendto(socket_, &byte, 1, 0, reinterpret_cast<const sockaddr*>(&address_), sizeof(address_));
+        }
+
+
+        // Discard wake-ups left over from earlier waits.
+        void Drain() const
+        {
+            char bytes[16]{};
+            while (recv(socket_, bytes, sizeof(bytes), 0) > 0) {
+            }
+        }
+
+
+        [[nodiscard]] SOCKET Handle() const { return socket_; }
+
+    private:
+
+        ntp_client::detail::WSA wsa_{};
+        SOCKET socket_{ INVALID_SOCKET };
+        sockaddr_in address_{};
+    };
+
+
+    constexpr int kStopCheckMs = 10; // Without a waker socket, how often a wait checks for a stop request.
+
+}
+
+
+namespace ntp_client
+{
+
+    // Wait until socket is readable, the timeout expires, or a stop is requested.
+    WaitResult WaitReadable(const SOCKET socket, const std::chrono::microseconds timeout, const std::stop_token& stop)
+    {
+        if (stop.stop_requested()) {
+            return WaitResult::kStopped;
+        }
+
+        const auto milliseconds = std::chrono::ceil<std::chrono::milliseconds>(std::max(timeout, std::chrono::microseconds(0))).count();
+        int timeout_ms = static_cast<int>(std::min<long long>(milliseconds, INT_MAX));
+
+        WSAPOLLFD descriptors[2]{};
+        descriptors[0].fd = socket;
+        descriptors[0].events = POLLRDNORM;
+        ULONG count{ 1 };
+
+        const Waker* wake{ nullptr };
+        const auto wake_up = [&wake] { wake->Wake(); };
+        std::optional<std::stop_callback<decltype(wake_up)>> callback{};
+
+        if (stop.stop_possible()) {
+            thread_local const Waker waker{}; // (Created on the first cancellable wait of each thread.)
+            wake = &waker;
+
+            if (wake->Handle() != INVALID_SOCKET) {
+                wake->Drain();
+                descriptors[1].fd = wake->Handle();
+                descriptors[1].events = POLLRDNORM;
+                count = 2;
+                callback.emplace(stop, wake_up); // (Runs right here if the stop was requested meanwhile.)
+            }
+            else {
+                timeout_ms = std::min(timeout_ms, kStopCheckMs); // No waker: Check for a stop request now and then.
+            }
+        }
+
+        const int ready = WSAPoll(descriptors, count, timeout_ms);
+
+        if (stop.stop_requested()) {
+            return WaitResult::kStopped;
+        }
+
+        return ready > 0 && (descriptors[0].revents & (POLLRDNORM | POLLERR)) != 0 ? WaitResult::kReadable : WaitResult::kTimeout;
+    }
+
+}
@@ -0,0 +1,65 @@
+#ifndef AMITG_FC_CANCELLATION
+#define AMITG_FC_CANCELLATION
+
+/*
+    Cancellation.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Cancellable waits: Every blocking query takes a std::stop_token (and most a deadline). A stop request wakes the
+// waiting thread at once, instead of at its next timeout, so the caller gets its thread (and the query's socket) back
+// immediately, whatever the network does.
+
+#include <chrono>
+#include <stop_token>
+
+#include "SocketApi.h"
+
+
+namespace ntp_client
+{
+
+    using Deadline = std::chrono::steady_clock::time_point;
+
+
+    enum class WaitResult { kReadable, kTimeout, kStopped };
+
+
+    // Wait until socket is readable, the timeout expires, or a stop is requested (which wakes the wait at once).
+    // Without a stop_token that can be stopped, this is a plain wait for the socket.
+    WaitResult WaitReadable(SOCKET socket, std::chrono::microseconds timeout, const std::stop_token& stop = {});
+
+
+    // Time left until deadline (0 if it has passed), for the waits above.
+    [[nodiscard]] inline std::chrono::microseconds TimeLeft(const Deadline deadline)
+    {
+        if (deadline == Deadline::max()) {
+            return std::chrono::microseconds::max();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        return deadline > now ? std::chrono::ceil<std::chrono::microseconds>(deadline - now) : std::chrono::microseconds(0);
+    }
+
+}
+
+
+#endif
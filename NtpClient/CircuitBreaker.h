@@ -0,0 +1,206 @@
+#ifndef AMITG_FC_CIRCUITBREAKER
+#define AMITG_FC_CIRCUITBREAKER
+
+/*
+    CircuitBreaker.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Circuit breakers: A server that stopped answering is not asked again on every call. After kThreshold failures in a
+// row its breaker opens, and calls fail at once (a hash lookup and an atomic load) for a backoff that doubles with
+// every further failure, up to a maximum. When the backoff expires, one caller is told to probe the server (half-open);
+// everyone else keeps failing fast until the probe succeeds (closing the breaker) or fails (reopening it, for longer).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <functional> // For std::hash.
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace ntp_client
+{
+
+    // **** BreakerOptions struct ****
+
+    struct BreakerOptions final
+    {
+        uint32_t threshold_{ 2 };                                   // Failures in a row that open the breaker.
+        std::chrono::milliseconds backoff_{ 1000 };                 // The first backoff...
+        std::chrono::milliseconds max_backoff_{ 5 * 60 * 1000 };    // ...doubled up to this.
+        size_t max_keys_{ 1024 };                                   // Failing keys tracked at most (see Record).
+    };
+
+
+    // **** CircuitBreaker class ****
+
+    // One breaker per key (a server's hostname). Thread-safe: A lookup takes a shared lock; the breaker's state is atomic.
+    // Only failing keys take memory: A success forgets the key (closed), and at max_keys_ the least useful states
+    // (closed, or past their backoff) are dropped first, then the one whose backoff ends soonest.
+    class CircuitBreaker final
+    {
+    public:
+
+        enum class Admission { kAllow, kReject, kProbe };
+
+        // Constructor:
+        explicit CircuitBreaker(const BreakerOptions& options = {}) : options_(options)
+        {
+
+        }
+
+
+        // May a call go to key's server? kProbe: Yes, as the (only) half-open probe, whose result must be recorded.
+        [[nodiscard]] Admission Admit(const std::string_view key)
+        {
+            const std::shared_ptr<State> state = Find(key);
+            if (state == nullptr || state->failures_.load(std::memory_order_relaxed) < options_.threshold_) {
+                return Admission::kAllow; // Closed.
+            }
+
+            if (Steady() < state->open_until_.load(std::memory_order_relaxed) || state->probing_.exchange(true)) {
+                return Admission::kReject; // Open, or half-open with the probe on its way.
+            }
+
+            return Admission::kProbe;
+        }
+
+
+        // Record the result of a call that was admitted. (Calls that gave up, e.g. were stopped, tell nothing.)
+        void Record(const std::string_view key, const bool success)
+        {
+            std::shared_ptr<State> state = Find(key);
+            if (success) {
+                if (state != nullptr) {
+                    std::unique_lock lock{ mutex_ };
+                    if (const auto found = states_.find(key); found != states_.end()) {
+                        states_.erase(found); // Closed.
+                    }
+                }
+                return;
+            }
+
+            if (state == nullptr) {
+                std::unique_lock lock{ mutex_ };
+                if (states_.size() >= options_.max_keys_ && states_.find(key) == states_.end()) {
+                    Evict();
+                }
+                state = states_.try_emplace(std::string(key), std::make_shared<State>()).first->second;
+            }
+
+            const uint32_t failures = state->failures_.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (failures >= options_.threshold_) {
+                state->open_until_.store(Steady() + Backoff(failures - options_.threshold_), std::memory_order_relaxed);
+            }
+            state->probing_ = false;
+        }
+
+
+        // Number of keys with a state (failing keys).
+        [[nodiscard]] size_t Size() const
+        {
+            std::shared_lock lock{ mutex_ };
+            return states_.size();
+        }
+
+    private:
+
+        struct State final
+        {
+            std::atomic<uint32_t> failures_{ 0 };   // In a row.
+            std::atomic<int64_t> open_until_{ 0 };  // Steady clock nanoseconds.
+            std::atomic<bool> probing_{ false };
+        };
+
+        // Heterogeneous lookup: Find a key without building a std::string.
+        struct Hash final
+        {
+            using is_transparent = void;
+            size_t operator()(const std::string_view text) const { return std::hash<std::string_view>{}(text); }
+        };
+
+
+        // (A shared pointer: The state stays valid for the caller even if Record drops it meanwhile.)
+        [[nodiscard]] std::shared_ptr<State> Find(const std::string_view key) const
+        {
+            std::shared_lock lock{ mutex_ };
+            const auto found = states_.find(key);
+            return found != states_.end() ? found->second : nullptr;
+        }
+
+
+        // Make room for one more state (the caller holds the unique lock): Drop the closed states and the expired ones
+        // without a probe on its way (the next failure opens them again), or else the one whose backoff ends soonest.
+        void Evict()
+        {
+            const int64_t now = Steady();
+            std::erase_if(states_, [this, now](const auto& entry) {
+                const State& state = *entry.second;
+                return state.failures_.load(std::memory_order_relaxed) < options_.threshold_ ||
+                    (state.open_until_.load(std::memory_order_relaxed) <= now && !state.probing_.load());
+            });
+
+            if (states_.size() >= options_.max_keys_ && !states_.empty()) {
+                states_.erase(std::min_element(states_.begin(), states_.end(), [](const auto& a, const auto& b) {
+                    return a.second->open_until_.load(std::memory_order_relaxed) < b.second->open_until_.load(std::memory_order_relaxed);
+                }));
+            }
+        }
+
+
+        // The backoff after the breaker opened and failed `reopened` probes since: Doubled each time, and jittered down
+        // by up to a half, so that processes that lost a server together do not probe it together.
+        [[nodiscard]] int64_t Backoff(const uint32_t reopened) const
+        {
+            const int64_t base = std::chrono::duration_cast<std::chrono::nanoseconds>(options_.backoff_).count();
+            const int64_t limit = std::chrono::duration_cast<std::chrono::nanoseconds>(options_.max_backoff_).count();
+            const int64_t backoff = std::min(base << std::min<uint32_t>(reopened, kMaxDoublings), limit);
+
+            thread_local std::minstd_rand random{ std::random_device{}() };
+            return backoff - std::uniform_int_distribution<int64_t>(0, backoff / 2)(random);
+        }
+
+
+        [[nodiscard]] static int64_t Steady()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+
+        static constexpr uint32_t kMaxDoublings = 24; // (Far past any sensible maximum, and far from overflow.)
+
+        BreakerOptions options_{};
+        mutable std::shared_mutex mutex_{};
+        std::unordered_map<std::string, std::shared_ptr<State>, Hash, std::equal_to<>> states_{};
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef AMITG_FC_CLOCKDISCIPLINE
+#define AMITG_FC_CLOCKDISCIPLINE
+
+/*
+    ClockDiscipline.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Clock step/slew controller: Applies measured offsets to a clock.
+// Small offsets are slewed (the clock runs slightly fast or slow until the offset is worked off), so time
+// never jumps; offsets beyond the step threshold are stepped, since slewing them would take too long.
+// The clock itself is a policy: SystemClockAdjuster (SystemClockAdjuster.h) for the real system clock,
+// SimulatedClock (below) for dry runs and tests.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <optional>
+
+#include "NtpCore.h"
+
+
+namespace ntp_client
+{
+
+    // **** DisciplineOptions struct ****
+
+    struct DisciplineOptions final
+    {
+        Duration step_threshold_{ std::chrono::milliseconds(128) }; // Larger offsets are stepped (the ntpd default).
+        double max_slew_ppm_{ 500 };                               // Maximum slew rate (the ntpd and adjtime limit).
+    };
+
+
+    // **** SimulatedClock class ****
+
+    // A clock adjuster policy that only pretends (dry run).
+    // It tracks the error of a simulated clock against a true time that the caller advances.
+    //
+    // A clock adjuster policy provides:
+    //   Duration Now();                // Current reading of the clock being disciplined.
+    //   bool Step(Duration correction); // Jump the clock by correction.
+    //   bool SetSlewRate(double ppm);   // Run the clock fast (ppm > 0) or slow (ppm < 0). 0 = nominal rate.
+    class SimulatedClock final
+    {
+    public:
+
+        explicit SimulatedClock(const Duration start = Duration(0), const Duration error = Duration(0)) : true_time_(start), error_(error)
+        {
+
+        }
+
+
+        [[nodiscard]] Duration Now() const { return true_time_ + error_; }
+
+        bool Step(const Duration correction)
+        {
+            error_ += correction;
+            ++steps_;
+            return true;
+        }
+
+        bool SetSlewRate(const double ppm)
+        {
+            slew_ppm_ = ppm;
+            return true;
+        }
+
+
+        // Let true time pass. The simulated clock gains (or loses) its slew rate (and its own drift) meanwhile.
+        void Advance(const Duration interval)
+        {
+            true_time_ += interval;
+            error_ += Duration(static_cast<int64_t>(static_cast<double>(interval.count()) * (slew_ppm_ + drift_ppm_) / 1e6));
+        }
+
+
+        void SetDrift(const double ppm) { drift_ppm_ = ppm; }
+
+        [[nodiscard]] Duration Error() const { return error_; }
+        [[nodiscard]] double SlewRate() const { return slew_ppm_; }
+        [[nodiscard]] size_t Steps() const { return steps_; }
+
+    private:
+
+        Duration true_time_{ 0 };
+        Duration error_{ 0 };     // Clock minus true time.
+        double slew_ppm_{ 0 };
+        double drift_ppm_{ 0 };   // Natural frequency error of the simulated oscillator.
+        size_t steps_{ 0 };
+    };
+
+
+    // **** ClockController class ****
+
+    template <typename ClockAdjuster>
+    class ClockController final
+    {
+    public:
+
+        enum class Action { kNone, kSlew, kStep, kFailed };
+
+
+        explicit ClockController(ClockAdjuster& clock, const DisciplineOptions& options = {}) : clock_(clock), options_(options)
+        {
+
+        }
+
+
+        // Apply a measured offset (server time minus local time).
+        // Steps if the offset exceeds the step threshold. Otherwise starts (or replaces) a slew that works off
+        // the offset at the maximum slew rate; Update() ends it once the offset has been absorbed.
+        Action Apply(const Duration offset)
+        {
+            const Duration magnitude = offset < Duration(0) ? -offset : offset;
+
+            if (magnitude > options_.step_threshold_) {
+                clock_.SetSlewRate(0);
+                slew_end_.reset();
+                return clock_.Step(offset) ? Action::kStep : Action::kFailed;
+            }
+
+            if (magnitude == Duration(0)) {
+                return Action::kNone;
+            }
+
+            // offset / rate = how long the clock has to run fast (or slow), as measured by the slewed clock itself:
+            const double rate = offset > Duration(0) ? options_.max_slew_ppm_ : -options_.max_slew_ppm_;
+            const auto duration = Duration(static_cast<int64_t>(static_cast<double>(magnitude.count()) * (1e6 + rate) / options_.max_slew_ppm_));
+
+            if (!clock_.SetSlewRate(rate)) {
+                return Action::kFailed;
+            }
+
+            slew_end_ = clock_.Now() + duration;
+            return Action::kSlew;
+        }
+
+
+        // Call periodically: Ends the slew once its duration has passed.
+        // The slew overshoots by up to max_slew_ppm_ times the interval between calls (0.5 ms per second at 500 ppm).
+        void Update()
+        {
+            if (slew_end_ && clock_.Now() >= *slew_end_) {
+                clock_.SetSlewRate(0);
+                slew_end_.reset();
+            }
+        }
+
+
+        [[nodiscard]] bool Slewing() const { return slew_end_.has_value(); }
+
+    private:
+
+        ClockAdjuster& clock_;
+        DisciplineOptions options_{};
+        std::optional<Duration> slew_end_{};
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,118 @@
+/*
+    CoarseClock.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "CoarseClock.h"
+
+#include <functional> // For std::cref.
+
+#include "SocketApi.h" // (For Windows.h, in the right order relative to Winsock.)
+
+
+namespace ntp_client
+{
+
+    // Constructor:
+    CoarseClock::CoarseClock(const std::chrono::milliseconds tick, const MonotonicClock& source)
+    {
+        Ticker& ticker = GetTicker();
+        const std::lock_guard lock(ticker.mutex_);
+        if (ticker.users_++ > 0) {
+            return; // Another instance started the ticker.
+        }
+
+        ticker.source_ = &source;
+        ticker.tick_ = tick;
+        ticker.stop_ = false;
+        time_.store(source.Now().count(), std::memory_order_relaxed); // Readable as soon as the constructor returns.
+        ticker.thread_ = std::thread(&CoarseClock::Run, std::cref(ticker));
+    }
+
+
+    // Destructor:
+    CoarseClock::~CoarseClock()
+    {
+        Ticker& ticker = GetTicker();
+        const std::lock_guard lock(ticker.mutex_);
+        if (--ticker.users_ > 0) {
+            return; // Other instances still use the ticker.
+        }
+
+        ticker.stop_ = true;
+        ticker.thread_.join();
+    }
+
+
+    // Whether the ticker runs.
+    bool CoarseClock::Running()
+    {
+        Ticker& ticker = GetTicker();
+        const std::lock_guard lock(ticker.mutex_);
+        return ticker.users_ > 0;
+    }
+
+
+    CoarseClock::Ticker& CoarseClock::GetTicker()
+    {
+        static Ticker ticker{};
+        return ticker;
+    }
+
+
+    // Store the time every tick until stopped.
+    void CoarseClock::Run(const Ticker& ticker)
+    {
+        const MonotonicClock& source = *ticker.source_;
+        const std::chrono::milliseconds tick = ticker.tick_;
+
+        // A periodic waitable timer: Sleep() and std::this_thread::sleep_for() wake at the system timer resolution
+        // (15.6 ms by default), a high-resolution timer (Windows 10 1803 and later) at the requested period.
+        HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (timer == nullptr) {
+            timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS); // Older Windows: Default resolution.
+        }
+
+        LARGE_INTEGER due_time{};
+        due_time.QuadPart = -static_cast<LONGLONG>(tick.count()) * 10'000; // Relative, in 100 ns units.
+        if (timer == nullptr || !SetWaitableTimer(timer, &due_time, static_cast<LONG>(tick.count()), nullptr, nullptr, FALSE)) {
+            if (timer != nullptr) {
+                CloseHandle(timer);
+            }
+            timer = nullptr;
+        }
+
+        while (!ticker.stop_) {
+            if (timer != nullptr) {
+                WaitForSingleObject(timer, INFINITE);
+            } else {
+                std::this_thread::sleep_for(tick);
+            }
+
+            time_.store(source.Now().count(), std::memory_order_relaxed);
+        }
+
+        if (timer != nullptr) {
+            CloseHandle(timer);
+        }
+    }
+
+}
@@ -0,0 +1,100 @@
+#ifndef AMITG_FC_COARSECLOCK
+#define AMITG_FC_COARSECLOCK
+
+/*
+    CoarseClock.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Coarse time for hot paths such as logging: A ticker thread stores the (monotonic, NTP-corrected) time into one
+// cache-line-padded word every millisecond, and a read is a single relaxed atomic load of that word: No clock call,
+// no seqlock retry loop, nothing written. The price is resolution: A read lags the true time by up to one tick.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <mutex>
+#include <thread>
+
+#include "MonotonicClock.h"
+#include "NtpCore.h"
+
+
+namespace ntp_client
+{
+
+    // **** CoarseClock class ****
+
+    // A reference to the ticker thread: The first instance starts it, the last one destroyed stops it, so any number of
+    // components may each hold one (create one before the first read, e.g. in main). The ticker runs with the tick and
+    // source of the instance that started it.
+    class CoarseClock final
+    {
+    public:
+
+        // Constructor: Starts ticking source every tick, unless the ticker already runs. source must outlive the clock.
+        explicit CoarseClock(std::chrono::milliseconds tick = std::chrono::milliseconds(1), const MonotonicClock& source = MonotonicClock::Global());
+
+        // Destructor: The last instance stops the ticker (the last time stored stays readable).
+        ~CoarseClock();
+
+        CoarseClock(const CoarseClock&) = delete;
+        CoarseClock& operator=(const CoarseClock&) = delete;
+
+
+        // Time since the unix epoch, up to one tick old (0 before any clock started). Any thread.
+        [[nodiscard]] static Duration Now() { return Duration(time_.load(std::memory_order_relaxed)); }
+
+
+        // Get Running: Whether the ticker runs (always, while an instance exists).
+        [[nodiscard]] static bool Running();
+
+    private:
+
+        static constexpr size_t kCacheLine = 64;
+
+        // The one ticker thread, and the number of instances that keep it running.
+        struct Ticker final
+        {
+            std::mutex mutex_{};
+            size_t users_{ 0 };
+            const MonotonicClock* source_{ nullptr };
+            std::chrono::milliseconds tick_{ 1 };
+            std::atomic<bool> stop_{ false };
+            std::thread thread_{};
+        };
+
+        static Ticker& GetTicker(); // (A function-local static: Ready for instances constructed during static initialization.)
+        static void Run(const Ticker& ticker);
+
+        alignas(kCacheLine) static inline std::atomic<int64_t> time_{ 0 }; // Read by every thread, written once per tick:
+                                                                           // Alone on its cache line, so nothing else invalidates it.
+    };
+
+
+    // Coarse time: See CoarseClock.
+    [[nodiscard]] inline Duration CoarseNow() { return CoarseClock::Now(); }
+
+}
+
+
+#endif
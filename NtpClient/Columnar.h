@@ -0,0 +1,261 @@
+#ifndef AMITG_FC_COLUMNAR
+#define AMITG_FC_COLUMNAR
+
+/*
+    Columnar.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Columnar binary files (in the spirit of Arrow/Parquet, without the dependency).
+// Each column is one contiguous little-endian array, aligned to 64 bytes, so a reader can memory-map the file and
+// scan a column in place (with SIMD). A footer at the end indexes the columns by name:
+//
+//      "NTPCOL01"                          8-byte magic
+//      column 0 data, padding to 64        raw array
+//      column 1 data, padding to 64
+//      ...
+//      ColumnEntry[column count]           footer index: name, type, offset, rows
+//      Trailer                             footer offset, column count, "NTPCOL01"
+//
+// Writing is a single pass of large unformatted writes (no per-value formatting), so it streams at disk speed.
+
+#include <algorithm>
+#include <array>
+#include <bit> // For std::endian.
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <cstring> // For std::memcpy.
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+namespace ntp_client
+{
+
+    // The file stores the arrays as they are in memory; every Windows target is little-endian.
+    static_assert(std::endian::native == std::endian::little, "Columnar files are little-endian.");
+
+
+    enum class ColumnType : uint8_t { kUint8 = 1, kInt8, kUint16, kInt16, kUint32, kInt32, kUint64, kInt64, kDouble };
+
+
+    template <typename T>
+    [[nodiscard]] constexpr ColumnType ColumnTypeOf()
+    {
+        if constexpr (std::is_same_v<T, uint8_t>) { return ColumnType::kUint8; }
+        else if constexpr (std::is_same_v<T, int8_t>) { return ColumnType::kInt8; }
+        else if constexpr (std::is_same_v<T, uint16_t>) { return ColumnType::kUint16; }
+        else if constexpr (std::is_same_v<T, int16_t>) { return ColumnType::kInt16; }
+        else if constexpr (std::is_same_v<T, uint32_t>) { return ColumnType::kUint32; }
+        else if constexpr (std::is_same_v<T, int32_t>) { return ColumnType::kInt32; }
+        else if constexpr (std::is_same_v<T, uint64_t>) { return ColumnType::kUint64; }
+        else if constexpr (std::is_same_v<T, int64_t>) { return ColumnType::kInt64; }
+        else {
+            static_assert(std::is_same_v<T, double>, "Unsupported column type.");
+            return ColumnType::kDouble;
+        }
+    }
+
+
+    // **** ColumnEntry struct ****
+
+    // One footer index entry.
+    struct ColumnEntry final
+    {
+        static constexpr size_t kMaxName = 23;
+
+        char name_[kMaxName + 1]{ 0 };  // Zero-terminated.
+        ColumnType type_{};
+        uint8_t reserved_[7]{ 0 };
+        uint64_t offset_{ 0 };           // From the start of the file.
+        uint64_t rows_{ 0 };
+    };
+
+    static_assert(sizeof(ColumnEntry) == 48);
+
+
+    // **** ColumnarTrailer struct ****
+
+    struct ColumnarTrailer final
+    {
+        uint64_t footer_offset_{ 0 };
+        uint32_t columns_{ 0 };
+        uint32_t reserved_{ 0 };
+        std::array<char, 8> magic_{};
+    };
+
+    static_assert(sizeof(ColumnarTrailer) == 24);
+
+    inline constexpr std::array<char, 8> kColumnarMagic{ 'N', 'T', 'P', 'C', 'O', 'L', '0', '1' };
+
+
+    // **** ColumnarWriter class ****
+
+    // Streams columns to a binary stream (open it with std::ios::binary). Call Finish() after the last column.
+    class ColumnarWriter final
+    {
+    public:
+
+        static constexpr size_t kAlignment = 64; // A cache line: Columns can be scanned with aligned vector loads.
+
+
+        // Constructor: Writes the leading magic.
+        explicit ColumnarWriter(std::ostream& stream) : stream_(stream)
+        {
+            Write(kColumnarMagic.data(), kColumnarMagic.size());
+        }
+
+
+        // Write one column. Names longer than ColumnEntry::kMaxName are truncated.
+        template <typename T>
+        void AddColumn(const std::string_view name, const std::span<const T> values)
+        {
+            Pad();
+
+            ColumnEntry entry{};
+            std::copy_n(name.begin(), std::min(name.size(), ColumnEntry::kMaxName), entry.name_);
+            entry.type_ = ColumnTypeOf<T>();
+            entry.offset_ = position_;
+            entry.rows_ = values.size();
+            entries_.push_back(entry);
+
+            Write(values.data(), values.size_bytes());
+        }
+
+        template <typename T>
+        void AddColumn(const std::string_view name, const std::vector<T>& values)
+        {
+            AddColumn(name, std::span<const T>(values));
+        }
+
+
+        // Write the footer index. Returns false if any write failed.
+        bool Finish()
+        {
+            Pad();
+
+            ColumnarTrailer trailer{};
+            trailer.footer_offset_ = position_;
+            trailer.columns_ = static_cast<uint32_t>(entries_.size());
+            trailer.magic_ = kColumnarMagic;
+
+            Write(entries_.data(), entries_.size() * sizeof(ColumnEntry));
+            Write(&trailer, sizeof(trailer));
+            stream_.flush();
+
+            return static_cast<bool>(stream_);
+        }
+
+    private:
+
+        void Write(const void* data, const size_t size)
+        {
+            stream_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            position_ += size;
+        }
+
+
+        void Pad()
+        {
+            static constexpr std::array<char, kAlignment> kZeros{};
+            Write(kZeros.data(), (kAlignment - position_ % kAlignment) % kAlignment);
+        }
+
+
+        std::ostream& stream_;
+        std::vector<ColumnEntry> entries_{};
+        uint64_t position_{ 0 };
+    };
+
+
+    // **** ColumnarReader class ****
+
+    // Reads a columnar file in place, typically from a memory-mapped view: Columns are returned as spans into the
+    // file, without copying. The file must stay mapped while the spans are used.
+    class ColumnarReader final
+    {
+    public:
+
+        // Constructor: Validates the magic and the footer index. Valid() reports the result.
+        explicit ColumnarReader(const std::span<const std::byte> file) : file_(file)
+        {
+            ColumnarTrailer trailer{};
+            if (file.size() < kColumnarMagic.size() + sizeof(trailer) ||
+                std::memcmp(file.data(), kColumnarMagic.data(), kColumnarMagic.size()) != 0) {
+                return;
+            }
+
+            std::memcpy(&trailer, file.data() + file.size() - sizeof(trailer), sizeof(trailer));
+            const uint64_t footer_size = static_cast<uint64_t>(trailer.columns_) * sizeof(ColumnEntry);
+            if (trailer.magic_ != kColumnarMagic || trailer.footer_offset_ > file.size() - sizeof(trailer) ||
+                footer_size != file.size() - sizeof(trailer) - trailer.footer_offset_) {
+                return;
+            }
+
+            entries_.resize(trailer.columns_);
+            std::memcpy(entries_.data(), file.data() + trailer.footer_offset_, footer_size);
+            for (auto& entry : entries_) {
+                entry.name_[ColumnEntry::kMaxName] = 0; // (Names come from the file: Terminate them whatever it holds.)
+            }
+            valid_ = true;
+        }
+
+
+        [[nodiscard]] bool Valid() const { return valid_; }
+
+        [[nodiscard]] std::span<const ColumnEntry> Columns() const { return entries_; }
+
+
+        // Get a column by name. Returns an empty span if there is no such column, or if its type is not T.
+        template <typename T>
+        [[nodiscard]] std::span<const T> Column(const std::string_view name) const
+        {
+            for (const auto& entry : entries_) {
+                if (name != entry.name_ || entry.type_ != ColumnTypeOf<T>()) {
+                    continue;
+                }
+
+                // (Rows against the room left, not rows * sizeof(T) against it: The product can wrap around.)
+                if (entry.offset_ > file_.size() || entry.rows_ > (file_.size() - entry.offset_) / sizeof(T) ||
+                    reinterpret_cast<uintptr_t>(file_.data() + entry.offset_) % alignof(T) != 0) {
+                    return {}; // Corrupt, or the file is not mapped at an aligned address.
+                }
+
+                return std::span<const T>(reinterpret_cast<const T*>(file_.data() + entry.offset_), entry.rows_);
+            }
+
+            return {};
+        }
+
+    private:
+
+        std::span<const std::byte> file_{};
+        std::vector<ColumnEntry> entries_{};
+        bool valid_{ false };
+    };
+
+}
+
+
+#endif
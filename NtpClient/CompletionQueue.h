@@ -0,0 +1,249 @@
+#ifndef AMITG_FC_COMPLETIONQUEUE
+#define AMITG_FC_COMPLETIONQUEUE
+
+/*
+    CompletionQueue.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <atomic>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <type_traits>
+#include <utility>
+
+
+namespace ntp_client
+{
+
+    // **** CompletionQueue class ****
+
+    // Bounded, lock-free queue used to hand query completions from the I/O thread to application threads.
+    // It is a sequence-numbered ring (D. Vyukov's bounded MPMC design), so the same type serves as
+    // MPSC (many producers, one consumer) and SPMC (one producer, many consumers).
+    // Every slot carries a sequence number that tells producers and consumers whether the slot is free
+    // or full for the current lap, so neither side ever takes a lock.
+    // Consumers may block in WaitPop(). Producers only pay for a wake-up (a notify call) when a consumer
+    // is actually sleeping, so the non-blocking fast path stays a handful of atomic operations.
+    template <typename T, size_t kCapacity>
+    class CompletionQueue final
+    {
+        static_assert(kCapacity >= 2 && (kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of two.");
+        static_assert(std::is_nothrow_move_assignable_v<T> && std::is_default_constructible_v<T>,
+            "Completions are moved in and out of preallocated slots.");
+
+    public:
+
+        // Constructor:
+        CompletionQueue()
+        {
+            for (size_t i = 0; i < kCapacity; ++i) {
+                slots_[i].sequence_.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        CompletionQueue(const CompletionQueue&) = delete;
+        CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+
+        // Push a single completion.
+        // Return false if the queue is full (the caller decides whether to drop, retry or spin).
+        [[nodiscard]] bool TryPush(T value)
+        {
+            if (!Enqueue(std::move(value))) {
+                return false;
+            }
+
+            Wake();
+            return true;
+        }
+
+
+        // Push up to count completions, waking sleeping consumers at most once.
+        // Return the number of completions actually pushed (less than count if the queue filled up).
+        size_t PushBatch(T* values, const size_t count)
+        {
+            size_t pushed{ 0 };
+            while (pushed < count && Enqueue(std::move(values[pushed]))) {
+                ++pushed;
+            }
+
+            if (pushed > 0) {
+                Wake();
+            }
+
+            return pushed;
+        }
+
+
+        // Pop a single completion.
+        // Return false if the queue is empty.
+        [[nodiscard]] bool TryPop(T& value)
+        {
+            return Dequeue(value);
+        }
+
+
+        // Pop up to max_count completions into out.
+        // Return the number of completions popped. Draining in batches amortizes the cache-line transfers.
+        size_t PopBatch(T* out, const size_t max_count)
+        {
+            size_t popped{ 0 };
+            while (popped < max_count && Dequeue(out[popped])) {
+                ++popped;
+            }
+
+            return popped;
+        }
+
+
+        // Pop up to max_count completions, sleeping while the queue is empty.
+        // Return the number of completions popped (at least 1, unless Close() was called).
+        size_t WaitPop(T* out, const size_t max_count)
+        {
+            for (;;) {
+                // Read the signal before looking at the ring, so a push that lands in between
+                // changes the signal and the wait below returns immediately.
+                const uint32_t signal = signal_.load(std::memory_order_acquire);
+
+                if (const size_t popped = PopBatch(out, max_count); popped > 0) {
+                    return popped;
+                }
+
+                if (closed_.load(std::memory_order_acquire)) {
+                    return 0;
+                }
+
+                sleepers_.fetch_add(1, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst); // Pairs with the fence in Wake().
+                if (Empty() && !closed_.load(std::memory_order_acquire)) {
+                    signal_.wait(signal, std::memory_order_acquire);
+                }
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                woken_.store(false, std::memory_order_seq_cst); // Before the next look at the ring: Later pushes wake us again.
+            }
+        }
+
+
+        // Release all consumers blocked in WaitPop(). Later pushes are still accepted.
+        void Close()
+        {
+            closed_.store(true, std::memory_order_release);
+            signal_.fetch_add(1, std::memory_order_release);
+            signal_.notify_all();
+        }
+
+
+        // Approximate emptiness (exact only when no other thread is operating on the queue).
+        [[nodiscard]] bool Empty() const
+        {
+            return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+        }
+
+
+        [[nodiscard]] static constexpr size_t Capacity() { return kCapacity; }
+
+    private:
+
+        static constexpr size_t kCacheLine = 64; // (std::hardware_destructive_interference_size is not ABI-stable.)
+
+        struct Slot final
+        {
+            std::atomic<size_t> sequence_{ 0 };
+            T value_{};
+        };
+
+
+        bool Enqueue(T&& value)
+        {
+            size_t position = tail_.load(std::memory_order_relaxed);
+
+            for (;;) {
+                Slot& slot = slots_[position & (kCapacity - 1)];
+                const size_t sequence = slot.sequence_.load(std::memory_order_acquire);
+                const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+
+                if (difference == 0) {
+                    // The slot is free for this lap. Claim it (another producer may have beaten us to it):
+                    if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        slot.value_ = std::move(value);
+                        slot.sequence_.store(position + 1, std::memory_order_release); // <-- Publish to consumers.
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false; // Full: the slot still holds last lap's completion.
+                } else {
+                    position = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+
+        bool Dequeue(T& value)
+        {
+            size_t position = head_.load(std::memory_order_relaxed);
+
+            for (;;) {
+                Slot& slot = slots_[position & (kCapacity - 1)];
+                const size_t sequence = slot.sequence_.load(std::memory_order_acquire);
+                const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+
+                if (difference == 0) {
+                    if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        value = std::move(slot.value_);
+                        slot.sequence_.store(position + kCapacity, std::memory_order_release); // <-- Hand the slot back to producers (next lap).
+                        return true;
+                    }
+                } else if (difference < 0) {
+                    return false; // Empty.
+                } else {
+                    position = head_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+
+        // Wake sleeping consumers, but only if there are any, and only once until one of them runs.
+        void Wake()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst); // Pairs with the fence in WaitPop().
+            if (sleepers_.load(std::memory_order_seq_cst) > 0 && !woken_.exchange(true, std::memory_order_seq_cst)) {
+                signal_.fetch_add(1, std::memory_order_release);
+                signal_.notify_all();
+            }
+        }
+
+
+        // Producer and consumer indices live on separate cache lines to avoid false sharing.
+        alignas(kCacheLine) std::atomic<size_t> head_{ 0 };
+        alignas(kCacheLine) std::atomic<size_t> tail_{ 0 };
+        alignas(kCacheLine) std::atomic<uint32_t> signal_{ 0 };
+        std::atomic<uint32_t> sleepers_{ 0 };
+        std::atomic<bool> woken_{ false }; // A wake-up is on its way (so the pushes until the consumers run skip the notify call).
+        std::atomic<bool> closed_{ false };
+        alignas(kCacheLine) std::array<Slot, kCapacity> slots_{};
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,420 @@
+/*
+    ControlServer.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "ControlServer.h"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <sstream>
+
+
+namespace ntp_client
+{
+
+    namespace
+    {
+        // Mode 6 message: A 12-byte header, then up to 468 bytes of data (padded to 32 bits).
+        //
+        //       0                   1                   2                   3
+        //       0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |LI | VN  | 6   |R|E|M| OpCode  |          Sequence             |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |            Status             |        Association ID         |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |            Offset             |            Count              |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        constexpr size_t kHeaderSize = 12;
+        constexpr size_t kMaxData = 468;
+        constexpr uint8_t kModeControl = 6;
+        constexpr uint8_t kVersion = 2; // What ntpq sends.
+
+        constexpr uint8_t kResponseBit = 0x80, kErrorBit = 0x40, kMoreBit = 0x20, kOpcodeMask = 0x1f;
+
+        // Error codes (the high byte of the status word of an error response).
+        constexpr uint8_t kErrorFormat = 2, kErrorOpcode = 3, kErrorAssociation = 4;
+
+
+        struct ControlHeader final
+        {
+            uint8_t flags_{ 0 };        // R, E and M bits.
+            uint8_t opcode_{ 0 };
+            uint16_t sequence_{ 0 };
+            uint16_t status_{ 0 };
+            uint16_t association_{ 0 };
+            uint16_t offset_{ 0 };
+            uint16_t count_{ 0 };
+        };
+
+
+        void PutBigEndian16(uint8_t* data, const uint16_t value)
+        {
+            data[0] = static_cast<uint8_t>(value >> 8);
+            data[1] = static_cast<uint8_t>(value);
+        }
+
+        uint16_t GetBigEndian16(const uint8_t* data)
+        {
+            return static_cast<uint16_t>(data[0] << 8 | data[1]);
+        }
+
+
+        // Encode a header and its data (padded to 32 bits). Returns the datagram size.
+        size_t Encode(const ControlHeader& header, const std::string_view data, std::array<uint8_t, kHeaderSize + kMaxData>& datagram)
+        {
+            datagram.fill(0);
+            datagram[0] = static_cast<uint8_t>(kVersion << 3 | kModeControl);
+            datagram[1] = static_cast<uint8_t>(header.flags_ | (header.opcode_ & kOpcodeMask));
+            PutBigEndian16(&datagram[2], header.sequence_);
+            PutBigEndian16(&datagram[4], header.status_);
+            PutBigEndian16(&datagram[6], header.association_);
+            PutBigEndian16(&datagram[8], header.offset_);
+            PutBigEndian16(&datagram[10], static_cast<uint16_t>(data.size()));
+            std::copy(data.begin(), data.end(), &datagram[kHeaderSize]);
+
+            return kHeaderSize + (data.size() + 3) / 4 * 4;
+        }
+
+
+        // Decode a header. Returns false if the datagram is not a well-formed mode 6 message.
+        bool Decode(const uint8_t* datagram, const size_t size, ControlHeader& header)
+        {
+            if (size < kHeaderSize || (datagram[0] & 0x07) != kModeControl) {
+                return false;
+            }
+
+            header.flags_ = datagram[1] & ~kOpcodeMask;
+            header.opcode_ = datagram[1] & kOpcodeMask;
+            header.sequence_ = GetBigEndian16(&datagram[2]);
+            header.status_ = GetBigEndian16(&datagram[4]);
+            header.association_ = GetBigEndian16(&datagram[6]);
+            header.offset_ = GetBigEndian16(&datagram[8]);
+            header.count_ = GetBigEndian16(&datagram[10]);
+
+            return header.count_ <= size - kHeaderSize;
+        }
+
+
+        std::string AddressText(const uint32_t address)
+        {
+            in_addr in{};
+            in.s_addr = address;
+            char text[INET_ADDRSTRLEN]{ 0 };
+            inet_ntop(AF_INET, &in, text, sizeof(text));
+            return text;
+        }
+
+
+        // Nanoseconds as milliseconds, the unit ntpq displays.
+        std::string Milliseconds(const int64_t nanoseconds)
+        {
+            std::ostringstream text;
+            text << std::fixed << std::setprecision(6) << static_cast<double>(nanoseconds) / 1e6;
+            return text.str();
+        }
+
+
+        // System status word: Leap indicator (3 = not synchronized) and clock source (6 = NTP).
+        uint16_t SystemStatusWord(const EngineStatus& status)
+        {
+            return static_cast<uint16_t>((status.valid_ != 0 ? 0 : 3) << 14 | 6 << 8);
+        }
+
+
+        // Peer status word: Configured, reachable, and the selection code (4 = candidate).
+        uint16_t PeerStatusWord(const PeerStatus& peer)
+        {
+            return static_cast<uint16_t>(0x8000 | (peer.reach_ != 0 ? 0x1000 : 0) | (peer.samples_ > 0 ? 4 << 8 : 0));
+        }
+
+
+        std::string SystemVariables(const EngineStatus& status, const uint64_t version)
+        {
+            std::ostringstream text;
+            text << "version=\"NtpClient\", leap=" << (status.valid_ != 0 ? 0 : 3) << ", offset=" << Milliseconds(status.offset_)
+                << ", peers=" << status.peer_count_ << ", survivors=" << status.survivors_
+                << ", sent=" << status.counters_.sent_ << ", received=" << status.counters_.received_
+                << ", accepted=" << status.counters_.accepted_ << ", rejected=" << status.counters_.rejected_
+                << ", kisses=" << status.counters_.kisses_ << ", loops=" << status.counters_.loops_
+                << ", snapshot=" << version << ", snapshot_time=" << status.time_;
+            return text.str();
+        }
+
+
+        std::string PeerVariables(const PeerStatus& peer)
+        {
+            std::ostringstream text;
+            if (peer.reference_ != 0) {
+                text << "srcadr=REFCLK";
+            }
+            else {
+                text << "srcadr=" << AddressText(peer.endpoint_.address_) << ", srcport=" << ntohs(peer.endpoint_.port_);
+            }
+
+            text << ", stratum=" << int{ peer.stratum_ } << ", reach=0x" << std::hex << std::setw(2) << std::setfill('0') << int{ peer.reach_ }
+                << std::dec << ", samples=" << peer.samples_ << ", offset=" << Milliseconds(peer.offset_)
+                << ", delay=" << Milliseconds(peer.delay_) << ", dispersion=" << Milliseconds(peer.dispersion_)
+                << ", jitter=" << Milliseconds(peer.jitter_) << ", rootdelay=" << Milliseconds(peer.root_delay_)
+                << ", rootdisp=" << Milliseconds(peer.root_dispersion_) << ", refid=" << RefIdText(peer.refid_, peer.stratum_)
+                << ", denied=" << int{ peer.denied_ };
+            return text.str();
+        }
+    }
+
+
+    // Constructor:
+    ControlServer::ControlServer(const Seqlock<EngineStatus>& status, const uint16_t port) : status_(status)
+    {
+        if (wsa_.Error() != 0) {
+            error_ = wsa_.Error();
+            return;
+        }
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Local queries only.
+        address.sin_port = htons(port);
+        socklen_t address_size = sizeof(address);
+
+        socket_ = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (socket_ == INVALID_SOCKET || bind(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+            getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &address_size) == SOCKET_ERROR) {
+            error_ = WSAGetLastError();
+            return;
+        }
+
+        port_ = ntohs(address.sin_port);
+        thread_ = std::thread(&ControlServer::Run, this);
+    }
+
+
+    // Destructor:
+    ControlServer::~ControlServer()
+    {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        if (socket_ != INVALID_SOCKET) {
+            closesocket(socket_);
+        }
+    }
+
+
+    // Answer queries until stopped.
+    void ControlServer::Run()
+    {
+        constexpr int kPollTimeoutMs = 100; // How quickly the destructor's stop request is noticed.
+
+        std::array<uint8_t, kHeaderSize + kMaxData> datagram{};
+
+        while (!stop_) {
+            WSAPOLLFD descriptor{};
+            descriptor.fd = socket_;
+            descriptor.events = POLLRDNORM;
+            if (WSAPoll(&descriptor, 1, kPollTimeoutMs) <= 0) {
+                continue;
+            }
+
+            sockaddr_in client = {};
+            socklen_t client_size = sizeof(client);
+            const int bytes_received = recvfrom(socket_, reinterpret_cast<char*>(datagram.data()), static_cast<int>(datagram.size()), 0,
+                reinterpret_cast<sockaddr*>(&client), &client_size);
+
+            ControlHeader request{};
+            if (bytes_received == SOCKET_ERROR || !Decode(datagram.data(), static_cast<size_t>(bytes_received), request) ||
+                (request.flags_ & kResponseBit) != 0) {
+                continue;
+            }
+
+            // Answer from the latest snapshot (never from the engine itself):
+            const EngineStatus status = status_.Read();
+            const uint64_t version = status_.Version();
+
+            ControlHeader response{};
+            response.flags_ = kResponseBit;
+            response.opcode_ = request.opcode_;
+            response.sequence_ = request.sequence_;
+            response.association_ = request.association_;
+
+            std::string data{};
+            uint8_t error{ 0 };
+
+            if (request.opcode_ == static_cast<uint8_t>(ControlOpcode::kReadStatus)) {
+                if (request.association_ != 0) {
+                    error = kErrorAssociation;
+                }
+                else {
+                    response.status_ = SystemStatusWord(status);
+                    for (uint32_t i = 0; i < status.peer_count_; ++i) {
+                        std::array<uint8_t, 4> entry{};
+                        PutBigEndian16(&entry[0], static_cast<uint16_t>(i + 1));
+                        PutBigEndian16(&entry[2], PeerStatusWord(status.peers_[i]));
+                        data.append(entry.begin(), entry.end());
+                    }
+                }
+            }
+            else if (request.opcode_ == static_cast<uint8_t>(ControlOpcode::kReadVariables)) {
+                if (request.association_ == 0) {
+                    response.status_ = SystemStatusWord(status);
+                    data = SystemVariables(status, version);
+                }
+                else if (request.association_ <= status.peer_count_) {
+                    response.status_ = PeerStatusWord(status.peers_[request.association_ - 1]);
+                    data = PeerVariables(status.peers_[request.association_ - 1]);
+                }
+                else {
+                    error = kErrorAssociation;
+                }
+            }
+            else {
+                error = kErrorOpcode;
+            }
+
+            if (error != 0) {
+                response.flags_ |= kErrorBit;
+                response.status_ = static_cast<uint16_t>(error << 8);
+                data.clear();
+            }
+
+            // Send the data in fragments of up to kMaxData bytes (at least one, even if empty):
+            size_t offset{ 0 };
+            do {
+                const size_t count = std::min(kMaxData, data.size() - offset);
+                ControlHeader fragment = response;
+                fragment.offset_ = static_cast<uint16_t>(offset);
+                if (offset + count < data.size()) {
+                    fragment.flags_ |= kMoreBit;
+                }
+
+                const size_t size = Encode(fragment, std::string_view(data).substr(offset, count), datagram);
+                sendto(socket_, reinterpret_cast<const char*>(datagram.data()), static_cast<int>(size), 0,
+                    reinterpret_cast<const sockaddr*>(&client), client_size);
+                offset += count;
+            } while (offset < data.size());
+
+            answered_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+
+    // Constructor:
+    ControlClient::ControlClient(const uint16_t port, const std::chrono::milliseconds timeout) :
+        server_{ htonl(INADDR_LOOPBACK), htons(port) }, timeout_(timeout)
+    {
+
+    }
+
+
+    // Association IDs.
+    std::optional<std::vector<uint16_t>> ControlClient::Associations()
+    {
+        const auto data = Query(ControlOpcode::kReadStatus, 0);
+        if (!data) {
+            return std::nullopt;
+        }
+
+        std::vector<uint16_t> associations{};
+        for (size_t i = 0; i + 4 <= data->size(); i += 4) {
+            associations.push_back(GetBigEndian16(reinterpret_cast<const uint8_t*>(data->data() + i)));
+        }
+
+        return associations;
+    }
+
+
+    // Variables of an association.
+    std::optional<std::string> ControlClient::Variables(const uint16_t association)
+    {
+        return Query(ControlOpcode::kReadVariables, association);
+    }
+
+
+    // Send a request and reassemble the response fragments.
+    std::optional<std::string> ControlClient::Query(const ControlOpcode opcode, const uint16_t association)
+    {
+        if (transport_.Error() != 0) {
+            return std::nullopt;
+        }
+
+        ControlHeader request{};
+        request.opcode_ = static_cast<uint8_t>(opcode);
+        request.sequence_ = ++sequence_;
+        request.association_ = association;
+
+        std::array<uint8_t, kHeaderSize + kMaxData> datagram{};
+        const size_t size = Encode(request, {}, datagram);
+        if (!transport_.Send(server_, std::span<const uint8_t>(datagram.data(), size))) {
+            return std::nullopt;
+        }
+
+        std::string data{};
+        std::vector<bool> covered{};             // The bytes that arrived so far (a fragment may arrive twice).
+        size_t received{ 0 }, total{ SIZE_MAX }; // Total is known once the last fragment (M bit clear) arrives.
+
+        const auto deadline = std::chrono::steady_clock::now() + timeout_;
+        for (auto now = std::chrono::steady_clock::now(); now < deadline && received < total; now = std::chrono::steady_clock::now()) {
+            if (!transport_.Wait(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now))) {
+                continue;
+            }
+
+            Endpoint from{};
+            ControlHeader response{};
+            for (int bytes_received; (bytes_received = transport_.Receive(datagram, from)) >= 0;) {
+                if (!(from == server_) || !Decode(datagram.data(), static_cast<size_t>(bytes_received), response) ||
+                    (response.flags_ & kResponseBit) == 0 || response.sequence_ != request.sequence_ || response.opcode_ != request.opcode_) {
+                    continue;
+                }
+
+                if ((response.flags_ & kErrorBit) != 0) {
+                    return std::nullopt;
+                }
+
+                const size_t end = response.offset_ + response.count_;
+                if (data.size() < end) {
+                    data.resize(end);
+                    covered.resize(end, false);
+                }
+
+                std::copy_n(&datagram[kHeaderSize], response.count_, data.begin() + response.offset_);
+                for (size_t i = response.offset_; i < end; ++i) {
+                    received += covered[i] ? 0 : 1;
+                    covered[i] = true;
+                }
+
+                if ((response.flags_ & kMoreBit) == 0) {
+                    total = response.offset_ + response.count_;
+                }
+            }
+        }
+
+        if (received < total) {
+            return std::nullopt;
+        }
+
+        return data;
+    }
+
+}
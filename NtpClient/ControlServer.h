@@ -0,0 +1,132 @@
+#ifndef AMITG_FC_CONTROLSERVER
+#define AMITG_FC_CONTROLSERVER
+
+/*
+    ControlServer.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Control and status channel: NTP mode 6 (RFC 1305, appendix B; the protocol ntpq speaks) on a loopback UDP socket.
+// The polling thread publishes EngineStatus snapshots to a Seqlock; the control server answers queries from its own
+// thread, reading the latest snapshot. Monitoring therefore never takes a lock the polling path needs.
+//
+// Supported requests:
+//   Read status (opcode 1), association 0: The association IDs (peer index + 1) and their peer status words.
+//   Read variables (opcode 2), association 0: System variables (selection, counters); association n: Peer n's variables.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "NtpEngine.h"
+#include "Seqlock.h"
+#include "SocketApi.h"
+#include "UdpTransport.h"
+
+
+namespace ntp_client
+{
+
+    enum class ControlOpcode : uint8_t { kReadStatus = 1, kReadVariables = 2 };
+
+
+    // **** ControlServer class ****
+
+    class ControlServer final
+    {
+    public:
+
+        // Constructor: Serves the snapshots in status on 127.0.0.1:port (ntpq queries port 123; 0 = any free port).
+        // status must outlive the server.
+        ControlServer(const Seqlock<EngineStatus>& status, uint16_t port);
+
+        // Destructor:
+        ~ControlServer();
+
+        ControlServer(const ControlServer&) = delete;
+        ControlServer& operator=(const ControlServer&) = delete;
+
+
+        // The bound port (host byte order).
+        [[nodiscard]] uint16_t Port() const { return port_; }
+
+        // Number of requests answered so far.
+        [[nodiscard]] size_t Answered() const { return answered_.load(std::memory_order_relaxed); }
+
+
+        // Get Error: 0 if the socket is bound.
+        int Error() const { return error_; }
+
+    private:
+
+        void Run();
+
+        const Seqlock<EngineStatus>& status_;
+        detail::WSA wsa_{};
+        SOCKET socket_{ INVALID_SOCKET };
+        uint16_t port_{ 0 };
+        std::atomic<bool> stop_{ false };
+        std::atomic<size_t> answered_{ 0 };
+        std::thread thread_{};
+        int error_{ 0 };
+    };
+
+
+    // **** ControlClient class ****
+
+    // Queries a control server on 127.0.0.1 (or an ntpd that allows local mode 6 queries).
+    class ControlClient final
+    {
+    public:
+
+        // Constructor:
+        explicit ControlClient(uint16_t port, std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+
+        // Association IDs. Returns nothing on timeout or error.
+        std::optional<std::vector<uint16_t>> Associations();
+
+
+        // Variables of an association (0 = system variables), as "name=value, ..." text. Returns nothing on timeout or error.
+        std::optional<std::string> Variables(uint16_t association);
+
+
+        // Get Error: 0 if the socket is usable.
+        int Error() const { return transport_.Error(); }
+
+    private:
+
+        std::optional<std::string> Query(ControlOpcode opcode, uint16_t association);
+
+        UdpTransport transport_{};
+        Endpoint server_{};
+        std::chrono::milliseconds timeout_{ 1000 };
+        uint16_t sequence_{ 0 };
+    };
+
+}
+
+
+#endif
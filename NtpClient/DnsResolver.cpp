@@ -0,0 +1,422 @@
+/*
+    DnsResolver.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "DnsResolver.h"
+
+#include <iphlpapi.h> // For GetNetworkParams.
+#include <algorithm>
+#include <cctype> // For std::tolower.
+#include <cstring> // For memcpy.
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+#include "NonceTable.h" // For NewNonce.
+
+// GetNetworkParams (the system DNS server list) is part of the IP Helper API.
+#pragma comment(lib, "Iphlpapi.lib")
+
+
+namespace // (Anonymous namespace)
+{
+
+    constexpr size_t kMaxMessageSize = 512; // Classic DNS over UDP limit (no EDNS0).
+    constexpr size_t kHeaderSize = 12;
+    constexpr uint16_t kTypeA = 1, kTypeClassIn = 1;
+    constexpr auto kServerListLifetime = std::chrono::seconds(60); // How long the system DNS server is cached.
+
+
+    // The name without the root label's dot, if it is fully qualified ("time.google.com." -> "time.google.com").
+    std::string_view WithoutRootDot(const std::string_view hostname)
+    {
+        return hostname.size() > 1 && hostname.back() == '.' ? hostname.substr(0, hostname.size() - 1) : hostname;
+    }
+
+
+    // Append a 16-bit value in network byte order.
+    void Put16(std::vector<uint8_t>& buffer, const uint16_t value)
+    {
+        buffer.push_back(static_cast<uint8_t>(value >> 8));
+        buffer.push_back(static_cast<uint8_t>(value & 0xFF));
+    }
+
+
+    // Read a 16-bit value in network byte order.
+    uint16_t Get16(const uint8_t* data)
+    {
+        return static_cast<uint16_t>(data[0] << 8 | data[1]);
+    }
+
+
+    // Encode a recursive A query:
+    // Header (ID, flags = RD, QDCOUNT = 1), then the question (QNAME as length-prefixed labels, QTYPE, QCLASS).
+    // Returns an empty buffer if the name is not encodable (empty label, label longer than 63 bytes).
+    std::vector<uint8_t> EncodeQuery(const std::string_view fqdn, const uint16_t id)
+    {
+        const std::string_view hostname = WithoutRootDot(fqdn);
+
+        std::vector<uint8_t> buffer{};
+        buffer.reserve(kHeaderSize + hostname.size() + 6);
+
+        Put16(buffer, id);
+        Put16(buffer, 0x0100); // Flags: Standard query, recursion desired.
+        Put16(buffer, 1);      // QDCOUNT
+        Put16(buffer, 0);      // ANCOUNT
+        Put16(buffer, 0);      // NSCOUNT
+        Put16(buffer, 0);      // ARCOUNT
+
+        size_t label_start{ 0 };
+        while (label_start < hostname.size()) {
+            size_t label_end = hostname.find('.', label_start);
+            if (label_end == std::string_view::npos) {
+                label_end = hostname.size();
+            }
+
+            const size_t length = label_end - label_start;
+            if (length == 0 || length > 63) {
+                return {};
+            }
+
+            buffer.push_back(static_cast<uint8_t>(length));
+            buffer.insert(buffer.end(), hostname.begin() + label_start, hostname.begin() + label_end);
+            label_start = label_end + 1;
+        }
+        buffer.push_back(0); // Root label.
+
+        Put16(buffer, kTypeA);
+        Put16(buffer, kTypeClassIn);
+
+        return buffer;
+    }
+
+
+    // Skip a (possibly compressed) domain name starting at offset.
+    // Returns the offset just past the name, or 0 if the name runs past the end of the message.
+    size_t SkipName(const uint8_t* message, const size_t size, size_t offset)
+    {
+        while (offset < size) {
+            const uint8_t length = message[offset];
+
+            if (length == 0) {
+                return offset + 1;
+            }
+
+            if ((length & 0xC0) == 0xC0) { // Compression pointer (2 bytes). The name ends here.
+                return offset + 2 <= size ? offset + 2 : 0;
+            }
+
+            offset += 1 + length;
+        }
+
+        return 0;
+    }
+
+
+    // Compare the (uncompressed) question name at offset against hostname, case-insensitively (ASCII, as DNS does).
+    bool QuestionMatches(const uint8_t* message, const size_t size, size_t offset, const std::string_view hostname)
+    {
+        std::string name{};
+        while (offset < size && message[offset] != 0) {
+            const uint8_t length = message[offset];
+            if ((length & 0xC0) != 0 || offset + 1 + length > size) {
+                return false;
+            }
+
+            if (!name.empty()) {
+                name.push_back('.');
+            }
+            name.append(reinterpret_cast<const char*>(message + offset + 1), length);
+            offset += 1 + length;
+        }
+
+        const std::string_view expected = WithoutRootDot(hostname);
+        return std::equal(name.begin(), name.end(), expected.begin(), expected.end(), [](const char a, const char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+    }
+
+
+    // The first (IPv4) DNS server configured on the system, or nothing.
+    // GetNetworkParams reads the adapter configuration, so its answer is kept for kServerListLifetime: Every query of
+    // GetTime constructs a resolver.
+    std::optional<in_addr> SystemDnsServer()
+    {
+        static std::mutex mutex{};
+        static std::optional<in_addr> server{};
+        static std::chrono::steady_clock::time_point expiry{};
+
+        const std::lock_guard lock(mutex);
+        const auto now = std::chrono::steady_clock::now();
+        if (now < expiry) {
+            return server;
+        }
+        expiry = now + kServerListLifetime;
+
+        // GetNetworkParams needs a buffer large enough for FIXED_INFO plus the chained server list.
+        // The first call reports the required size.
+        ULONG size{ 0 };
+        std::vector<uint8_t> buffer{};
+        if (GetNetworkParams(nullptr, &size) == ERROR_BUFFER_OVERFLOW) {
+            buffer.resize(size);
+        }
+
+        in_addr address{};
+        const auto info = reinterpret_cast<FIXED_INFO*>(buffer.data());
+        if (!buffer.empty() && GetNetworkParams(info, &size) == ERROR_SUCCESS &&
+            inet_pton(AF_INET, info->DnsServerList.IpAddress.String, &address) == 1) {
+            server = address;
+        } else {
+            server.reset();
+        }
+
+        return server;
+    }
+
+
+    // Extract the first A record from the answer section.
+    // Recursive servers put the CNAME chain and the final A record in the same answer section, so the
+    // first A record is the address of the queried name.
+    // Returns the IPv4 address in network byte order, 0 if there is none.
+    uint32_t FirstAddress(const uint8_t* message, const size_t size)
+    {
+        const uint16_t question_count = Get16(message + 4), answer_count = Get16(message + 6);
+
+        size_t offset = kHeaderSize;
+        for (uint16_t i = 0; i < question_count; ++i) {
+            if (offset = SkipName(message, size, offset); offset == 0 || offset + 4 > size) {
+                return 0;
+            }
+            offset += 4; // QTYPE + QCLASS
+        }
+
+        for (uint16_t i = 0; i < answer_count; ++i) {
+            if (offset = SkipName(message, size, offset); offset == 0 || offset + 10 > size) {
+                return 0;
+            }
+
+            const uint16_t type = Get16(message + offset), type_class = Get16(message + offset + 2),
+                data_length = Get16(message + offset + 8);
+            offset += 10; // TYPE + CLASS + TTL + RDLENGTH
+
+            if (offset + data_length > size) {
+                return 0;
+            }
+
+            if (type == kTypeA && type_class == kTypeClassIn && data_length == 4) {
+                uint32_t address{ 0 };
+                memcpy(&address, message + offset, sizeof(address)); // Already in network byte order.
+                return address;
+            }
+
+            offset += data_length;
+        }
+
+        return 0;
+    }
+
+}
+
+
+namespace ntp_client
+{
+
+    // Constructor:
+    DnsResolver::DnsResolver()
+    {
+        if (const auto server = SystemDnsServer(); server) {
+            server_address_.sin_family = AF_INET;
+            server_address_.sin_addr = *server;
+            server_address_.sin_port = htons(53);
+            Open();
+        } else {
+            error_ = -1; // No usable (IPv4) DNS server configured.
+        }
+    }
+
+
+    // Constructor:
+    DnsResolver::DnsResolver(const char* server_ip, const uint16_t port)
+    {
+        if (inet_pton(AF_INET, server_ip, &server_address_.sin_addr) == 1) {
+            server_address_.sin_family = AF_INET;
+            server_address_.sin_port = htons(port);
+            Open();
+        } else {
+            error_ = -1;
+        }
+    }
+
+
+    // Destructor:
+    DnsResolver::~DnsResolver()
+    {
+        if (socket_ != INVALID_SOCKET) {
+            closesocket(socket_);
+        }
+    }
+
+
+    // Create the non-blocking UDP socket.
+    void DnsResolver::Open()
+    {
+        if (wsa_.Error() != 0) {
+            error_ = wsa_.Error();
+            return;
+        }
+
+        socket_ = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        u_long non_blocking{ 1 };
+        if (socket_ == INVALID_SOCKET || ioctlsocket(socket_, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+            error_ = WSAGetLastError();
+        }
+    }
+
+
+    // Send (or resend) the query for one hostname.
+    void DnsResolver::Send(const std::string& hostname, const Query& query)
+    {
+        if (const auto buffer = EncodeQuery(hostname, query.id_); !buffer.empty()) {
+            if (sendto(socket_, reinterpret_cast<const char*>(buffer.data()), static_cast<int>(buffer.size()), 0,
+                reinterpret_cast<const sockaddr*>(&server_address_), sizeof(server_address_)) == SOCKET_ERROR) {
+                [[maybe_unused]] const auto error{ WSAGetLastError() }; // For debug. (The query simply times out.)
+            }
+        }
+    }
+
+
+    // Read every reply that is already queued on the socket (without blocking).
+    void DnsResolver::Drain(const std::vector<std::string>& hostnames, std::vector<Query>& queries, std::vector<DnsAnswer>& answers, size_t& pending)
+    {
+        uint8_t message[kMaxMessageSize];
+        sockaddr_in from{};
+
+        for (;;) {
+            socklen_t from_size = sizeof(from);
+            const int bytes_received = recvfrom(socket_, reinterpret_cast<char*>(message), sizeof(message), 0,
+                reinterpret_cast<sockaddr*>(&from), &from_size);
+
+            if (bytes_received == SOCKET_ERROR) {
+                // WSAEWOULDBLOCK: Nothing left to read.
+                // WSAECONNRESET: An ICMP port unreachable from an earlier send. Windows reports it on the next
+                // recvfrom; the datagrams behind it are still readable.
+                if (WSAGetLastError() == WSAECONNRESET) {
+                    continue;
+                }
+                return;
+            }
+
+            const auto size = static_cast<size_t>(bytes_received);
+            if (size < kHeaderSize || from.sin_addr.s_addr != server_address_.sin_addr.s_addr || from.sin_port != server_address_.sin_port) {
+                continue; // Not a DNS reply from our server.
+            }
+
+            const uint16_t id = Get16(message), flags = Get16(message + 2);
+            if ((flags & 0x8000) == 0) {
+                continue; // Not a response.
+            }
+
+            for (size_t i = 0; i < queries.size(); ++i) {
+                if (queries[i].done_ || queries[i].id_ != id || !QuestionMatches(message, size, kHeaderSize, hostnames[i])) {
+                    continue;
+                }
+
+                // RCODE 0 = No error. Anything else (NXDOMAIN, SERVFAIL, ...) is a final negative answer.
+                answers[i].address_ = (flags & 0x000F) == 0 ? FirstAddress(message, size) : 0;
+                queries[i].done_ = true;
+                --pending;
+                break;
+            }
+        }
+    }
+
+
+    // Resolve all hostnames concurrently.
+    std::vector<DnsAnswer> DnsResolver::Resolve(const std::vector<std::string>& hostnames, const std::chrono::milliseconds timeout, const std::stop_token& stop)
+    {
+        std::vector<DnsAnswer> answers(hostnames.size());
+        std::vector<Query> queries(hostnames.size());
+        size_t pending{ 0 };
+
+        for (size_t i = 0; i < hostnames.size(); ++i) {
+            answers[i].hostname_ = hostnames[i];
+
+            // Dotted-decimal names need no query:
+            if (in_addr address{}; inet_pton(AF_INET, hostnames[i].c_str(), &address) == 1) {
+                answers[i].address_ = address.s_addr;
+                queries[i].done_ = true;
+            } else if (error_ != 0) {
+                queries[i].done_ = true;
+            } else {
+                queries[i].id_ = static_cast<uint16_t>(NewNonce()); // (Each ID from the cryptographic nonce stream: Seeing some predicts none of the others.)
+                ++pending;
+            }
+        }
+
+        // Fire all queries back to back. The answers are collected below, in whatever order they arrive.
+        for (size_t i = 0; i < hostnames.size(); ++i) {
+            if (!queries[i].done_) {
+                Send(hostnames[i], queries[i]);
+            }
+        }
+
+        const auto start = std::chrono::steady_clock::now(), deadline = start + timeout, retransmit_time = start + timeout / 2;
+        bool retransmitted{ false };
+
+        while (pending > 0) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                break;
+            }
+
+            if (!retransmitted && now >= retransmit_time) {
+                retransmitted = true;
+                for (size_t i = 0; i < hostnames.size(); ++i) {
+                    if (!queries[i].done_) {
+                        Send(hostnames[i], queries[i]);
+                    }
+                }
+            }
+
+            const auto wake_time = retransmitted ? deadline : retransmit_time;
+            const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(wake_time - now);
+
+            // Wait until the socket is readable, or until the next retransmit / the deadline (or a stop request):
+            if (const WaitResult result = WaitReadable(socket_, wait, stop); result == WaitResult::kReadable) {
+                Drain(hostnames, queries, answers, pending);
+            }
+            else if (result == WaitResult::kStopped) {
+                break;
+            }
+        }
+
+        return answers;
+    }
+
+
+    // Resolve a single hostname.
+    uint32_t DnsResolver::Resolve(const char* hostname, const std::chrono::milliseconds timeout, const std::stop_token& stop)
+    {
+        return Resolve(std::vector<std::string>{ hostname }, timeout, stop).front().address_;
+    }
+
+}
@@ -0,0 +1,109 @@
+#ifndef AMITG_FC_DNSRESOLVER
+#define AMITG_FC_DNSRESOLVER
+
+/*
+    DnsResolver.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "Cancellation.h"
+#include "SocketApi.h"
+
+
+namespace ntp_client
+{
+
+    // **** DnsAnswer struct ****
+
+    struct DnsAnswer final
+    {
+        std::string hostname_{};
+        uint32_t address_{ 0 }; // IPv4 address, network byte order. 0 = Not resolved (timeout, NXDOMAIN, etc.).
+    };
+
+
+    // **** DnsResolver class ****
+
+    // Non-blocking stub resolver (RFC 1035).
+    // Sends an A query for every name at once over a single non-blocking UDP socket, then collects the
+    // answers as they arrive. A batch of N names therefore costs one round trip to the recursive resolver,
+    // instead of N blocking gethostbyname() calls.
+    // Replies are matched by query ID (random, per query) and question name, and must come from the configured server.
+    // Names may be fully qualified (with the root label's trailing dot).
+    class DnsResolver final
+    {
+    public:
+
+        // Constructor: Uses the first DNS server configured on the system.
+        DnsResolver();
+
+        // Constructor: Uses a specific DNS server (for example, a local fake server in tests).
+        DnsResolver(const char* server_ip, uint16_t port = 53);
+
+        // Destructor:
+        ~DnsResolver();
+
+        DnsResolver(const DnsResolver&) = delete;
+        DnsResolver& operator=(const DnsResolver&) = delete;
+
+
+        // Resolve all hostnames concurrently.
+        // Returns one answer per hostname, in the same order. Unanswered queries are retransmitted
+        // once halfway to the timeout, and are reported as unresolved once the timeout expires (or a stop is requested).
+        std::vector<DnsAnswer> Resolve(const std::vector<std::string>& hostnames, std::chrono::milliseconds timeout, const std::stop_token& stop = {});
+
+
+        // Resolve a single hostname.
+        // Returns the IPv4 address in network byte order, 0 on error, timeout or stop.
+        uint32_t Resolve(const char* hostname, std::chrono::milliseconds timeout, const std::stop_token& stop = {});
+
+
+        // Get Error: 0 if the resolver has a socket and a server to talk to.
+        int Error() const { return error_; }
+
+    private:
+
+        struct Query final
+        {
+            uint16_t id_{ 0 };
+            bool done_{ false };
+        };
+
+        void Open();
+        void Send(const std::string& hostname, const Query& query);
+        void Drain(const std::vector<std::string>& hostnames, std::vector<Query>& queries, std::vector<DnsAnswer>& answers, size_t& pending);
+
+        detail::WSA wsa_{};
+        sockaddr_in server_address_{};
+        SOCKET socket_{ INVALID_SOCKET };
+        int error_{ 0 };
+    };
+
+}
+
+
+#endif
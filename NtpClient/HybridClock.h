@@ -0,0 +1,154 @@
+#ifndef AMITG_FC_HYBRIDCLOCK
+#define AMITG_FC_HYBRIDCLOCK
+
+/*
+    HybridClock.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Hybrid Logical Clock (Kulkarni et al., "Logical Physical Clocks", 2014): Timestamps that follow physical
+// (NTP-corrected) time, but never go backwards and respect causality across processes: A timestamp taken after
+// receiving a message is greater than the sender's timestamp, however the two clocks disagree.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <compare>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+
+#include "NtpEngine.h"
+
+
+namespace ntp_client
+{
+
+    // **** HlcTimestamp struct ****
+
+    // 48 bits of physical time (milliseconds since the unix epoch, enough until the year 10889) and a 16-bit
+    // logical counter, packed into one 64-bit integer so that timestamps compare (and are updated) as integers.
+    struct HlcTimestamp final
+    {
+        static constexpr int kLogicalBits = 16;
+
+        uint64_t value_{ 0 };
+
+
+        [[nodiscard]] constexpr uint64_t Physical() const { return value_ >> kLogicalBits; }  // Milliseconds.
+        [[nodiscard]] constexpr uint16_t Logical() const { return static_cast<uint16_t>(value_); }
+
+        [[nodiscard]] static constexpr HlcTimestamp Make(const uint64_t physical, const uint16_t logical)
+        {
+            return HlcTimestamp{ physical << kLogicalBits | logical };
+        }
+
+        constexpr auto operator<=>(const HlcTimestamp&) const = default;
+    };
+
+
+    // **** HybridClock class ****
+
+    // Lock-free HLC generator. Any number of threads may call Now() and Merge() concurrently.
+    //
+    // With both halves packed in one integer, the HLC update rules (l = max(l, pt); c = l unchanged ? c + 1 : 0)
+    // become: next = max(last + 1, pt << 16). An exhausted counter (65536 timestamps in one millisecond) carries into
+    // the physical half, which then runs slightly ahead until real time catches up, as the HLC algorithm allows.
+    template <typename ClockSource = SystemClock>
+    class HybridClock final
+    {
+    public:
+
+        // Constructor: max_skew bounds how far ahead of our physical time a remote timestamp may be (see Merge()).
+        explicit HybridClock(const Duration max_skew = std::chrono::seconds(1)) : max_skew_(max_skew)
+        {
+
+        }
+
+
+        // Timestamp a local or send event.
+        HlcTimestamp Now()
+        {
+            const uint64_t physical = PhysicalNow() << HlcTimestamp::kLogicalBits;
+
+            uint64_t last = last_.load(std::memory_order_relaxed);
+            uint64_t next{ 0 };
+            do {
+                next = std::max(last + 1, physical);
+            } while (!last_.compare_exchange_weak(last, next, std::memory_order_relaxed));
+
+            return HlcTimestamp{ next };
+        }
+
+
+        // Timestamp a receive event: The result is greater than both the remote timestamp and every earlier local one.
+        // Returns false (and leaves the clock alone) if the remote timestamp is more than max_skew ahead of our
+        // physical time: A sender with a broken clock must not drag every clock it talks to into the future.
+        bool Merge(const HlcTimestamp remote, HlcTimestamp& result)
+        {
+            const uint64_t now = PhysicalNow();
+            const auto max_skew_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(max_skew_).count());
+            if (remote.Physical() > now + max_skew_ms) {
+                return false;
+            }
+
+            const uint64_t physical = now << HlcTimestamp::kLogicalBits;
+
+            uint64_t last = last_.load(std::memory_order_relaxed);
+            uint64_t next{ 0 };
+            do {
+                next = std::max({ last + 1, remote.value_ + 1, physical });
+            } while (!last_.compare_exchange_weak(last, next, std::memory_order_relaxed));
+
+            result = HlcTimestamp{ next };
+            return true;
+        }
+
+
+        // Correct the physical time source by the offset NTP measured (server minus local clock).
+        void SetOffset(const Duration offset) { offset_.store(offset.count(), std::memory_order_relaxed); }
+
+    private:
+
+        // Physical time in milliseconds: The local clock, corrected by the NTP offset.
+        [[nodiscard]] uint64_t PhysicalNow() const
+        {
+            const Duration time = clock_.Now() + Duration(offset_.load(std::memory_order_relaxed));
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time).count());
+        }
+
+
+        static constexpr size_t kCacheLine = 64;
+
+        std::atomic<int64_t> offset_{ 0 };
+        Duration max_skew_{ std::chrono::seconds(1) };
+        NTP_NO_UNIQUE_ADDRESS ClockSource clock_{};
+        alignas(kCacheLine) std::atomic<uint64_t> last_{ 0 }; // Own cache line (last member, so the alignment pads the rest):
+                                                              // The read-mostly fields above must not share the contended one.
+    };
+
+
+    static_assert(HlcTimestamp::Make(1, 0) > HlcTimestamp::Make(0, UINT16_MAX));
+    static_assert(HlcTimestamp{ HlcTimestamp::Make(5, UINT16_MAX).value_ + 1 } == HlcTimestamp::Make(6, 0), "Counter overflow carries.");
+
+}
+
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef AMITG_FC_INTERVALCLOCK
+#define AMITG_FC_INTERVALCLOCK
+
+/*
+    IntervalClock.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Interval time (in the style of Spanner's TrueTime): Now() returns [earliest, latest], an interval that contains
+// the true time, instead of a single reading with an unknown error.
+// The interval is the local clock corrected by the latest estimate (ClientEngine::Estimate), widened by the estimate's
+// error bound (the selection's intersection interval) plus the dispersion growth since the estimate (holdover at the frequency tolerance).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <optional>
+#include <thread>
+
+#include "NtpEngine.h"
+#include "Seqlock.h"
+
+
+namespace ntp_client
+{
+
+    // **** TimeInterval struct ****
+
+    struct TimeInterval final
+    {
+        Duration earliest_{ 0 }; // Time since the unix epoch.
+        Duration latest_{ 0 };
+
+        [[nodiscard]] constexpr Duration Width() const { return latest_ - earliest_; }
+    };
+
+
+    // **** IntervalClock class ****
+
+    // One thread updates the estimate (after each poll); any number of threads read intervals.
+    // Reading is lock-free: A seqlock read of three words, the local clock, and a few additions.
+    // Note: Assumes nothing else steps the local clock between updates (the holdover only covers its frequency error).
+    template <typename ClockSource = SystemClock>
+    class IntervalClock final
+    {
+    public:
+
+        // Publish a new estimate. Invalid estimates are ignored (the previous one stays in holdover).
+        void Update(const TimeEstimate& estimate)
+        {
+            if (estimate.valid_) {
+                state_.Publish(State{ estimate.time_.count(), estimate.offset_.count(), estimate.error_.count() });
+            }
+        }
+
+
+        // The interval that contains the true time now. Nothing before the first valid estimate.
+        [[nodiscard]] std::optional<TimeInterval> Now() const
+        {
+            if (state_.Version() == 0) {
+                return std::nullopt;
+            }
+
+            const Duration local = clock_.Now();
+            const State state = state_.Read();
+
+            const Duration time = local + Duration(state.offset_);
+            const Duration error = Duration(state.error_) + DispersionGrowth(std::max(local - Duration(state.time_), Duration(0)));
+            return TimeInterval{ time - error, time + error };
+        }
+
+
+        // Commit wait: Block until timestamp is definitely in the past (earliest > timestamp).
+        // Use the latest_ of a Now() taken at commit time as the timestamp; once CommitWait returns, every
+        // later Now() anywhere is after it. Returns false if there is no estimate to wait against.
+        bool CommitWait(const Duration timestamp) const
+        {
+            for (;;) {
+                const auto now = Now();
+                if (!now) {
+                    return false;
+                }
+
+                if (now->earliest_ > timestamp) {
+                    return true;
+                }
+
+                std::this_thread::sleep_for(timestamp - now->earliest_ + Duration(1));
+            }
+        }
+
+    private:
+
+        struct State final
+        {
+            int64_t time_{ 0 };    // Local time of the estimate, nanoseconds.
+            int64_t offset_{ 0 };
+            int64_t error_{ 0 };   // Error bound at time_.
+        };
+
+        Seqlock<State> state_{};
+        NTP_NO_UNIQUE_ADDRESS ClockSource clock_{};
+    };
+
+}
+
+
+#endif
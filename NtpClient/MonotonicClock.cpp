@@ -0,0 +1,153 @@
+/*
+    MonotonicClock.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "MonotonicClock.h"
+
+#include <algorithm>
+
+
+namespace ntp_client
+{
+
+    namespace
+    {
+        // How far in the future a correction change takes effect: Longer than any reader can take between reading
+        // its snapshot and the clock, so no reader can apply the old correction after the new one starts.
+        constexpr int64_t kGuard = 1'000'000; // 1 ms.
+
+
+        // Per-thread cache of the last value returned (by one clock: the one this thread used last).
+        struct ThreadCache final
+        {
+            const void* clock_{ nullptr };
+            int64_t last_{ 0 };
+        };
+
+        thread_local ThreadCache thread_cache{};
+    }
+
+
+    // Constructor:
+    MonotonicClock::MonotonicClock(const double max_slew_ppm, const SystemTime system_time) : rate_(max_slew_ppm / 1e6),
+        system_time_(system_time)
+    {
+        const int64_t anchor = system_time_().count() - Steady(); // System clock minus steady clock.
+
+        writer_state_.previous_ = writer_state_.current_ = Segment{ 0, anchor, anchor };
+        state_.Publish(writer_state_);
+    }
+
+
+    // Monotonic time since the unix epoch.
+    Duration MonotonicClock::Now() const
+    {
+        int64_t steady{ 0 }, time{ 0 };
+
+        // Read the clock between two reads of the version, so the snapshot is known to be the one current at that instant:
+        for (;;) {
+            const uint64_t version = state_.Version();
+            const State state = state_.Read();
+            steady = Steady();
+            if (state_.Version() == version) {
+                time = steady + Correction(state, steady);
+                break;
+            }
+        }
+
+        time = std::max(time, high_water_mark_.load(std::memory_order_acquire));
+
+        if (thread_cache.clock_ == this) {
+            time = std::max(time, thread_cache.last_);
+        }
+        thread_cache = ThreadCache{ this, time };
+
+        return Duration(time);
+    }
+
+
+    // Slew toward a new NTP offset.
+    void MonotonicClock::Update(const Duration offset)
+    {
+        const std::lock_guard lock(update_mutex_);
+
+        // The offset was measured against the system clock as it is now: Rebase it on the steady clock here.
+        const int64_t target = system_time_().count() - Steady() + offset.count();
+
+        State next = writer_state_;
+        if (writer_state_.current_.start_ > Steady()) {
+            next.current_.target_ = target; // The last change has not taken effect yet: Just retarget it.
+        }
+        else {
+            const int64_t start = Steady() + kGuard;
+            next.previous_ = writer_state_.current_;
+            next.current_ = Segment{ start, Correction(writer_state_, start), target };
+        }
+
+        state_.Publish(next);
+
+        // If this thread was delayed past the start before publishing, readers may have applied the old segment after
+        // the new one started: Raise the high-water mark over anything they can have returned.
+        if (const int64_t now = Steady(); now >= next.current_.start_) {
+            const int64_t old_time = now + Correction(writer_state_, now);
+            int64_t mark = high_water_mark_.load(std::memory_order_relaxed);
+            while (mark < old_time && !high_water_mark_.compare_exchange_weak(mark, old_time, std::memory_order_release)) {
+            }
+        }
+
+        writer_state_ = next;
+    }
+
+
+    // The process-wide instance.
+    MonotonicClock& MonotonicClock::Global()
+    {
+        static MonotonicClock clock{};
+        return clock;
+    }
+
+
+    int64_t MonotonicClock::Correction(const Segment& segment, const int64_t steady) const
+    {
+        const auto limit = static_cast<int64_t>(rate_ * static_cast<double>(std::max<int64_t>(steady - segment.start_, 0)));
+        return segment.base_ + std::clamp(segment.target_ - segment.base_, -limit, limit);
+    }
+
+
+    int64_t MonotonicClock::Correction(const State& state, const int64_t steady) const
+    {
+        return steady < state.current_.start_ ? Correction(state.previous_, steady) : Correction(state.current_, steady);
+    }
+
+
+    Duration MonotonicClock::SystemNow()
+    {
+        return std::chrono::duration_cast<Duration>(std::chrono::system_clock::now().time_since_epoch());
+    }
+
+
+    int64_t MonotonicClock::Steady()
+    {
+        return std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+}
@@ -0,0 +1,112 @@
+#ifndef AMITG_FC_MONOTONICCLOCK
+#define AMITG_FC_MONOTONICCLOCK
+
+/*
+    MonotonicClock.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Monotonic network time: Wall-clock time corrected by NTP that never decreases, process-wide.
+//
+// Time is the steady (monotonic) clock plus a correction. A new NTP offset never moves the correction at once;
+// it is slewed toward the new value at no more than max_slew_ppm, so the result keeps advancing (at 1 +- 0.0005
+// the nominal rate at the default 500 ppm) across corrections in either direction. Steps of the system clock do not
+// move it either: An offset is relative to the system clock as Update() finds it, so the target is rebased on the
+// gap between the system and steady clocks at that moment (not at construction; the two drift apart, and get stepped).
+//
+// A correction change takes effect a guard interval in the future, and a reader checks that its snapshot of the
+// correction was current when it read the clock, so all readers follow one continuous function of the steady clock.
+// Two cheap floors cover what is left: A per-thread cache of the last value returned, and a process-wide high-water
+// mark that only Update() writes. Readers never write shared memory, so there is no contended cache line.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <mutex>
+
+#include "NtpCore.h"
+#include "Seqlock.h"
+
+
+namespace ntp_client
+{
+
+    // **** MonotonicClock class ****
+
+    class MonotonicClock final
+    {
+    public:
+
+        // Reads the system (wall) clock, as time since the unix epoch.
+        using SystemTime = Duration (*)();
+
+
+        // Constructor: Starts at the system (wall) clock, uncorrected. (system_time replaces the system clock in tests.)
+        explicit MonotonicClock(double max_slew_ppm = 500, SystemTime system_time = &SystemNow);
+
+
+        // Time since the unix epoch: Never less than any value returned before (by any thread).
+        [[nodiscard]] Duration Now() const;
+
+
+        // Slew toward a new NTP offset (server minus system clock). Any thread (updates take a lock; reads never do).
+        void Update(Duration offset);
+
+
+        // The process-wide instance. Synchronize updates it with every offset it selects (single samples from GetTime,
+        // and Race's first quorum, are too noisy to steer it).
+        static MonotonicClock& Global();
+
+    private:
+
+        // Correction = base_ at start_, moving toward target_ at up to rate_ per nanosecond (all in steady clock nanoseconds).
+        struct Segment final
+        {
+            int64_t start_{ 0 };
+            int64_t base_{ 0 };
+            int64_t target_{ 0 };
+        };
+
+        // The current segment, and the one before it (which still applies before current_.start_).
+        struct State final
+        {
+            Segment previous_{};
+            Segment current_{};
+        };
+
+        [[nodiscard]] int64_t Correction(const Segment& segment, int64_t steady) const;
+        [[nodiscard]] int64_t Correction(const State& state, int64_t steady) const;
+
+        static int64_t Steady();
+        static Duration SystemNow();
+
+        double rate_{ 0 };           // Slew rate, nanoseconds per nanosecond.
+        SystemTime system_time_{ nullptr };
+        Seqlock<State> state_{};
+        std::mutex update_mutex_{};  // Serializes Update().
+        State writer_state_{};       // Update()'s own copy of the published state.
+        std::atomic<int64_t> high_water_mark_{ 0 };
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef AMITG_FC_NONCETABLE
+#define AMITG_FC_NONCETABLE
+
+/*
+    NonceTable.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Request nonces (RFC 9109, data minimization): A client request carries a random 64-bit nonce in its transmit
+// timestamp instead of the local time, and keeps the real send time (T1) to itself. The server echoes the nonce as the
+// reply's origin timestamp, which then finds the request in one hash lookup, whatever the number of requests in flight.
+// The request no longer tells anyone what the local clock reads, and a blind spoofer has to guess 64 random bits
+// (unpredictable ones: see NewNonce).
+
+#include <array>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <cstring> // For std::memcpy.
+#include <memory> // For std::allocator and std::allocator_traits.
+#include <span>
+#include <vector>
+
+#include "NtpCore.h"
+
+
+namespace ntp_client
+{
+
+    // Fill buffer from the operating system's cryptographic generator (BCryptGenRandom). Defined in NonceTable.cpp.
+    void SystemRandom(std::span<uint8_t> buffer);
+
+
+    namespace detail
+    {
+        // ChaCha20 block function (RFC 8439, section 2.3): 16 words of key stream for (key, block counter, nonce).
+        [[nodiscard]] constexpr std::array<uint32_t, 16> ChaCha20Block(const std::array<uint32_t, 8>& key, const uint32_t counter,
+            const std::array<uint32_t, 3>& nonce)
+        {
+            const std::array<uint32_t, 16> input{ 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574, // "expand 32-byte k"
+                key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7], counter, nonce[0], nonce[1], nonce[2] };
+
+            std::array<uint32_t, 16> x = input;
+            const auto quarter_round = [&x](const size_t a, const size_t b, const size_t c, const size_t d) {
+                const auto rotate = [](const uint32_t value, const int k) { return value << k | value >> (32 - k); };
+                x[a] += x[b]; x[d] = rotate(x[d] ^ x[a], 16);
+                x[c] += x[d]; x[b] = rotate(x[b] ^ x[c], 12);
+                x[a] += x[b]; x[d] = rotate(x[d] ^ x[a], 8);
+                x[c] += x[d]; x[b] = rotate(x[b] ^ x[c], 7);
+            };
+
+            for (int round = 0; round < 10; ++round) { // 20 rounds: A column round and a diagonal round each time.
+                quarter_round(0, 4, 8, 12);
+                quarter_round(1, 5, 9, 13);
+                quarter_round(2, 6, 10, 14);
+                quarter_round(3, 7, 11, 15);
+                quarter_round(0, 5, 10, 15);
+                quarter_round(1, 6, 11, 12);
+                quarter_round(2, 7, 8, 13);
+                quarter_round(3, 4, 9, 14);
+            }
+
+            for (size_t i = 0; i < x.size(); ++i) {
+                x[i] += input[i];
+            }
+            return x;
+        }
+    }
+
+
+    // A random nonzero nonce, unpredictable even to the servers that see every nonce we send (as a transmit timestamp):
+    // A per-thread ChaCha20 key stream, keyed from SystemRandom(). (One block function per 8 nonces, instead of a
+    // system call per nonce; a non-cryptographic generator would give its state away to anyone collecting nonces.)
+    [[nodiscard]] inline uint64_t NewNonce()
+    {
+        struct Generator final
+        {
+            std::array<uint32_t, 8> key_{};
+            std::array<uint32_t, 3> nonce_{};
+            uint32_t counter_{ 0 };
+            std::array<uint32_t, 16> block_{};
+            size_t used_{ 16 };
+
+            void Rekey()
+            {
+                std::array<uint8_t, sizeof(key_) + sizeof(nonce_)> seed{};
+                SystemRandom(seed);
+                std::memcpy(key_.data(), seed.data(), sizeof(key_));
+                std::memcpy(nonce_.data(), seed.data() + sizeof(key_), sizeof(nonce_));
+                counter_ = 0;
+            }
+
+            uint64_t Next()
+            {
+                if (used_ == block_.size()) {
+                    if (counter_ == 0) {
+                        Rekey(); // First use, or 2^32 blocks later (the counter wrapped).
+                    }
+                    block_ = detail::ChaCha20Block(key_, counter_++, nonce_);
+                    used_ = 0;
+                }
+
+                const uint64_t result = static_cast<uint64_t>(block_[used_]) << 32 | block_[used_ + 1];
+                used_ += 2;
+                return result;
+            }
+        };
+
+        thread_local Generator generator{};
+        for (;;) {
+            if (const uint64_t nonce = generator.Next(); nonce != 0) {
+                return nonce;
+            }
+        }
+    }
+
+
+    static_assert(detail::ChaCha20Block({ 0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c, 0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c },
+        1, { 0x09000000, 0x4a000000, 0 })[0] == 0xe4e7f110, "RFC 8439, section 2.3.2 test vector.");
+
+
+    // **** NonceTable class ****
+
+    // Requests in flight, by nonce: Open addressing with linear probing, and backward-shift deletion (no tombstones, so
+    // a table that sees millions of requests come and go stays as fast as a fresh one). The nonces are random, so their
+    // low bits index the table as they are. The slots come from Allocator (rebound, as for a standard container).
+    template <typename Allocator = std::allocator<std::byte>>
+    class NonceTable final
+    {
+    public:
+
+        struct Request final
+        {
+            uint64_t nonce_{ 0 };   // 0 = empty slot.
+            Timestamp sent_{};      // T1: The local send time, kept here instead of in the packet.
+            uint32_t peer_{ 0 };    // The owner's indexes (for ClientEngine: index in Peers() and outstanding slot).
+            uint32_t slot_{ 0 };
+        };
+
+        using SlotAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Request>;
+
+
+        // Constructor:
+        NonceTable() = default;
+
+        explicit NonceTable(const Allocator& allocator) : slots_(SlotAllocator(allocator))
+        {
+
+        }
+
+
+        // Add a request. Its nonce must be nonzero and not in the table.
+        void Insert(const Request& request)
+        {
+            if ((size_ + 1) * 2 > slots_.size()) {
+                Grow();
+            }
+
+            slots_[Probe(request.nonce_)] = request;
+            ++size_;
+        }
+
+
+        // The request with this nonce, or nullptr.
+        [[nodiscard]] const Request* Find(const uint64_t nonce) const
+        {
+            if (nonce == 0 || slots_.empty()) {
+                return nullptr;
+            }
+
+            const Request& request = slots_[Probe(nonce)];
+            return request.nonce_ == nonce ? &request : nullptr;
+        }
+
+
+        // Remove a request (if present).
+        void Erase(const uint64_t nonce)
+        {
+            if (nonce == 0 || slots_.empty()) {
+                return;
+            }
+
+            const size_t mask = slots_.size() - 1;
+            size_t hole = Probe(nonce);
+            if (slots_[hole].nonce_ != nonce) {
+                return;
+            }
+
+            // Shift back every following entry of the cluster that may move into the hole (one whose home slot is not
+            // cyclically between the hole and itself), so that no probe sequence is broken:
+            for (size_t next = (hole + 1) & mask; slots_[next].nonce_ != 0; next = (next + 1) & mask) {
+                const size_t home = slots_[next].nonce_ & mask;
+                if (((next - home) & mask) >= ((next - hole) & mask)) {
+                    slots_[hole] = slots_[next];
+                    hole = next;
+                }
+            }
+
+            slots_[hole] = Request{};
+            --size_;
+        }
+
+
+        [[nodiscard]] size_t Size() const { return size_; }
+
+    private:
+
+        // The slot holding nonce, or the empty slot where it belongs.
+        [[nodiscard]] size_t Probe(const uint64_t nonce) const
+        {
+            const size_t mask = slots_.size() - 1;
+            size_t index = nonce & mask;
+            while (slots_[index].nonce_ != 0 && slots_[index].nonce_ != nonce) {
+                index = (index + 1) & mask;
+            }
+            return index;
+        }
+
+
+        void Grow()
+        {
+            std::vector<Request, SlotAllocator> old(slots_.get_allocator());
+            old.swap(slots_);
+            slots_.resize(old.empty() ? 16 : old.size() * 2);
+            for (const Request& request : old) {
+                if (request.nonce_ != 0) {
+                    slots_[Probe(request.nonce_)] = request;
+                }
+            }
+        }
+
+
+        std::vector<Request, SlotAllocator> slots_{}; // Power-of-two size.
+        size_t size_{ 0 };
+    };
+
+}
+
+
+#endif
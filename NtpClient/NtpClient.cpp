@@ -21,255 +21,509 @@
     THE SOFTWARE.
 */
 
-#include <Windows.h>
-#include <cstdint> // For using uint32_t or similar types.
+#include "NtpClient.h"
 
-// Functions like WSAStartup, WSACleanup, socket, recv, sendto, etc., are part of the Winsock API.
-// Including Ws2_32.lib ensures that the linker resolves references to these functions and includes
-// them in the final executable.
-#pragma comment(lib, "Ws2_32.lib")
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <functional> // For std::equal_to.
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "DnsResolver.h"
+#include "NtpCore.h"
+#include "Cancellation.h"
+#include "CircuitBreaker.h"
+#include "MonotonicClock.h"
+#include "RefId.h"
+#include "Seqlock.h"
+#include "SingleFlight.h"
+#include "SocketApi.h"
+#include "UdpTransport.h"
 
 
 namespace // (Anonymous namespace)
 {
 
-    // **** Timestamp class **** 
+    using ntp_client::Deadline;
+    using ntp_client::detail::WSA;
+
+    constexpr std::chrono::milliseconds kDnsTimeout{ 2000 };
+    constexpr std::chrono::milliseconds kReplyTimeout{ 1000 }; // How long to wait for the replies to the last burst packets.
+    constexpr uint16_t kNtpPort = 123;
+    constexpr std::chrono::seconds kNegativeDnsTtl{ 60 }; // How long a name that did not resolve stays unresolved.
+    constexpr size_t kMaxNegativeDnsEntries = 1024; // Names that did not resolve, remembered at most.
 
-    // NTP Fixed-Point Timestamp Format.
-    // Note: RFC 5905 (http://tools.ietf.org/html/rfc5905).
-    class Timestamp final
+
+    // Heterogeneous lookup: Find a hostname without building a std::string.
+    struct Hash final
     {
-    public:
+        using is_transparent = void;
+        size_t operator()(const std::string_view text) const { return std::hash<std::string_view>{}(text); }
+    };
 
-        uint32_t seconds_{ 0 }; // Seconds since Jan 1, 1900.
-        uint32_t fraction_{ 0 }; // Fractional part of seconds. Integer number of 2^-32 seconds.
 
+    // **** NegativeDnsCache class ****
 
-        // Reverses the Endianness of the timestamp.
-        // Network byte order is big endian, so it needs to be switched before
-        // sending or reading.
-        void ReverseEndian() {
-            ReverseEndianUint32(seconds_);
-            ReverseEndianUint32(fraction_);
+    // Names that recently failed to resolve: Not looked up again (each lookup would cost up to kDnsTimeout) until
+    // kNegativeDnsTtl has passed.
+    class NegativeDnsCache final
+    {
+    public:
+
+        [[nodiscard]] bool Contains(const std::string_view hostname) const
+        {
+            std::shared_lock lock{ mutex_ };
+            const auto found = expiry_.find(hostname);
+            return found != expiry_.end() && std::chrono::steady_clock::now() < found->second;
         }
 
 
-        // Convert to time_t.
-        // Returns the integer part of the timestamp in unix time_t format,
-        // which is seconds since Jan 1, 1970.
-        [[nodiscard]] time_t ToTimeT() const
+        // At kMaxNegativeDnsEntries, the expired entries are dropped first, then the one that expires soonest.
+        void Insert(const std::string& hostname)
         {
-            constexpr time_t kSecondsIn24Hours = static_cast<time_t>(60) * 60 * 24, // 60s * 60m * 24h
-                kDaysIn70Years = static_cast<time_t>(365) * 70; // 365d * 70y
+            const auto now = std::chrono::steady_clock::now();
+
+            std::unique_lock lock{ mutex_ };
+            if (expiry_.size() >= kMaxNegativeDnsEntries && !expiry_.contains(hostname)) {
+                std::erase_if(expiry_, [now](const auto& entry) { return entry.second <= now; });
+                if (expiry_.size() >= kMaxNegativeDnsEntries) {
+                    expiry_.erase(std::min_element(expiry_.begin(), expiry_.end(), [](const auto& a, const auto& b) { return a.second < b.second; }));
+                }
+            }
+            expiry_[hostname] = now + kNegativeDnsTtl;
+        }
+
+    private:
+
+        mutable std::shared_mutex mutex_{};
+        std::unordered_map<std::string, std::chrono::steady_clock::time_point, Hash, std::equal_to<>> expiry_{};
+    };
 
-            // A leap year is a calendar year with an extra day. 17 leap years between 1900 and 1970:
-            // 1904, 1908, 1912, 1916, 1920, 1924, 1928, 1932, 1936, 1940, 1944, 1948, 1952, 1956, 1960, 1964, 1968
-            const time_t time_since_epoch = seconds_ - kSecondsIn24Hours * (kDaysIn70Years + 17) & UINT32_MAX;
 
-            return time_since_epoch;
+    NegativeDnsCache unresolved{};
+
+
+    // Resolve hostnames to IPv4 addresses (network byte order, 0 = not resolved), in the same order.
+    // Uses the non-blocking stub resolver, which resolves all names in one round trip and gives up after kDnsTimeout
+    // (gethostbyname could block the calling thread for seconds on a slow resolver), at the deadline, or on a stop request.
+    // If no system DNS server can be found, falls back to gethostbyname (which cannot be cancelled).
+    // Names in the negative cache are not looked up at all; names that fail a full-length lookup are added to it.
+    std::vector<uint32_t> Resolve(const std::vector<std::string>& hostnames, const std::stop_token& stop = {}, const Deadline deadline = Deadline::max())
+    {
+        std::vector<uint32_t> addresses(hostnames.size());
+
+        std::vector<size_t> pending{};
+        std::vector<std::string> names{};
+        for (size_t i = 0; i < hostnames.size(); ++i) {
+            if (!unresolved.Contains(hostnames[i])) {
+                pending.push_back(i);
+                names.push_back(hostnames[i]);
+            }
         }
 
-    protected:
+        if (names.empty()) {
+            return addresses;
+        }
 
-        // Reverse the endianness of a 32-bit unsigned integer:
-        void ReverseEndianUint32(uint32_t& x) {
-            x = ((x & 0xFF000000) >> 24) |
-                ((x & 0x00FF0000) >> 8) |
-                ((x & 0x0000FF00) << 8) |
-                ((x & 0x000000FF) << 24);
+        const auto timeout = std::min<std::chrono::microseconds>(kDnsTimeout, ntp_client::TimeLeft(deadline));
+        if (ntp_client::DnsResolver resolver{}; resolver.Error() == 0) {
+            const auto answers = resolver.Resolve(names, std::chrono::ceil<std::chrono::milliseconds>(timeout), stop);
+            for (size_t i = 0; i < answers.size(); ++i) {
+                addresses[pending[i]] = answers[i].address_;
+            }
+        } else {
+            for (size_t i = 0; i < names.size(); ++i) {
+                // gethostbyname(name) retrieves host information corresponding to a host name from a host database.
+                // If no error occurs, gethostbyname returns a pointer to the hostent structure. Otherwise, it returns
+                // a null pointer and a specific error number can be retrieved by calling WSAGetLastError().
+                if (const auto host_information = gethostbyname(names[i].c_str()); host_information != nullptr) {
+                    addresses[pending[i]] = reinterpret_cast<struct in_addr*>(*host_information->h_addr_list)->s_addr;
+                }
+            }
+        }
+
+        // A lookup cut short (by the deadline or a stop request) proves nothing about the name:
+        if (timeout == kDnsTimeout && !stop.stop_requested()) {
+            for (const size_t i : pending) {
+                if (addresses[i] == 0) {
+                    unresolved.Insert(hostnames[i]);
+                }
+            }
         }
+
+        return addresses;
+    }
+
+
+    // GetTime calls in progress, by hostname.
+    ntp_client::SingleFlight<std::string, time_t> in_flight{};
+
+
+    using ntp_client::Duration;
+
+
+    [[nodiscard]] int64_t Steady()
+    {
+        return std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    // Server time at a steady clock instant: Extrapolated with the steady clock, it stays server time.
+    struct TimeSnapshot final
+    {
+        int64_t time_{ 0 };     // Server time since the unix epoch, nanoseconds...
+        int64_t steady_{ 0 };   // ...at this steady clock time.
     };
 
 
-    // **** NtpMessage class ****
+    // How an exchange ended, for the circuit breakers: Only the server's own failures count against it.
+    // kGaveUp: Stopped, or cut short by the caller's deadline. kError: A local error (no socket).
+    enum class Outcome { kReply, kFailed, kGaveUp, kError };
+
 
-    // A Network Time Protocol Message.
-    // According to RFC 5905 (http://tools.ietf.org/html/rfc5905).
-    class NtpMessage final
+    // One DNS lookup and one request/reply exchange with an NTP server, until the deadline (at most kReplyTimeout after
+    // the request) or a stop request. Returns nothing on error, timeout or stop. The engine, and with it the socket,
+    // goes away as soon as the wait is over: A stopped query holds nothing.
+    std::optional<TimeSnapshot> Exchange(const std::string& hostname, const std::stop_token& stop, const Deadline deadline, Outcome& outcome)
     {
-    public:
+        outcome = Outcome::kGaveUp;
+
+        WSA wsa{};
+        ntp_client::ClientEngine<ntp_client::UdpTransport> engine{};
+        if (wsa.Error() != 0 || engine.GetTransport().Error() != 0) {
+            outcome = Outcome::kError;
+            return std::nullopt;
+        }
+
+        const bool full_dns_timeout = ntp_client::TimeLeft(deadline) >= kDnsTimeout;
+        const uint32_t address = Resolve({ hostname }, stop, deadline).front();
+        if (address == 0 || stop.stop_requested()) {
+            if (address == 0 && full_dns_timeout && !stop.stop_requested()) {
+                outcome = Outcome::kFailed;
+            }
+            return std::nullopt;
+        }
+
+        engine.AddServer(ntp_client::Endpoint{ address, htons(kNtpPort) });
+        engine.Poll();
+
+        const auto& filter = engine.Peers().front().filter_;
+        const auto reply_timeout = std::chrono::steady_clock::now() + kReplyTimeout;
+        const auto reply_deadline = std::min(deadline, reply_timeout);
+        while (filter.Size() == 0) {
+            const auto left = ntp_client::TimeLeft(reply_deadline);
+            if (left.count() == 0 || stop.stop_requested()) {
+                if (reply_deadline == reply_timeout && !stop.stop_requested()) {
+                    outcome = Outcome::kFailed;
+                }
+                return std::nullopt;
+            }
+
+            if (engine.GetTransport().Wait(left, stop)) {
+                engine.Process();
+            }
+        }
+
+        const Duration local = engine.Clock().Now();
+        const int64_t steady = Steady();
+        const Duration offset = filter.Best(local)->offset_;
+        outcome = Outcome::kReply;
+        return TimeSnapshot{ (local + offset).count(), steady };
+    }
 
-        // The NTP packet header format, depicted in Figure 8 of RFC 5905, is as follows:
-        // 
-        //       0                   1                   2                   3
-        //       0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |LI | VN  |Mode |    Stratum     |     Poll      |  Precision   |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                         Root Delay                            |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                         Root Dispersion                       |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                          Reference ID                         |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                                                               |
-        //      +                     Reference Timestamp (64)                  +
-        //      |                                                               |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                                                               |
-        //      +                      Origin Timestamp (64)                    +
-        //      |                                                               |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                                                               |
-        //      +                      Receive Timestamp (64)                   +
-        //      |                                                               |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                                                               |
-        //      +                      Transmit Timestamp (64)                  +
-        //      |                                                               |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                                                               |
-        //      .                                                               .
-        //      .                    Extension Field 1 (variable)               .
-        //      .                                                               .
-        //      |                                                               |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                                                               |
-        //      .                                                               .
-        //      .                    Extension Field 2 (variable)               .
-        //      .                                                               .
-        //      |                                                               |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                          Key Identifier                       |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //      |                                                               |
-        //      |                            dgst (128)                         |
-        //      |                                                               |
-        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-        //  
-        // The NTP packet header consists of several fields, including Leap Indicator (LI), Version Number (VN), Mode,
-        // Stratum, Poll, Precision, Root Delay, Root Dispersion, Reference ID, Reference Timestamp, Origin Timestamp,
-        // Receive Timestamp, Transmit Timestamp, and Extension Fields.
-
-        uint8_t mode_ : 3;               // (Bit-field: 3 bits) Mode of the message sender. 3 = Client, 4 = Server.
-        uint8_t version_ : 3;            // (Bit-field: 3 bits) Protocol version. Should be set to 4.
-        uint8_t leap_ : 2;               // (Bit-field: 2 bits) Leap seconds warning. See: RFC section 7.3 (http://tools.ietf.org/html/rfc5905#section-7.3).
-
-        uint8_t stratum_{ 0 };           // Servers between client and physical timekeeper. 1 = Server is Connected to Physical Source. 0 = Unknown.
-        uint8_t poll_{ 0 };              // Max Poll Rate. In log2 seconds.
-        uint8_t precision_{ 0 };         // Precision of the clock. In log2 seconds.
-
-        // (^^^ All that above: 4 bytes (32 bits) in total ^^^) 
-
-        uint32_t sync_distance_{ 0 };    // (32 bits in total) Round-trip to reference clock. NTP Short Format.
-        uint32_t drift_rate_{ 0 };       // (32 bits in total) Dispersion to reference clock. NTP Short Format.
-
-        uint8_t ref_clock_id_[4]{ 0 };   // (32 bits in total) Reference ID. For Stratum 1 devices, a 4-byte string. For other devices, 4-byte IP address.
-
-        Timestamp ref_{};                // (64 bits in total) Reference Timestamp. The time when the system clock was last updated.
-        Timestamp orig_{};               // (64 bits in total) Origin Timestamp. Send time of the request. Copied from the request.
-
-        Timestamp rx_{};                 // (64 bits in total) Receive Timestamp. Receive time of the request.
-        Timestamp tx_{};                 // (64 bits in total) Transmit Timestamp. Send time of the response. If only a single time is needed, use this one.
 
+    // **** BackgroundTasks class ****
+
+    // The threads GetTime starts in the background (circuit breaker probes, cache refreshes ahead of expiry).
+    // Each task gets a stop token; the destructor stops and joins whatever still runs, so that no task outlives the
+    // static objects it uses (as a detached thread could, at exit).
+    class BackgroundTasks final
+    {
+    public:
 
         // Constructor:
-        NtpMessage() : mode_(0), version_(0), leap_(0) // C++20 supports initializing the bit-fields in the class definition.
+        BackgroundTasks() = default;
+
+        // Destructor:
+        ~BackgroundTasks()
         {
+            std::vector<Task> tasks{};
+            {
+                std::lock_guard lock{ mutex_ };
+                stopping_ = true;
+                tasks.swap(tasks_);
+            }
 
+            tasks.clear(); // (Outside the lock: A task may Start another, which is then refused.)
         }
 
+        BackgroundTasks(const BackgroundTasks&) = delete;
+        BackgroundTasks& operator=(const BackgroundTasks&) = delete;
 
-        // Reverses the endianness of all timestamps.
-        // Network byte order is big endian, so they need to be switched before sending and after reading.
-        // Maintaining them in little endian makes them easier to work with locally, though.
-        void ReverseEndian()
+
+        // Run task(stop_token) on a thread of its own. Finished tasks are joined here, so the list stays short.
+        template <typename Function>
+        void Start(Function&& function)
         {
-            ref_.ReverseEndian();
-            orig_.ReverseEndian();
+            std::lock_guard lock{ mutex_ };
+            if (stopping_) {
+                return;
+            }
+
+            std::erase_if(tasks_, [](const Task& task) { return task.done_->load(); });
+
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            tasks_.push_back(Task{ done, std::jthread([function = std::forward<Function>(function), done](const std::stop_token& stop) mutable {
+                function(stop);
+                *done = true;
+            }) });
+        }
+
+    private:
+
+        struct Task final
+        {
+            std::shared_ptr<std::atomic<bool>> done_{};
+            std::jthread thread_{}; // (Destroying it requests a stop and joins.)
+        };
+
+        std::mutex mutex_{};
+        std::vector<Task> tasks_{};
+        bool stopping_{ false };
+    };
+
+
+    BackgroundTasks& Background()
+    {
+        // (The file's globals, the breakers and the cache the tasks use all outlive them.)
+        static BackgroundTasks tasks{};
+        return tasks;
+    }
+
+
+    // A circuit breaker per hostname (see CircuitBreaker.h), for GetTime.
+    ntp_client::CircuitBreaker& Breakers()
+    {
+        static ntp_client::CircuitBreaker& breakers = *new ntp_client::CircuitBreaker{}; // (Never destroyed: The background tasks use it until they are joined.)
+        return breakers;
+    }
+
+
+    // May GetTime go to the network for hostname? If its breaker is open, no (fail fast). If the backoff is over, one
+    // caller starts a probe in the background, and still fails fast: A caller never waits for a server known to be dead.
+    [[nodiscard]] bool Admit(const std::string_view hostname)
+    {
+        switch (Breakers().Admit(hostname)) {
+        case ntp_client::CircuitBreaker::Admission::kAllow:
+            return true;
+
+        case ntp_client::CircuitBreaker::Admission::kProbe:
+            Background().Start([name = std::string(hostname)](const std::stop_token& stop) {
+                Outcome outcome{ Outcome::kGaveUp };
+                Exchange(name, stop, Deadline::max(), outcome);
+                Breakers().Record(name, outcome == Outcome::kReply); // (The probe must end the half-open state either way.)
+            });
+            return false;
+
+        default:
+            return false;
+        }
+    }
+
+
+    // An admitted exchange: Its outcome goes to the server's circuit breaker (only the server's own failures count).
+    std::optional<TimeSnapshot> QuerySnapshot(const std::string& hostname, const std::stop_token& stop, const Deadline deadline, Outcome& outcome)
+    {
+        auto snapshot = Exchange(hostname, stop, deadline, outcome);
+        if (outcome == Outcome::kReply || outcome == Outcome::kFailed) {
+            Breakers().Record(hostname, outcome == Outcome::kReply);
+        }
+        return snapshot;
+    }
 
-            rx_.ReverseEndian();
-            tx_.ReverseEndian();
+
+    // GetTime's query. Return 0 on error or timeout, nothing if the caller gave up (stopped, or its deadline passed):
+    // A follower of the flight, with its own stop and deadline, then takes over instead of getting the leader's 0.
+    std::optional<time_t> QueryTime(const std::string& hostname, const std::stop_token& stop, const Deadline deadline)
+    {
+        Outcome outcome{ Outcome::kGaveUp };
+        const auto snapshot = QuerySnapshot(hostname, stop, deadline, outcome);
+        if (outcome == Outcome::kGaveUp) {
+            return std::nullopt;
         }
 
+        return snapshot ? std::chrono::duration_cast<std::chrono::seconds>(Duration(snapshot->time_ + (Steady() - snapshot->steady_))).count() : time_t{ 0 };
+    }
+
+
+    // **** TimeCache class ****
+
+    // The latest server time per hostname, for GetTime(hostname, max_age).
+    // A hit is a shared lock, a hash lookup, a seqlock read and a steady clock read: No system call, no allocation
+    // (for names short enough for the small string buffer), no network.
+    class TimeCache final
+    {
+    public:
 
-        // Receive an NTPMessage.
-        // Return the number of bytes received, 0 on connection gracefully closed.
-        int Receive(SOCKET socket)
+        std::optional<Duration> Get(const char* hostname, const Duration max_age, const std::stop_token& stop)
         {
-            // If no error occurs, recv returns the number of bytes received and the buffer pointed to by the buf parameter will contain this data received.
-            // If the connection has been gracefully closed, the return value is zero.
-            int bytes_received = recv(socket, reinterpret_cast<char*>(this), sizeof(*this), 0); // <-- Receives data from a connected socket or a bound connectionless socket.
+            Entry& entry = Find(hostname);
+
+            // A fresh sample is served even while the server's breaker is open: The breaker only guards the network.
+            if (entry.snapshot_.Version() > 0) {
+                const TimeSnapshot snapshot = entry.snapshot_.Read();
+                const Duration age{ Steady() - snapshot.steady_ };
+                if (age <= max_age) {
+                    if (age >= max_age - max_age / kRefreshAheadDivisor) {
+                        RefreshInBackground(hostname, entry); // Close to expiry: Refresh before a caller has to wait.
+                    }
+                    return Duration(snapshot.time_) + age;
+                }
+            }
+
+            // Never fetched, or stale: Go to the network (sharing the request with concurrent callers).
+            if (!Refresh(hostname, entry, stop)) {
+                return std::nullopt;
+            }
 
-            ReverseEndian();
+            const TimeSnapshot snapshot = entry.snapshot_.Read();
+            return Duration(snapshot.time_ + (Steady() - snapshot.steady_));
+        }
+
+    private:
+
+        static constexpr int64_t kRefreshAheadDivisor = 4; // Refresh in the background in the last quarter of max_age.
+
+        struct Entry final
+        {
+            ntp_client::Seqlock<TimeSnapshot> snapshot_{}; // Published only from inside a flight: One writer at a time.
+            std::atomic<bool> refreshing_{ false };
+        };
 
-            if (bytes_received == SOCKET_ERROR) {
-                [[maybe_unused]] const auto error{ WSAGetLastError() }; // For debug.
-                bytes_received = -1; // Set the return value to -1 to indicate an error.
+        Entry& Find(const char* hostname)
+        {
+            {
+                std::shared_lock lock{ mutex_ };
+                if (const auto found = entries_.find(std::string_view(hostname)); found != entries_.end()) {
+                    return *found->second;
+                }
             }
 
-            return bytes_received;
+            std::unique_lock lock{ mutex_ };
+            return *entries_.try_emplace(hostname, std::make_unique<Entry>()).first->second; // (Entries are never removed.)
         }
 
 
-        // Send an NTPMessage.
-        // Return the number of bytes sent, 0 on connection gracefully closed, -1 on error.
-        int SendTo(const SOCKET socket, sockaddr_in* server_address)
+        bool Refresh(const std::string& hostname, Entry& entry, const std::stop_token& stop = {})
         {
-            ReverseEndian();
+            if (!Admit(hostname)) {
+                return false;
+            }
 
-            // If no error occurs, recv returns the number of bytes received and the buffer pointed to by the buf parameter will contain this data received.
-            // If the connection has been gracefully closed, the return value is zero.
-            // Otherwise, a value of SOCKET_ERROR is returned, and a specific error code can be retrieved by calling WSAGetLastError.
-            int bytes_sent = sendto(socket, reinterpret_cast<const char*>(this), sizeof(*this), 0,
-                reinterpret_cast<sockaddr*>(server_address), sizeof(*server_address)); // <-- Sends data to a specific destination.
+            const auto fetch = [&hostname, &entry](const std::stop_token& flight_stop, const Deadline deadline) -> std::optional<bool> {
+                Outcome outcome{ Outcome::kGaveUp };
+                const auto snapshot = QuerySnapshot(hostname, flight_stop, deadline, outcome);
+                if (outcome == Outcome::kGaveUp) {
+                    return std::nullopt; // Gave up: Another caller of the flight takes over.
+                }
 
-            ReverseEndian();
+                if (snapshot) {
+                    entry.snapshot_.Publish(*snapshot);
+                }
+                return snapshot.has_value();
+            };
 
-            if (bytes_sent == SOCKET_ERROR) {
-                [[maybe_unused]] const auto error{ WSAGetLastError() }; // For debug.
-                bytes_sent = -1; // Set the return value to -1 to indicate an error.
+            return flights_.Call(hostname, fetch, stop, Deadline::max()).value_or(false);
+        }
+
+
+        void RefreshInBackground(const char* hostname, Entry& entry)
+        {
+            if (entry.refreshing_.exchange(true)) {
+                return; // Already on its way.
             }
 
-            return bytes_sent;
+            Background().Start([this, name = std::string(hostname), &entry](const std::stop_token& stop) {
+                Refresh(name, entry, stop);
+                entry.refreshing_ = false;
+            });
         }
+
+
+        std::shared_mutex mutex_{};
+        std::unordered_map<std::string, std::unique_ptr<Entry>, Hash, std::equal_to<>> entries_{};
+        ntp_client::SingleFlight<std::string, bool> flights_{};
     };
 
 
-    // **** WSA class ****
+    // **** RoundTrips class ****
 
-    // RAII wrapper for WSADATA:
-    class WSA final
+    // Recent round-trip delays (of every server raced), for the hedge delay: A request that takes longer than 95% of
+    // recent ones is probably lost or queued, and a hedge is more likely to answer first than to waste a packet.
+    class RoundTrips final
     {
     public:
 
-        // Constructor:
-        WSA()
+        void Add(const Duration delay)
         {
-            // Initiates use of the Winsock DLL by a process.
-            // If successful, returns zero.
-            // On error, returns one of few error codes.
-            // Note: An application can call WSAStartup more than once if it needs to obtain the WSADATA structure information more than once.
-            // On each such call, the application can specify any version number (here: 2.2) supported by the Winsock DLL.
-            error_ = WSAStartup(MAKEWORD(2, 2), &data_);
+            std::lock_guard lock{ mutex_ };
+            delays_[next_ % delays_.size()] = delay;
+            ++next_;
         }
 
 
-        // Destructor:
-        ~WSA()
+        // The 95th percentile, or kDefault until there are enough delays to tell.
+        [[nodiscard]] Duration P95() const
         {
-            // Terminates use of the Winsock 2 DLL (Ws2_32.dll).
-            // The return value is zero if the operation was successful.
-            // On error, the value SOCKET_ERROR is returned, and a specific error number can be retrieved by calling WSAGetLastError().
-            // Attention: In multi-threaded environment, WSACleanup terminates Windows Sockets operations for all threads.
-            if (WSACleanup() == SOCKET_ERROR) {
-                [[maybe_unused]] const auto error{ WSAGetLastError() }; // For debug.
+            std::array<Duration, kHistory> delays{};
+            size_t count{ 0 };
+            {
+                std::lock_guard lock{ mutex_ };
+                count = std::min(next_, delays_.size());
+                std::copy_n(delays_.begin(), count, delays.begin());
+            }
+
+            if (count < kMinimum) {
+                return kDefault;
             }
+
+            const auto rank = delays.begin() + static_cast<std::ptrdiff_t>(count * 95 / 100);
+            std::nth_element(delays.begin(), rank, delays.begin() + static_cast<std::ptrdiff_t>(count));
+            return std::max(*rank, kFloor);
         }
 
+    private:
 
-        // Get Data:
-        const WSADATA& Data() const { return data_; }
+        static constexpr size_t kHistory = 64;
+        static constexpr size_t kMinimum = 8;
+        static constexpr Duration kDefault = std::chrono::milliseconds(250);
+        static constexpr Duration kFloor = std::chrono::milliseconds(5); // (Hedging faster than this only adds load.)
 
+        mutable std::mutex mutex_{};
+        std::array<Duration, kHistory> delays_{};
+        size_t next_{ 0 };
+    };
 
-        // Get Error:
-        const int Error() const { return error_; }
 
-    private:
+    RoundTrips round_trips{};
 
-        WSADATA data_{};
-        int error_{ 0 };
-    };
+
+    TimeCache& Cache()
+    {
+        static TimeCache& cache = *new TimeCache{}; // (Never destroyed: The background tasks use it until they are joined.)
+        return cache;
+    }
 
 }
 
@@ -280,48 +534,177 @@ namespace ntp_client
     // **** GetTime function (Main API) ****
     // 
     // Get time from an NTP server.
-    // Return 0 on error.
+    // Return 0 on error (or when the DNS or reply timeout expires).
+    // Concurrent calls for the same server share one DNS lookup and one exchange (see SingleFlight.h): A thundering
+    // herd at startup sends one request per server, not one per thread.
+    // A server that failed twice in a row fails fast (returns 0 at once) until a background probe finds it back
+    // (see CircuitBreaker.h), and a name that did not resolve is not looked up again for a minute.
     time_t GetTime(const char* hostname) // For examole: Google NTP server (time.google.com).
     {
-        time_t time_since_epoch{ 0 };
+        return GetTime(hostname, std::stop_token{});
+    }
+
+
+    // Cancellable: Return 0 also once stop is requested or the deadline passes, right away (the socket is released,
+    // and the exchange is left to the network).
+    time_t GetTime(const char* hostname, const std::stop_token& stop, const Deadline deadline)
+    {
+        if (!Admit(hostname)) {
+            return 0; // Known to be down: Fail fast.
+        }
+
+        const std::string name{ hostname };
+        return in_flight.Call(name, [&name](const std::stop_token& flight_stop, const Deadline flight_deadline) {
+            return QueryTime(name, flight_stop, flight_deadline);
+        }, stop, deadline).value_or(0);
+    }
+
+
+    // **** GetTime function (cached) ****
+    //
+    // Network time no older than max_age: The latest server time, extrapolated with the steady clock.
+    // Goes to the network only when there is no sample younger than max_age (and refreshes in the background shortly
+    // before that happens, so steady callers rarely wait). Return nothing on error, or once stop is requested.
+    std::optional<std::chrono::nanoseconds> GetTime(const char* hostname, const std::chrono::nanoseconds max_age, const std::stop_token& stop)
+    {
+        return Cache().Get(hostname, max_age, stop);
+    }
+
+
+    // **** Synchronize function ****
+    //
+    // Fast initial synchronization (iburst) against several NTP servers.
+    // Return the offset of the local clock (server time minus local time), or nothing on error.
+    std::optional<std::chrono::nanoseconds> Synchronize(const std::vector<std::string>& hostnames, const BurstOptions& options, const std::stop_token& stop)
+    {
         WSA wsa{};
+        ClientEngine<UdpTransport> engine{};
+
+        if (wsa.Error() != 0 || engine.GetTransport().Error() != 0) {
+            return std::nullopt;
+        }
+
+        for (const uint32_t address : Resolve(hostnames, stop)) {
+            const Endpoint endpoint{ address, htons(kNtpPort) };
+            if (address != 0 && std::none_of(engine.Peers().begin(), engine.Peers().end(), [&endpoint](const auto& peer) { return peer.endpoint_ == endpoint; })) {
+                engine.AddServer(endpoint); // (Names that resolve to the same address are one server.)
+            }
+        }
+
+        for (const uint32_t refid : LocalRefIds()) {
+            engine.AddLocalRefId(refid); // (Servers synchronized to this host are timing loops.)
+        }
 
-        if (wsa.Error() == 0) {
+        // Start all bursts at once. Each server gets its own burst, so the total time does not grow with the server count.
+        for (size_t i = 0; i < engine.Peers().size(); ++i) {
+            engine.Burst(i, options.count_, options.spacing_);
+        }
 
-            NtpMessage msg = {}; // Initializes the struct to its default values.
-            // Important, if you don't set the version/mode, the server will ignore you.
-            msg.version_ = 3;
-            msg.mode_ = 3; // Client
+        const auto ready = [&engine, &options] {
+            return std::all_of(engine.Peers().begin(), engine.Peers().end(), [&options](const auto& peer) {
+                return peer.denied_ || peer.filter_.Size() >= options.ready_samples_;
+            });
+        };
+
+        const auto deadline = std::chrono::steady_clock::now() + options.spacing_ * (options.count_ > 0 ? options.count_ - 1 : 0) + kReplyTimeout;
+        while (!engine.Peers().empty() && !ready()) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline || stop.stop_requested()) {
+                break;
+            }
 
-            // gethostbyname(name) retrieves host information corresponding to a host name from a host database.
-            // If no error occurs, gethostbyname returns a pointer to the hostent structure. Otherwise, it returns
-            // a null pointer and a specific error number can be retrieved by calling WSAGetLastError().
-            if (const auto host_information = gethostbyname(hostname); host_information != nullptr) {
-                // (on success:)
+            // Wait for replies until the next burst packet is due (or the deadline, or a stop request):
+            const auto wait = std::min(std::chrono::duration_cast<std::chrono::microseconds>(engine.RunBursts()),
+                std::chrono::duration_cast<std::chrono::microseconds>(deadline - now));
+            if (engine.GetTransport().Wait(wait, stop)) {
+                engine.Process();
+            }
+        }
 
-                // Converts the (Ipv4) Internet network address into an ASCII string in Internet standard dotted-decimal format:
-                const auto ip = inet_ntoa(*reinterpret_cast<struct in_addr*>(*host_information->h_addr_list));
+        if (stop.stop_requested()) {
+            return std::nullopt;
+        }
 
-                // Set up the sockaddr_in structure (ref.: https://docs.microsoft.com/en-us/windows/win32/winsock/sockaddr-2):
-                sockaddr_in server_address = {}; // Initializes the struct to its default values.
-                server_address.sin_family = AF_INET; // The AF_INET address family is the address family for IPv4.
-                server_address.sin_addr.s_addr = inet_addr(ip); // Converts a string containing an IPv4 dotted-decimal address into a proper address for the IN_ADDR structure.
-                server_address.sin_port = htons(123); // Converts a u_short from host to TCP/IP network byte order (which is big-endian).
+        if (const auto selection = engine.Synchronize(); selection.valid_) {
+            MonotonicClock::Global().Update(selection.offset_);
+            return selection.offset_;
+        }
 
-                if (const SOCKET socket = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP); socket != INVALID_SOCKET) { // Creates a UDP socket
-                    msg.SendTo(socket, &server_address); // <-- SEND
+        return std::nullopt;
+    }
 
-                    NtpMessage response = {}; // Initializes the struct to its default values.
-                    response.Receive(socket); // <-- RECEIVE
-                    time_since_epoch = response.tx_.ToTimeT();
-                }
 
-            } else {
-                [[maybe_unused]] const auto error{ WSAGetLastError() }; // For debug.
+    // **** Race function ****
+    //
+    // Hedged/raced query: Fan out, hedge at the p95 round trip, stop at the first valid reply (or quorum).
+    // Return the offset of the local clock (server time minus local time), or nothing on error.
+    std::optional<std::chrono::nanoseconds> Race(const std::vector<std::string>& hostnames, const RaceOptions& options, const std::stop_token& stop)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + options.timeout_; // (Name resolution included.)
+
+        WSA wsa{};
+        ClientEngine<UdpTransport> engine{};
+
+        if (wsa.Error() != 0 || engine.GetTransport().Error() != 0) {
+            return std::nullopt;
+        }
+
+        for (const uint32_t address : Resolve(hostnames, stop, deadline)) {
+            const Endpoint endpoint{ address, htons(kNtpPort) };
+            if (address != 0 && std::none_of(engine.Peers().begin(), engine.Peers().end(), [&endpoint](const auto& peer) { return peer.endpoint_ == endpoint; })) {
+                engine.AddServer(endpoint);
             }
         }
 
-        return time_since_epoch;
+        for (const uint32_t refid : LocalRefIds()) {
+            engine.AddLocalRefId(refid);
+        }
+
+        const size_t servers = engine.Peers().size();
+        const size_t max_requests = servers * std::max<size_t>(options.max_attempts_, 1);
+        size_t requests{ 0 };
+        for (; requests < std::min(options.fanout_, servers); ++requests) {
+            engine.Poll(requests);
+        }
+
+        const auto hedge_delay = std::chrono::duration_cast<std::chrono::microseconds>(round_trips.P95());
+        auto next_hedge = std::chrono::steady_clock::now() + hedge_delay;
+
+        std::optional<std::chrono::nanoseconds> offset{};
+        while (servers > 0) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline || stop.stop_requested()) {
+                break;
+            }
+
+            if (now >= next_hedge && requests < max_requests) {
+                engine.Poll(requests++ % servers); // Round robin: The servers not asked yet first, then second attempts.
+                next_hedge = now + hedge_delay;
+            }
+
+            const auto until = requests < max_requests ? std::min(next_hedge, deadline) : deadline;
+            if (!engine.GetTransport().Wait(std::chrono::duration_cast<std::chrono::microseconds>(until - now), stop) || engine.Process() == 0) {
+                continue;
+            }
+
+            // Every reply so far is a candidate: Done once quorum_ of them agree.
+            const Selection selection = engine.Synchronize();
+            if (selection.valid_ && selection.survivors_ >= std::max<size_t>(options.quorum_, 1)) {
+                offset = selection.offset_;
+                break;
+            }
+        }
+
+        // Learn the round trips for the next hedge delay. (The engine, and its socket, go away with whatever is still in
+        // flight: Late replies are dropped by the network stack.)
+        const Duration now = engine.Clock().Now();
+        for (const auto& peer : engine.Peers()) {
+            if (const auto best = peer.filter_.Best(now); best) {
+                round_trips.Add(best->delay_);
+            }
+        }
+
+        return offset;
     }
 
-}
\ No newline at end of file
+}
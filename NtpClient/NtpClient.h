@@ -24,11 +24,54 @@
     THE SOFTWARE.
 */
 
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <ctime> // For time_t.
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "NtpEngine.h" // For BurstOptions.
+
+
 namespace ntp_client
 {
 
     time_t GetTime(const char* hostname); // For examole: Google NTP server (time.google.com).
 
+    // Cancellable GetTime: Also returns 0 as soon as stop is requested or the deadline passes (releasing the socket at
+    // once). A caller that gives up does not fail concurrent callers sharing its query: They carry on without it.
+    time_t GetTime(const char* hostname, const std::stop_token& stop, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    // Network time (since the unix epoch) no older than max_age, from a per-server cache extrapolated with the steady
+    // clock. Only goes to the network when the cached sample is too old (refreshing in the background ahead of that).
+    // Returns nothing on error, or once stop is requested.
+    std::optional<std::chrono::nanoseconds> GetTime(const char* hostname, std::chrono::nanoseconds max_age, const std::stop_token& stop = {});
+
+    // Fast initial synchronization: Bursts of requests (iburst) to every server, pipelined, then filter and select.
+    // Returns the local clock offset (server time minus local time), or nothing if no majority of servers agree (or stop
+    // is requested).
+    std::optional<std::chrono::nanoseconds> Synchronize(const std::vector<std::string>& hostnames, const BurstOptions& options = {}, const std::stop_token& stop = {});
+
+
+    // **** RaceOptions struct ****
+
+    struct RaceOptions final
+    {
+        size_t fanout_{ SIZE_MAX };   // Servers queried at once. The rest are hedges: One more request (to the next server,
+                                      // then again to the first ones) each time the p95 round trip passes without an answer.
+        size_t quorum_{ 1 };          // Agreeing replies needed (1 = the first valid reply wins).
+        size_t max_attempts_{ 2 };    // Requests per server, hedges included.
+        std::chrono::milliseconds timeout_{ 2000 };
+    };
+
+
+    // Fastest answer: Query several servers at once (and hedge), and return the local clock offset as soon as the first
+    // valid reply, or the first quorum_ replies whose intervals agree (see Select), arrives. Requests still in flight
+    // are abandoned. Returns nothing if no quorum agrees before the timeout (or stop is requested).
+    std::optional<std::chrono::nanoseconds> Race(const std::vector<std::string>& hostnames, const RaceOptions& options = {}, const std::stop_token& stop = {});
+
 }
 
 
@@ -0,0 +1,642 @@
+#ifndef AMITG_FC_NTPCORE
+#define AMITG_FC_NTPCORE
+
+/*
+    NtpCore.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Header-only NTP core: Wire codec, timestamp math, clock filter and selection.
+// No OS dependencies (no sockets, no system clock), and everything is constexpr, so it can be inlined
+// into hot paths and tested at compile time with static_assert (see the end of this file).
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <ctime> // For time_t.
+#include <optional>
+#include <span>
+
+
+namespace ntp_client
+{
+
+    using Duration = std::chrono::nanoseconds; // All offsets, delays and dispersions.
+
+    constexpr int64_t kNanosecondsPerSecond = 1'000'000'000;
+    constexpr int64_t kSecondsFrom1900To1970 = 2'208'988'800; // 70 years, 17 of them leap years.
+    constexpr int64_t kFrequencyTolerancePpm = 15; // PHI: Maximum frequency error assumed for any clock (RFC 5905).
+
+
+    // Big-endian (network byte order) helpers.
+    // Note: Byte-wise shifts instead of reinterpreting memory, so the codec works at compile time and on any host.
+    [[nodiscard]] constexpr uint32_t GetBigEndian32(const uint8_t* data)
+    {
+        return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 |
+            static_cast<uint32_t>(data[2]) << 8 | static_cast<uint32_t>(data[3]);
+    }
+
+    constexpr void PutBigEndian32(uint8_t* data, const uint32_t value)
+    {
+        data[0] = static_cast<uint8_t>(value >> 24);
+        data[1] = static_cast<uint8_t>(value >> 16);
+        data[2] = static_cast<uint8_t>(value >> 8);
+        data[3] = static_cast<uint8_t>(value);
+    }
+
+
+    // **** Timestamp class ****
+
+    // NTP Fixed-Point Timestamp Format.
+    // Note: RFC 5905 (http://tools.ietf.org/html/rfc5905).
+    class Timestamp final
+    {
+    public:
+
+        uint32_t seconds_{ 0 }; // Seconds since Jan 1, 1900.
+        uint32_t fraction_{ 0 }; // Fractional part of seconds. Integer number of 2^-32 seconds.
+
+
+        // Convert to time_t.
+        // Returns the integer part of the timestamp in unix time_t format,
+        // which is seconds since Jan 1, 1970.
+        [[nodiscard]] constexpr time_t ToTimeT() const
+        {
+            // A leap year is a calendar year with an extra day. 17 leap years between 1900 and 1970:
+            // 1904, 1908, 1912, 1916, 1920, 1924, 1928, 1932, 1936, 1940, 1944, 1948, 1952, 1956, 1960, 1964, 1968
+            const time_t time_since_epoch = (seconds_ - kSecondsFrom1900To1970) & UINT32_MAX;
+
+            return time_since_epoch;
+        }
+
+
+        // Convert to time since the unix epoch (Jan 1, 1970), with the fraction.
+        [[nodiscard]] constexpr Duration ToUnixTime() const
+        {
+            return std::chrono::seconds(ToTimeT()) + FractionToDuration(fraction_);
+        }
+
+
+        // Convert from time since the unix epoch (Jan 1, 1970).
+        [[nodiscard]] static constexpr Timestamp FromUnixTime(const Duration time_since_epoch)
+        {
+            const int64_t nanoseconds = time_since_epoch.count();
+            const int64_t seconds = nanoseconds / kNanosecondsPerSecond, remainder = nanoseconds % kNanosecondsPerSecond;
+
+            // fraction = remainder * 2^32 / 10^9 (fits in 64 bits, since remainder < 2^30).
+            return Timestamp{ static_cast<uint32_t>(seconds + kSecondsFrom1900To1970),
+                static_cast<uint32_t>((static_cast<uint64_t>(remainder) << 32) / kNanosecondsPerSecond) };
+        }
+
+
+        // The timestamp as one 32.32 fixed-point number.
+        [[nodiscard]] constexpr uint64_t ToUint64() const { return static_cast<uint64_t>(seconds_) << 32 | fraction_; }
+
+        [[nodiscard]] static constexpr Timestamp FromUint64(const uint64_t value)
+        {
+            return Timestamp{ static_cast<uint32_t>(value >> 32), static_cast<uint32_t>(value) };
+        }
+
+
+        constexpr bool operator==(const Timestamp&) const = default;
+
+
+        // Convert a 32-bit fraction (2^-32 seconds) to nanoseconds.
+        [[nodiscard]] static constexpr Duration FractionToDuration(const uint32_t fraction)
+        {
+            return Duration((static_cast<uint64_t>(fraction) * kNanosecondsPerSecond) >> 32);
+        }
+    };
+
+
+    // NTP Short Format (16.16 fixed-point seconds), used for the root delay and root dispersion.
+    [[nodiscard]] constexpr Duration ShortToDuration(const uint32_t value)
+    {
+        return Duration(static_cast<int64_t>((static_cast<uint64_t>(value) * kNanosecondsPerSecond) >> 16));
+    }
+
+    [[nodiscard]] constexpr uint32_t DurationToShort(const Duration duration)
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(duration.count()) << 16) / kNanosecondsPerSecond);
+    }
+
+
+    // Signed difference a - b between two timestamps.
+    // The subtraction is done in 64-bit modular arithmetic, so it is correct across an era rollover
+    // (2036) as long as the two timestamps are less than 68 years apart.
+    [[nodiscard]] constexpr Duration Difference(const Timestamp a, const Timestamp b)
+    {
+        const auto difference = static_cast<int64_t>(a.ToUint64() - b.ToUint64()); // Signed 32.32 fixed point.
+
+        // Whole seconds (floor, also for negative differences) plus the always-positive fraction:
+        return std::chrono::seconds(difference >> 32) + Timestamp::FractionToDuration(static_cast<uint32_t>(difference));
+    }
+
+
+    // **** NtpMessage class ****
+
+    // A Network Time Protocol Message.
+    // According to RFC 5905 (http://tools.ietf.org/html/rfc5905).
+    class NtpMessage final
+    {
+    public:
+
+        static constexpr size_t kSize = 48; // Header only. (No extension fields, no MAC.)
+        using Packet = std::array<uint8_t, kSize>;
+
+        // The NTP packet header format, depicted in Figure 8 of RFC 5905, is as follows:
+        //
+        //       0                   1                   2                   3
+        //       0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |LI | VN  |Mode |    Stratum     |     Poll      |  Precision   |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                         Root Delay                            |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                         Root Dispersion                       |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                          Reference ID                         |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                                                               |
+        //      +                     Reference Timestamp (64)                  +
+        //      |                                                               |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                                                               |
+        //      +                      Origin Timestamp (64)                    +
+        //      |                                                               |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                                                               |
+        //      +                      Receive Timestamp (64)                   +
+        //      |                                                               |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                                                               |
+        //      +                      Transmit Timestamp (64)                  +
+        //      |                                                               |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                                                               |
+        //      .                                                               .
+        //      .                    Extension Field 1 (variable)               .
+        //      .                                                               .
+        //      |                                                               |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                                                               |
+        //      .                                                               .
+        //      .                    Extension Field 2 (variable)               .
+        //      .                                                               .
+        //      |                                                               |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                          Key Identifier                       |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //      |                                                               |
+        //      |                            dgst (128)                         |
+        //      |                                                               |
+        //      +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        //
+        // The NTP packet header consists of several fields, including Leap Indicator (LI), Version Number (VN), Mode,
+        // Stratum, Poll, Precision, Root Delay, Root Dispersion, Reference ID, Reference Timestamp, Origin Timestamp,
+        // Receive Timestamp, Transmit Timestamp, and Extension Fields.
+
+        uint8_t mode_ : 3 { 0 };         // (Bit-field: 3 bits) Mode of the message sender. 3 = Client, 4 = Server.
+        uint8_t version_ : 3 { 0 };      // (Bit-field: 3 bits) Protocol version. Should be set to 4.
+        uint8_t leap_ : 2 { 0 };         // (Bit-field: 2 bits) Leap seconds warning. See: RFC section 7.3 (http://tools.ietf.org/html/rfc5905#section-7.3).
+
+        uint8_t stratum_{ 0 };           // Servers between client and physical timekeeper. 1 = Server is Connected to Physical Source. 0 = Unknown.
+        uint8_t poll_{ 0 };              // Max Poll Rate. In log2 seconds.
+        uint8_t precision_{ 0 };         // Precision of the clock. In log2 seconds.
+
+        // (^^^ All that above: 4 bytes (32 bits) in total ^^^)
+
+        uint32_t root_delay_{ 0 };       // (32 bits in total) Root Delay. Round-trip delay to the primary reference. NTP Short Format.
+        uint32_t root_dispersion_{ 0 };  // (32 bits in total) Root Dispersion. Error budget to the primary reference. NTP Short Format.
+
+        uint8_t ref_clock_id_[4]{ 0 };   // (32 bits in total) Reference ID. For Stratum 1 devices, a 4-byte string. For other devices, 4-byte IP address.
+
+        Timestamp ref_{};                // (64 bits in total) Reference Timestamp. The time when the system clock was last updated.
+        Timestamp orig_{};               // (64 bits in total) Origin Timestamp. Send time of the request. Copied from the request.
+
+        Timestamp rx_{};                 // (64 bits in total) Receive Timestamp. Receive time of the request.
+        Timestamp tx_{};                 // (64 bits in total) Transmit Timestamp. Send time of the response. If only a single time is needed, use this one.
+
+
+        // Round-trip delay and dispersion from the server to its primary reference (decoded from the short format).
+        [[nodiscard]] constexpr Duration RootDelay() const { return ShortToDuration(root_delay_); }
+        [[nodiscard]] constexpr Duration RootDispersion() const { return ShortToDuration(root_dispersion_); }
+
+
+        // Encode to the wire format (network byte order).
+        [[nodiscard]] constexpr Packet Encode() const
+        {
+            Packet packet{};
+
+            packet[0] = static_cast<uint8_t>(leap_ << 6 | version_ << 3 | mode_);
+            packet[1] = stratum_;
+            packet[2] = poll_;
+            packet[3] = precision_;
+
+            PutBigEndian32(&packet[4], root_delay_);
+            PutBigEndian32(&packet[8], root_dispersion_);
+            std::copy(std::begin(ref_clock_id_), std::end(ref_clock_id_), &packet[12]);
+
+            PutTimestamp(&packet[16], ref_);
+            PutTimestamp(&packet[24], orig_);
+            PutTimestamp(&packet[32], rx_);
+            PutTimestamp(&packet[40], tx_);
+
+            return packet;
+        }
+
+
+        // Decode from the wire format (network byte order).
+        [[nodiscard]] static constexpr NtpMessage Decode(const Packet& packet)
+        {
+            NtpMessage message{};
+
+            message.leap_ = packet[0] >> 6;
+            message.version_ = packet[0] >> 3 & 0x07;
+            message.mode_ = packet[0] & 0x07;
+            message.stratum_ = packet[1];
+            message.poll_ = packet[2];
+            message.precision_ = packet[3];
+
+            message.root_delay_ = GetBigEndian32(&packet[4]);
+            message.root_dispersion_ = GetBigEndian32(&packet[8]);
+            std::copy(&packet[12], &packet[16], std::begin(message.ref_clock_id_));
+
+            message.ref_ = GetTimestamp(&packet[16]);
+            message.orig_ = GetTimestamp(&packet[24]);
+            message.rx_ = GetTimestamp(&packet[32]);
+            message.tx_ = GetTimestamp(&packet[40]);
+
+            return message;
+        }
+
+    private:
+
+        static constexpr void PutTimestamp(uint8_t* data, const Timestamp timestamp)
+        {
+            PutBigEndian32(data, timestamp.seconds_);
+            PutBigEndian32(data + 4, timestamp.fraction_);
+        }
+
+        [[nodiscard]] static constexpr Timestamp GetTimestamp(const uint8_t* data)
+        {
+            return Timestamp{ GetBigEndian32(data), GetBigEndian32(data + 4) };
+        }
+    };
+
+
+    // Convert a log2-seconds exponent (precision, poll) to a duration.
+    // The exponent often comes straight off the wire: It is clamped to [-63, 30], so no shift overflows (2^30 s is
+    // already 34 years, and 2^-63 s rounds to 0).
+    [[nodiscard]] constexpr Duration Log2ToDuration(const int8_t exponent)
+    {
+        const int clamped = std::clamp(static_cast<int>(exponent), -63, 30);
+        return clamped >= 0 ? Duration(kNanosecondsPerSecond << clamped) : Duration(kNanosecondsPerSecond >> -clamped);
+    }
+
+
+    // Sane clock precisions, log2 seconds: From 2^-32 s (the resolution of an NTP timestamp) to 1 s.
+    // A reply that claims anything else is bogus.
+    constexpr int8_t kMinPrecision = -32;
+    constexpr int8_t kMaxPrecision = 0;
+
+    [[nodiscard]] constexpr bool ValidPrecision(const int8_t precision) { return precision >= kMinPrecision && precision <= kMaxPrecision; }
+
+
+    // Dispersion added by PHI (the frequency tolerance) over an interval.
+    // (Split into whole and partial microseconds, so that long intervals cannot overflow.)
+    [[nodiscard]] constexpr Duration DispersionGrowth(const Duration interval)
+    {
+        const int64_t nanoseconds = interval.count();
+        return Duration(nanoseconds / 1'000'000 * kFrequencyTolerancePpm + nanoseconds % 1'000'000 * kFrequencyTolerancePpm / 1'000'000);
+    }
+
+
+    // **** Sample struct ****
+
+    // One on-wire measurement (RFC 5905, section 8):
+    //   T1 = Client transmit (origin), T2 = Server receive, T3 = Server transmit, T4 = Client receive.
+    struct Sample final
+    {
+        Duration offset_{ 0 };     // theta: Server clock minus local clock.
+        Duration delay_{ 0 };      // delta: Round-trip delay, excluding the server's processing time.
+        Duration dispersion_{ 0 }; // epsilon: Maximum error from precision and frequency tolerance.
+        Duration time_{ 0 };       // Local time (T4) the sample was taken, used for aging the dispersion.
+        Duration root_delay_{ 0 };      // The server's own distance to its primary reference (from the reply),
+        Duration root_dispersion_{ 0 }; // so the sample's total error budget reaches back to the reference.
+    };
+
+
+    [[nodiscard]] constexpr Sample MakeSample(const Timestamp t1, const Timestamp t2, const Timestamp t3, const Timestamp t4, const int8_t server_precision, const int8_t local_precision)
+    {
+        Sample sample{};
+
+        sample.offset_ = (Difference(t2, t1) + Difference(t3, t4)) / 2;
+        sample.delay_ = std::max(Difference(t4, t1) - Difference(t3, t2), Log2ToDuration(local_precision));
+        sample.dispersion_ = Log2ToDuration(server_precision) + Log2ToDuration(local_precision) + DispersionGrowth(Difference(t4, t1));
+        sample.time_ = t4.ToUnixTime();
+
+        return sample;
+    }
+
+
+    // Synchronization distance of a sample: Half the round trip plus the dispersion.
+    // This is the half-width of the interval that must contain the true offset.
+    [[nodiscard]] constexpr Duration Distance(const Sample& sample)
+    {
+        return sample.delay_ / 2 + sample.dispersion_;
+    }
+
+
+    // Root distance of a sample (RFC 5905, section 11.2): The distance all the way to the primary reference.
+    // The true time is within this distance of the sample's offset, as long as the server (and its upstream) is correct.
+    [[nodiscard]] constexpr Duration RootDistance(const Sample& sample)
+    {
+        return Distance(sample) + sample.root_delay_ / 2 + sample.root_dispersion_;
+    }
+
+
+    // Samples with a larger root distance are too far from any reference to discipline a clock (MAXDIST, RFC 5905).
+    constexpr Duration kMaxDistance = std::chrono::seconds(1);
+
+
+    // **** ClockFilter class ****
+
+    // Clock filter (RFC 5905, section 10).
+    // Keeps the last kDepth samples from one server and picks the one with the lowest delay, since the sample
+    // with the least queuing is the one whose offset is least affected by path asymmetry.
+    template <size_t kDepth = 8>
+    class ClockFilter final
+    {
+        static_assert(kDepth > 0, "The filter needs at least one stage.");
+
+    public:
+
+        constexpr void Add(const Sample& sample)
+        {
+            samples_[next_] = sample;
+            next_ = (next_ + 1) % kDepth;
+            count_ = std::min(count_ + 1, kDepth);
+        }
+
+
+        // The best (minimum delay) sample, with its dispersion aged up to now.
+        [[nodiscard]] constexpr std::optional<Sample> Best(const Duration now) const
+        {
+            if (count_ == 0) {
+                return std::nullopt;
+            }
+
+            const Sample* best = &samples_[0];
+            for (size_t i = 1; i < count_; ++i) {
+                if (samples_[i].delay_ < best->delay_) {
+                    best = &samples_[i];
+                }
+            }
+
+            Sample aged = *best;
+            aged.dispersion_ += DispersionGrowth(now - best->time_);
+            return aged;
+        }
+
+
+        // Jitter: RMS of the offset differences relative to the best sample.
+        [[nodiscard]] constexpr Duration Jitter(const Duration now) const
+        {
+            const auto best = Best(now);
+            if (!best || count_ < 2) {
+                return Duration(0);
+            }
+
+            double sum{ 0 };
+            for (size_t i = 0; i < count_; ++i) {
+                const double difference = static_cast<double>((samples_[i].offset_ - best->offset_).count());
+                sum += difference * difference;
+            }
+
+            return Duration(static_cast<int64_t>(SquareRoot(sum / static_cast<double>(count_ - 1))));
+        }
+
+
+        [[nodiscard]] constexpr size_t Size() const { return count_; }
+
+        [[nodiscard]] static constexpr size_t Depth() { return kDepth; }
+
+    private:
+
+        // (std::sqrt is not constexpr before C++26.)
+        [[nodiscard]] static constexpr double SquareRoot(const double value)
+        {
+            if (value <= 0) {
+                return 0;
+            }
+
+            double root = value;
+            for (int i = 0; i < 64; ++i) {
+                root = (root + value / root) / 2;
+            }
+            return root;
+        }
+
+        std::array<Sample, kDepth> samples_{};
+        size_t next_{ 0 };
+        size_t count_{ 0 };
+    };
+
+
+    // **** Selection ****
+
+    // A server offered to the selection algorithm: Its filtered offset and the half-width of its correctness interval.
+    struct Candidate final
+    {
+        Duration offset_{ 0 };
+        Duration distance_{ 0 };
+    };
+
+
+    struct Selection final
+    {
+        bool valid_{ false };     // False if no majority of candidates agree (or there are no candidates).
+        size_t survivors_{ 0 };   // Candidates whose interval overlaps the intersection (the truechimers).
+        Duration low_{ 0 };       // The intersection interval, which contains the true time...
+        Duration high_{ 0 };      // ...if a majority of the candidates are correct.
+        Duration offset_{ 0 };    // Survivor offsets, averaged with weights 1/distance.
+    };
+
+
+    constexpr size_t kMaxCandidates = 32; // (Extra candidates are ignored.)
+
+
+    // Intersection algorithm (RFC 5905, section 11.2.1, a variant of Marzullo's algorithm):
+    // Find the smallest interval that contains points from the correctness intervals of a majority of
+    // candidates, allowing for f falsetickers, with f as small as possible.
+    [[nodiscard]] constexpr Selection Select(const std::span<const Candidate> all_candidates)
+    {
+        const auto candidates = all_candidates.first(std::min(all_candidates.size(), kMaxCandidates));
+        const size_t count = candidates.size();
+
+        // Endpoints: Lower edge (type -1), midpoint (type 0), upper edge (type +1).
+        struct Endpoint final
+        {
+            Duration value_{ 0 };
+            int type_{ 0 };
+        };
+
+        std::array<Endpoint, kMaxCandidates * 3> endpoints{};
+        for (size_t i = 0; i < count; ++i) {
+            endpoints[i * 3] = { candidates[i].offset_ - candidates[i].distance_, -1 };
+            endpoints[i * 3 + 1] = { candidates[i].offset_, 0 };
+            endpoints[i * 3 + 2] = { candidates[i].offset_ + candidates[i].distance_, +1 };
+        }
+
+        const auto end = endpoints.begin() + count * 3;
+        std::sort(endpoints.begin(), end, [](const Endpoint& a, const Endpoint& b) {
+            return a.value_ < b.value_ || (a.value_ == b.value_ && a.type_ < b.type_);
+        });
+
+        Selection selection{};
+
+        for (size_t falsetickers = 0; falsetickers * 2 < count; ++falsetickers) {
+            const auto majority = static_cast<int>(count - falsetickers);
+            size_t found{ 0 };
+            int chime{ 0 };
+            selection.low_ = Duration::max(); // (Not the previous pass's edges: An edge not found this pass fails the test below.)
+            selection.high_ = Duration::min();
+
+            for (auto it = endpoints.begin(); it != end; ++it) {
+                chime -= it->type_;
+                if (chime >= majority) {
+                    selection.low_ = it->value_;
+                    break;
+                }
+                if (it->type_ == 0) {
+                    ++found;
+                }
+            }
+
+            chime = 0;
+            for (auto it = end; it != endpoints.begin();) {
+                --it;
+                chime += it->type_;
+                if (chime >= majority) {
+                    selection.high_ = it->value_;
+                    break;
+                }
+                if (it->type_ == 0) {
+                    ++found;
+                }
+            }
+
+            if (found <= falsetickers && selection.low_ < selection.high_) {
+                selection.valid_ = true;
+                break;
+            }
+        }
+
+        if (!selection.valid_) {
+            return Selection{};
+        }
+
+        // Combine the survivors (RFC 5905, section 11.2.3), weighting each by the inverse of its distance:
+        double weighted_sum{ 0 }, weights{ 0 };
+        for (const auto& candidate : candidates) {
+            if (candidate.offset_ + candidate.distance_ < selection.low_ || candidate.offset_ - candidate.distance_ > selection.high_) {
+                continue;
+            }
+
+            const double weight = 1.0 / static_cast<double>(std::max(candidate.distance_.count(), int64_t{ 1 }));
+            weighted_sum += weight * static_cast<double>(candidate.offset_.count());
+            weights += weight;
+            ++selection.survivors_;
+        }
+
+        selection.offset_ = Duration(static_cast<int64_t>(weighted_sum / weights));
+        return selection;
+    }
+
+
+    // **** Compile-time checks ****
+
+    namespace detail
+    {
+
+        constexpr bool CodecRoundTrips()
+        {
+            NtpMessage message{};
+            message.leap_ = 3;
+            message.version_ = 4;
+            message.mode_ = 4;
+            message.stratum_ = 2;
+            message.root_delay_ = 0x00010203;
+            message.root_dispersion_ = 0x00008000;
+            message.tx_ = Timestamp{ 0xE9000000, 0x80000000 };
+
+            const auto packet = message.Encode();
+            const auto decoded = NtpMessage::Decode(packet);
+
+            return packet[0] == 0xE4 && packet[4] == 0x00 && packet[7] == 0x03 && decoded.leap_ == 3 && decoded.version_ == 4 &&
+                decoded.mode_ == 4 && decoded.stratum_ == 2 && decoded.root_delay_ == 0x00010203 && decoded.tx_ == message.tx_ &&
+                decoded.RootDispersion() == std::chrono::milliseconds(500);
+        }
+
+
+        constexpr bool OffsetAndDelay()
+        {
+            // Server 100 ms ahead, 20 ms each way, 1 ms server processing:
+            const auto t1 = Timestamp::FromUnixTime(std::chrono::seconds(1'700'000'000));
+            const auto t2 = Timestamp::FromUnixTime(t1.ToUnixTime() + std::chrono::milliseconds(120));
+            const auto t3 = Timestamp::FromUnixTime(t2.ToUnixTime() + std::chrono::milliseconds(1));
+            const auto t4 = Timestamp::FromUnixTime(t3.ToUnixTime() - std::chrono::milliseconds(80));
+            const auto sample = MakeSample(t1, t2, t3, t4, -20, -20);
+
+            const auto near = [](const Duration a, const Duration b) { return (a - b).count() > -10 && (a - b).count() < 10; };
+            return near(sample.offset_, std::chrono::milliseconds(100)) && near(sample.delay_, std::chrono::milliseconds(40));
+        }
+
+
+        constexpr bool SelectionRejectsFalseticker()
+        {
+            using std::chrono::milliseconds;
+            const std::array<Candidate, 4> candidates{ {
+                { milliseconds(10), milliseconds(5) }, { milliseconds(12), milliseconds(5) },
+                { milliseconds(11), milliseconds(5) }, { milliseconds(500), milliseconds(5) } } };
+
+            const auto selection = Select(candidates);
+            return selection.valid_ && selection.survivors_ == 3 && selection.offset_ > milliseconds(10) && selection.offset_ < milliseconds(12);
+        }
+
+    }
+
+    static_assert(sizeof(NtpMessage::Packet) == 48);
+    static_assert(Difference(Timestamp{ 0, 0 }, Timestamp{ UINT32_MAX, 0 }) == std::chrono::seconds(1), "Era rollover.");
+    static_assert(Timestamp{ 2'208'988'800, 0 }.ToTimeT() == 0);
+    static_assert(ShortToDuration(0x00018000) == std::chrono::milliseconds(1500));
+    static_assert(DurationToShort(std::chrono::milliseconds(1500)) == 0x00018000);
+    static_assert(detail::CodecRoundTrips());
+    static_assert(detail::OffsetAndDelay());
+    static_assert(detail::SelectionRejectsFalseticker());
+
+}
+
+
+#endif
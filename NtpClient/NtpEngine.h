@@ -0,0 +1,710 @@
+#ifndef AMITG_FC_NTPENGINE
+#define AMITG_FC_NTPENGINE
+
+/*
+    NtpEngine.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Client engine, parameterised by policies (transport, clock source, authentication, filter depth, allocator).
+// Policies are plain classes resolved at compile time, so a feature that is not selected (for example,
+// authentication) leaves no code and no data behind. Like NtpCore.h, this header has no OS dependencies;
+// the Winsock transport lives in UdpTransport.h.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <memory> // For std::allocator and std::allocator_traits.
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "Columnar.h"
+#include "NonceTable.h"
+#include "NtpCore.h"
+#include "ReferenceDriver.h"
+#include "RefId.h"
+
+// MSVC ignores the standard attribute (for ABI reasons) and only honors its own spelling.
+#if defined(_MSC_VER)
+#define NTP_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define NTP_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
+
+namespace ntp_client
+{
+
+    // **** Endpoint struct ****
+
+    // IPv4 endpoint, both fields in network byte order (as they appear in sockaddr_in).
+    struct Endpoint final
+    {
+        uint32_t address_{ 0 };
+        uint16_t port_{ 0 };
+
+        constexpr bool operator==(const Endpoint&) const = default;
+    };
+
+
+    // **** Clock source policies ****
+
+    // The system (wall) clock. Stateless.
+    struct SystemClock final
+    {
+        static constexpr int8_t kPrecision = -20; // log2 seconds (about 1 microsecond).
+
+        [[nodiscard]] Duration Now() const
+        {
+            return std::chrono::duration_cast<Duration>(std::chrono::system_clock::now().time_since_epoch());
+        }
+    };
+
+
+    // **** Authentication policies ****
+
+    // No authentication. kEnabled = false compiles the signing and verification steps out of the engine.
+    // An authentication policy provides:
+    //   static constexpr bool kEnabled;
+    //   static constexpr size_t kMacSize;                                     // Bytes appended after the 48-byte header.
+    //   void Sign(const NtpMessage::Packet& header, std::span<uint8_t> mac);
+    //   bool Verify(const NtpMessage::Packet& header, std::span<const uint8_t> mac) const;
+    struct NoAuthentication final
+    {
+        static constexpr bool kEnabled = false;
+        static constexpr size_t kMacSize = 0;
+
+        void Sign(const NtpMessage::Packet&, std::span<uint8_t>) {}
+        [[nodiscard]] bool Verify(const NtpMessage::Packet&, std::span<const uint8_t>) const { return true; }
+    };
+
+
+    // **** Peer struct ****
+
+    // Per-server state of the engine.
+    template <size_t kFilterDepth>
+    struct Peer final
+    {
+        static constexpr size_t kMaxOutstanding = 8; // Requests in flight at once (a whole burst).
+
+        Endpoint endpoint_{};
+        ReferenceDriver* reference_{ nullptr }; // Set for a local reference clock (instead of a server endpoint).
+        std::array<uint64_t, kMaxOutstanding> outstanding_{}; // Nonces of our unanswered requests (0 = free slot; see NonceTable.h).
+        size_t next_outstanding_{ 0 };     // Slot for the next request (round robin: the oldest is dropped when all are in use).
+        ClockFilter<kFilterDepth> filter_{};
+        uint8_t stratum_{ 0 };
+        uint8_t reach_{ 0 };               // Shift register: Bit 0 is set when the latest poll was answered.
+        bool denied_{ false };             // Kissed with DENY or RSTR: Never queried again.
+        uint32_t refid_{ 0 };              // Reference ID of the latest reply (see RefId.h).
+
+        size_t burst_remaining_{ 0 };      // Burst packets still to be sent.
+        Duration burst_spacing_{ 0 };
+        Duration next_burst_{ 0 };         // When the next burst packet is due (engine clock).
+    };
+
+
+    // **** BurstOptions struct ****
+
+    // iburst: On first contact, send a short burst of requests instead of a single one, so the clock filter
+    // fills up (and converges) within seconds instead of after several poll intervals.
+    struct BurstOptions final
+    {
+        size_t count_{ 8 };                                   // Packets per server (4 to 8 is typical).
+        Duration spacing_{ std::chrono::seconds(2) };         // Time between packets of a burst.
+        size_t ready_samples_{ 4 };                           // Samples per server that are enough to call the clock set.
+    };
+
+
+    // **** SampleLog struct ****
+
+    // Every sample the engine accepts, column-wise (see ClientEngine::SetSampleLog).
+    struct SampleLog final
+    {
+        std::vector<int64_t> time_{};       // Nanoseconds since the unix epoch (local clock, at T4).
+        std::vector<uint32_t> peer_{};      // Index in ClientEngine::Peers().
+        std::vector<uint8_t> stratum_{};    // 0 for reference clocks.
+        std::vector<int64_t> offset_{};     // Nanoseconds.
+        std::vector<int64_t> delay_{};      // Nanoseconds.
+        std::vector<int64_t> dispersion_{}; // Nanoseconds.
+
+
+        void Append(const size_t peer, const uint8_t stratum, const Sample& sample)
+        {
+            time_.push_back(sample.time_.count());
+            peer_.push_back(static_cast<uint32_t>(peer));
+            stratum_.push_back(stratum);
+            offset_.push_back(sample.offset_.count());
+            delay_.push_back(sample.delay_.count());
+            dispersion_.push_back(sample.dispersion_.count());
+        }
+
+
+        [[nodiscard]] size_t Size() const { return time_.size(); }
+
+        void Clear() { *this = SampleLog{}; }
+
+
+        // Write the log as a columnar binary file (Columnar.h). Returns false if a write failed.
+        bool WriteColumnar(std::ostream& stream) const
+        {
+            ColumnarWriter writer(stream);
+            writer.AddColumn("time_ns", time_);
+            writer.AddColumn("peer", peer_);
+            writer.AddColumn("stratum", stratum_);
+            writer.AddColumn("offset_ns", offset_);
+            writer.AddColumn("delay_ns", delay_);
+            writer.AddColumn("dispersion_ns", dispersion_);
+            return writer.Finish();
+        }
+    };
+
+
+    // **** TimeEstimate struct ****
+
+    // The selected offset with a guaranteed error bound: The true offset is within [offset_ - error_, offset_ + error_]
+    // at local time time_, provided a majority of the servers are correct (the assumption of the selection itself). (The bound then grows with time; see IntervalClock.)
+    struct TimeEstimate final
+    {
+        bool valid_{ false };
+        Duration time_{ 0 };   // Local clock time of the estimate.
+        Duration offset_{ 0 };
+        Duration error_{ 0 };
+    };
+
+
+    // **** EngineStatus struct ****
+
+    // Counters of a ClientEngine.
+    struct EngineCounters final
+    {
+        uint64_t sent_{ 0 };      // Requests sent.
+        uint64_t received_{ 0 };  // Datagrams received.
+        uint64_t accepted_{ 0 };  // Valid samples (server replies and reference readings).
+        uint64_t rejected_{ 0 };  // Received datagrams that were not valid replies (runts, bad MAC, unknown source, bogus).
+        uint64_t kisses_{ 0 };    // Kiss-o'-death replies (also counted as rejected).
+        uint64_t loops_{ 0 };     // Replies rejected as timing loops (also counted as rejected).
+    };
+
+
+    struct PeerStatus final
+    {
+        Endpoint endpoint_{};
+        uint8_t reference_{ 0 };   // 1 for a local reference clock.
+        uint8_t stratum_{ 0 };
+        uint8_t reach_{ 0 };
+        uint32_t samples_{ 0 };    // In the clock filter.
+        int64_t offset_{ 0 };      // Best filtered sample, nanoseconds.
+        int64_t delay_{ 0 };
+        int64_t dispersion_{ 0 };
+        int64_t jitter_{ 0 };
+        int64_t root_delay_{ 0 };  // Reported by the server.
+        int64_t root_dispersion_{ 0 };
+        uint32_t refid_{ 0 };
+        uint8_t denied_{ 0 };      // 1 after a DENY or RSTR kiss-o'-death.
+    };
+
+
+    // A point-in-time copy of the engine state, for monitoring (see Seqlock.h and ControlServer.h).
+    // Fixed size and trivially copyable, so it can be published without allocations or locks.
+    struct EngineStatus final
+    {
+        int64_t time_{ 0 };        // When the snapshot was taken, nanoseconds since the unix epoch.
+        EngineCounters counters_{};
+        uint8_t valid_{ 0 };       // Selection result.
+        uint32_t survivors_{ 0 };
+        int64_t offset_{ 0 };
+        uint32_t peer_count_{ 0 }; // Entries used in peers_ (the first kMaxCandidates peers).
+        std::array<PeerStatus, kMaxCandidates> peers_{};
+    };
+
+
+    // **** LoopEvents enum ****
+
+    // What an event loop reports to ClientEngine::Process(events) (bit flags).
+    enum LoopEvents : unsigned
+    {
+        kNoEvents = 0,
+        kReadable = 1 << 0,  // The transport's socket is readable.
+        kTimeout = 1 << 1    // NextTimeout() has expired.
+    };
+
+
+    // **** ClientEngine class ****
+
+    // Polls a set of servers, validates the replies, runs one clock filter per server and selects the
+    // consensus offset.
+    // The engine never blocks: Poll() sends, Process() consumes whatever replies the transport already has.
+    // It owns no thread and no timer, so it can run on the host application's event loop: Register the transport's
+    // socket for readability, arm a timer for NextTimeout(), and call Process(events) when either fires.
+    //
+    // A transport policy provides:
+    //   bool Send(const Endpoint& to, std::span<const uint8_t> datagram);
+    //   int Receive(std::span<uint8_t> datagram, Endpoint& from);  // Bytes received, -1 if nothing is pending.
+    //
+    // Allocator supplies all the memory the engine allocates: The peers, the refid tables and the table of requests
+    // in flight. (A SampleLog, if set, is the caller's own.)
+    template <typename Transport, typename ClockSource = SystemClock, typename Authenticator = NoAuthentication,
+        size_t kFilterDepth = 8, typename Allocator = std::allocator<std::byte>>
+    class ClientEngine final
+    {
+    public:
+
+        using PeerType = Peer<kFilterDepth>;
+        using PeerAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<PeerType>;
+        using Request = typename NonceTable<Allocator>::Request;
+
+        static constexpr size_t kDatagramSize = NtpMessage::kSize + Authenticator::kMacSize;
+        static constexpr size_t kReceiveSize = 512; // Larger than any reply (header, extension fields, MAC), so none is truncated.
+
+
+        // Constructor:
+        ClientEngine() = default;
+
+        explicit ClientEngine(const Allocator& allocator) : peers_(PeerAllocator(allocator)), local_refids_(allocator),
+            peer_addresses_(allocator), requests_(allocator)
+        {
+
+        }
+
+
+        // Add a server. Returns its index in Peers().
+        size_t AddServer(const Endpoint& endpoint)
+        {
+            peers_.push_back(PeerType{ endpoint });
+            peer_addresses_.Insert(endpoint.address_, static_cast<uint32_t>(peers_.size() - 1));
+            return peers_.size() - 1;
+        }
+
+
+        // Add a reference ID that points at this host (see LocalRefIds()): Servers that report it are synchronized
+        // to us, and are rejected as timing loops.
+        void AddLocalRefId(const uint32_t refid) { local_refids_.Insert(refid, 0); }
+
+
+        // Add a local reference clock. Its samples go through a clock filter and the selection, like a server's.
+        // The driver must outlive the engine. Returns its index in Peers().
+        size_t AddReference(ReferenceDriver& driver)
+        {
+            PeerType peer{};
+            peer.reference_ = &driver;
+            peers_.push_back(peer);
+            return peers_.size() - 1;
+        }
+
+
+        // Send one request to every server.
+        void Poll()
+        {
+            for (size_t index = 0; index < peers_.size(); ++index) {
+                Poll(index);
+            }
+        }
+
+
+        // Collect new readings from all reference clocks. Returns the number of samples added.
+        size_t PollReferences()
+        {
+            size_t samples{ 0 };
+            for (auto& peer : peers_) {
+                if (peer.reference_ == nullptr) {
+                    continue;
+                }
+
+                peer.reach_ <<= 1;
+                while (const auto sample = peer.reference_->Poll()) {
+                    peer.filter_.Add(*sample);
+                    if (log_ != nullptr) {
+                        log_->Append(static_cast<size_t>(&peer - peers_.data()), 0, *sample);
+                    }
+                    peer.reach_ |= 1;
+                    ++counters_.accepted_;
+                    ++samples;
+                }
+            }
+
+            return samples;
+        }
+
+
+        // Send one request to a single server (not to a reference clock, or a server that denied us).
+        // Every poll shifts the server's reach register, so an unanswered one shows up as a 0 bit.
+        bool Poll(const size_t index)
+        {
+            PeerType& peer = peers_[index];
+            if (peer.reference_ != nullptr || peer.denied_) {
+                return false;
+            }
+
+            peer.reach_ <<= 1;
+            return Send(peer);
+        }
+
+
+        // Start a burst to a server: count requests, spacing apart, the first one right away.
+        // The packets are pipelined: Each one goes out on schedule, whether or not the previous ones were answered.
+        void Burst(const size_t index, const size_t count, const Duration spacing)
+        {
+            PeerType& peer = peers_[index];
+            peer.burst_remaining_ = count;
+            peer.burst_spacing_ = spacing;
+            peer.next_burst_ = clock_.Now();
+            RunBursts();
+        }
+
+
+        // Send every burst packet that is due.
+        // Returns the time until the next one is due (Duration::max() if no burst is in progress), which is how long
+        // the caller may wait for replies before calling again.
+        Duration RunBursts()
+        {
+            const Duration now = clock_.Now();
+            Duration next = Duration::max();
+
+            for (size_t index = 0; index < peers_.size(); ++index) {
+                PeerType& peer = peers_[index];
+                if (peer.denied_) {
+                    peer.burst_remaining_ = 0;
+                }
+
+                if (peer.burst_remaining_ > 0 && peer.next_burst_ <= now) {
+                    Poll(index);
+                    --peer.burst_remaining_;
+                    peer.next_burst_ += peer.burst_spacing_;
+                }
+
+                if (peer.burst_remaining_ > 0) {
+                    next = std::min(next, std::max(peer.next_burst_ - now, Duration(0)));
+                }
+            }
+
+            return next;
+        }
+
+
+        // Poll every server every interval, from Process(events) (0 = off: The caller calls Poll() itself).
+        void SetPollInterval(const Duration interval)
+        {
+            poll_interval_ = interval;
+            next_poll_ = clock_.Now();
+        }
+
+
+        // Time until the engine needs Process(events) even if no reply arrives: The next burst packet or poll.
+        // Duration::max() if nothing is scheduled.
+        [[nodiscard]] Duration NextTimeout() const
+        {
+            const Duration now = clock_.Now();
+            Duration next = poll_interval_ > Duration(0) ? std::max(next_poll_ - now, Duration(0)) : Duration::max();
+
+            for (const auto& peer : peers_) {
+                if (peer.burst_remaining_ > 0 && !peer.denied_) {
+                    next = std::min(next, std::max(peer.next_burst_ - now, Duration(0)));
+                }
+            }
+
+            return next;
+        }
+
+
+        // Event loop entry point. Never blocks: Consumes the pending replies if events has kReadable, then sends
+        // whatever is due (burst packets, the periodic poll). Returns the number of valid samples added.
+        size_t Process(const unsigned events)
+        {
+            const size_t samples = (events & kReadable) != 0 ? Process() : 0;
+
+            if (const Duration now = clock_.Now(); poll_interval_ > Duration(0) && now >= next_poll_) {
+                Poll();
+                next_poll_ = std::max(next_poll_ + poll_interval_, now); // (After a stall: Poll once, not once per missed interval.)
+            }
+
+            RunBursts();
+            return samples;
+        }
+
+
+        // Consume all pending replies. Returns the number of valid samples added.
+        size_t Process()
+        {
+            size_t samples{ 0 };
+            std::array<uint8_t, kReceiveSize> datagram{};
+            Endpoint from{};
+
+            for (int bytes_received; (bytes_received = transport_.Receive(datagram, from)) >= 0;) {
+                ++counters_.received_;
+                if (static_cast<size_t>(bytes_received) < kDatagramSize) {
+                    ++counters_.rejected_;
+                    continue; // Runt (or missing MAC).
+                }
+
+                const Duration now = clock_.Now(); // T4: As close to the receive as possible.
+
+                NtpMessage::Packet header{};
+                std::copy_n(datagram.begin(), NtpMessage::kSize, header.begin());
+
+                if constexpr (Authenticator::kEnabled) {
+                    if (!authenticator_.Verify(header, std::span<const uint8_t>(datagram).subspan(NtpMessage::kSize, Authenticator::kMacSize))) {
+                        ++counters_.rejected_;
+                        continue;
+                    }
+                }
+
+                const NtpMessage reply = NtpMessage::Decode(header);
+                if (const Request* request = FindRequest(from, reply); request != nullptr && Accept(*request, reply, now)) {
+                    ++counters_.accepted_;
+                    ++samples;
+                }
+                else {
+                    ++counters_.rejected_;
+                }
+            }
+
+            return samples;
+        }
+
+
+        // Run the selection algorithm over the filtered samples of all servers.
+        // Candidates are weighted by root distance, so a server far from its primary reference (high stratum, long
+        // upstream paths) counts less than a close one, even when the path to us is just as short.
+        [[nodiscard]] Selection Synchronize() const
+        {
+            const Duration now = clock_.Now();
+
+            std::array<Candidate, kMaxCandidates> candidates{};
+            size_t count{ 0 };
+            for (const auto& peer : peers_) {
+                if (count == candidates.size()) {
+                    break;
+                }
+
+                if (const auto best = peer.filter_.Best(now); best) {
+                    candidates[count++] = Candidate{ best->offset_, RootDistance(*best) };
+                }
+            }
+
+            return Select(std::span<const Candidate>(candidates.data(), count));
+        }
+
+
+        // Record every accepted sample (from servers and reference clocks) in log. nullptr stops logging.
+        // The log must outlive the engine, or logging must be stopped first.
+        void SetSampleLog(SampleLog* log) { log_ = log; }
+
+
+        // Run the selection and bound its error by the intersection interval (see Select()): If a majority of the
+        // servers are correct, the true offset is in [low_, high_], so the selected offset is within the larger of its
+        // distances to the two ends. (Not the tightest single server: That one may be a surviving falseticker.)
+        [[nodiscard]] TimeEstimate Estimate() const
+        {
+            const Selection selection = Synchronize();
+            if (!selection.valid_) {
+                return TimeEstimate{};
+            }
+
+            const Duration error = std::max(selection.high_ - selection.offset_, selection.offset_ - selection.low_);
+            return TimeEstimate{ true, clock_.Now(), selection.offset_, error };
+        }
+
+
+        // Take a snapshot of the engine state (cheap enough to do after every Process()).
+        [[nodiscard]] EngineStatus Status() const
+        {
+            const Duration now = clock_.Now();
+            const Selection selection = Synchronize();
+
+            EngineStatus status{};
+            status.time_ = now.count();
+            status.counters_ = counters_;
+            status.valid_ = selection.valid_ ? 1 : 0;
+            status.survivors_ = static_cast<uint32_t>(selection.survivors_);
+            status.offset_ = selection.offset_.count();
+            status.peer_count_ = static_cast<uint32_t>(std::min(peers_.size(), status.peers_.size()));
+
+            for (uint32_t i = 0; i < status.peer_count_; ++i) {
+                const PeerType& peer = peers_[i];
+                PeerStatus& entry = status.peers_[i];
+                entry.endpoint_ = peer.endpoint_;
+                entry.reference_ = peer.reference_ != nullptr ? 1 : 0;
+                entry.stratum_ = peer.stratum_;
+                entry.reach_ = peer.reach_;
+                entry.samples_ = static_cast<uint32_t>(peer.filter_.Size());
+                if (const auto best = peer.filter_.Best(now); best) {
+                    entry.offset_ = best->offset_.count();
+                    entry.delay_ = best->delay_.count();
+                    entry.dispersion_ = best->dispersion_.count();
+                    entry.jitter_ = peer.filter_.Jitter(now).count();
+                    entry.root_delay_ = best->root_delay_.count();
+                    entry.root_dispersion_ = best->root_dispersion_.count();
+                }
+                entry.refid_ = peer.refid_;
+                entry.denied_ = peer.denied_ ? 1 : 0;
+            }
+
+            return status;
+        }
+
+
+        [[nodiscard]] const EngineCounters& Counters() const { return counters_; }
+
+        [[nodiscard]] const std::vector<PeerType, PeerAllocator>& Peers() const { return peers_; }
+
+        Transport& GetTransport() { return transport_; }
+        ClockSource& Clock() { return clock_; }
+        Authenticator& Authentication() { return authenticator_; }
+
+    private:
+
+        bool Send(PeerType& peer)
+        {
+            uint64_t nonce = NewNonce();
+            while (requests_.Find(nonce) != nullptr) {
+                nonce = NewNonce();
+            }
+
+            NtpMessage request{};
+            request.version_ = 4;
+            request.mode_ = 3; // Client
+            request.tx_ = Timestamp::FromUint64(nonce); // The server echoes it back as the origin timestamp.
+
+            std::array<uint8_t, kDatagramSize> datagram{};
+            const auto header = request.Encode();
+            std::copy(header.begin(), header.end(), datagram.begin());
+
+            if constexpr (Authenticator::kEnabled) {
+                authenticator_.Sign(header, std::span<uint8_t>(datagram).subspan(NtpMessage::kSize));
+            }
+
+            uint64_t& slot = peer.outstanding_[peer.next_outstanding_];
+            requests_.Erase(slot); // The oldest request of the peer, if all slots are in use.
+            slot = nonce;
+
+            const Timestamp t1 = Timestamp::FromUnixTime(clock_.Now()); // (As close to the send as possible.)
+            requests_.Insert(Request{ nonce, t1, static_cast<uint32_t>(&peer - peers_.data()), static_cast<uint32_t>(peer.next_outstanding_) });
+            peer.next_outstanding_ = (peer.next_outstanding_ + 1) % PeerType::kMaxOutstanding;
+            ++counters_.sent_;
+            return transport_.Send(peer.endpoint_, datagram);
+        }
+
+
+        // The request a reply answers (found by the nonce it echoes as its origin timestamp), if the reply also comes
+        // from the address the request went to. One hash lookup, whatever the number of servers. nullptr if bogus or
+        // a duplicate (it does not answer any of our outstanding requests).
+        [[nodiscard]] const Request* FindRequest(const Endpoint& from, const NtpMessage& reply) const
+        {
+            const Request* request = requests_.Find(reply.orig_.ToUint64());
+            return request != nullptr && peers_[request->peer_].endpoint_ == from ? request : nullptr;
+        }
+
+
+        // Validate a reply to request (RFC 5905, section 8, packet sanity tests) and feed it to the peer's filter.
+        bool Accept(const Request request, const NtpMessage& reply, const Duration now)
+        {
+            if (reply.mode_ != 4) {
+                return false; // Not a server reply.
+            }
+
+            PeerType& peer = peers_[request.peer_];
+            const Timestamp t1 = request.sent_;
+            peer.outstanding_[request.slot_] = 0;
+            requests_.Erase(request.nonce_); // One reply per request.
+
+            if (reply.tx_.ToUint64() == 0) {
+                return false; // Bogus (RFC 5905, section 8): A server always sets its transmit timestamp.
+            }
+
+            // Kiss-o'-death (only believed once it answers one of our requests: A forged one could silence a server).
+            if (const KissCode kiss = Kiss(reply); kiss != KissCode::kNone) {
+                ++counters_.kisses_;
+                if (kiss == KissCode::kDeny || kiss == KissCode::kRestrict) {
+                    peer.denied_ = true;
+                }
+                else if (kiss == KissCode::kRate) {
+                    peer.burst_remaining_ = 0; // Back off: Drop the rest of the burst (the poll interval is the caller's).
+                }
+                return false;
+            }
+
+            if (reply.leap_ == 3 || reply.stratum_ > 15) {
+                return false; // Unsynchronized server.
+            }
+
+            if (!ValidPrecision(static_cast<int8_t>(reply.precision_))) {
+                return false; // Bogus.
+            }
+
+            peer.refid_ = RefId(reply);
+            if (reply.stratum_ >= 2 && IsLoop(peer)) {
+                ++counters_.loops_;
+                return false;
+            }
+
+            Sample sample = MakeSample(t1, reply.rx_, reply.tx_, Timestamp::FromUnixTime(now),
+                static_cast<int8_t>(reply.precision_), ClockSource::kPrecision);
+            sample.root_delay_ = reply.RootDelay();
+            sample.root_dispersion_ = reply.RootDispersion();
+            if (RootDistance(sample) > kMaxDistance) {
+                return false; // Too far from its reference to be of use.
+            }
+
+            peer.filter_.Add(sample);
+            if (log_ != nullptr) {
+                log_->Append(static_cast<size_t>(&peer - peers_.data()), reply.stratum_, sample);
+            }
+            peer.stratum_ = reply.stratum_;
+            peer.reach_ |= 1;
+
+            return true;
+        }
+
+
+        // Timing loop: The server is synchronized to us, or to another of our servers that is synchronized to it.
+        // Two hash lookups, whatever the number of servers and local addresses.
+        [[nodiscard]] bool IsLoop(const PeerType& peer) const
+        {
+            if (local_refids_.Contains(peer.refid_)) {
+                return true;
+            }
+
+            const uint32_t* upstream = peer_addresses_.Find(peer.refid_);
+            return upstream != nullptr && peers_[*upstream].refid_ == peer.endpoint_.address_;
+        }
+
+
+        NTP_NO_UNIQUE_ADDRESS Transport transport_{};
+        NTP_NO_UNIQUE_ADDRESS ClockSource clock_{};
+        NTP_NO_UNIQUE_ADDRESS Authenticator authenticator_{};
+        std::vector<PeerType, PeerAllocator> peers_{};
+        RefIdTable<Allocator> local_refids_{};
+        RefIdTable<Allocator> peer_addresses_{}; // Server address -> index in peers_.
+        NonceTable<Allocator> requests_{};       // Requests in flight, of all peers.
+        SampleLog* log_{ nullptr };
+        EngineCounters counters_{};
+        Duration poll_interval_{ 0 };
+        Duration next_poll_{ 0 };
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,72 @@
+/*
+    RefId.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "RefId.h"
+
+#include "SocketApi.h" // (For Windows.h, in the right order relative to Winsock.)
+#include <iphlpapi.h> // For GetAdaptersAddresses.
+#include <cstring> // For memcpy.
+
+// GetAdaptersAddresses is part of the IP Helper API.
+#pragma comment(lib, "iphlpapi.lib")
+
+
+namespace ntp_client
+{
+
+    std::vector<uint32_t> LocalRefIds()
+    {
+        constexpr ULONG kFlags = GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER;
+
+        // The adapter list is variable-length: Retry with the size the call asks for (it can grow in between).
+        std::vector<uint8_t> buffer(16 * 1024);
+        ULONG size = static_cast<ULONG>(buffer.size());
+        ULONG result = ERROR_BUFFER_OVERFLOW;
+        for (int attempt = 0; attempt < 3 && result == ERROR_BUFFER_OVERFLOW; ++attempt) {
+            buffer.resize(size);
+            result = GetAdaptersAddresses(AF_UNSPEC, kFlags, nullptr, reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.data()), &size);
+        }
+
+        std::vector<uint32_t> refids{};
+        if (result != ERROR_SUCCESS) {
+            return refids;
+        }
+
+        for (auto* adapter = reinterpret_cast<const IP_ADAPTER_ADDRESSES*>(buffer.data()); adapter != nullptr; adapter = adapter->Next) {
+            for (auto* unicast = adapter->FirstUnicastAddress; unicast != nullptr; unicast = unicast->Next) {
+                const sockaddr* address = unicast->Address.lpSockaddr;
+                if (address->sa_family == AF_INET) {
+                    refids.push_back(reinterpret_cast<const sockaddr_in*>(address)->sin_addr.s_addr);
+                }
+                else if (address->sa_family == AF_INET6) {
+                    std::array<uint8_t, 16> bytes{};
+                    std::memcpy(bytes.data(), &reinterpret_cast<const sockaddr_in6*>(address)->sin6_addr, bytes.size());
+                    refids.push_back(Ipv6RefId(bytes));
+                }
+            }
+        }
+
+        return refids;
+    }
+
+}
@@ -0,0 +1,279 @@
+#ifndef AMITG_FC_REFID
+#define AMITG_FC_REFID
+
+/*
+    RefId.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Reference IDs (RFC 5905, section 7.3): What a server's clock is synchronized to.
+//   Stratum 0:   A kiss-o'-death code, 4 ASCII characters ("RATE", "DENY", ...).
+//   Stratum 1:   The primary reference, up to 4 ASCII characters ("GPS", "PPS", ...).
+//   Stratum 2+:  The upstream server: Its IPv4 address, or for IPv6 the first 4 octets of the MD5 hash of its address.
+//
+// The refid is what reveals a timing loop: A server that is synchronized to us (directly, or to one of our
+// addresses) or to another of our servers that is in turn synchronized to it.
+
+#include <array>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <memory> // For std::allocator and std::allocator_traits.
+#include <string>
+#include <vector>
+
+#include "NtpCore.h"
+
+
+namespace ntp_client
+{
+
+    // Reference IDs are kept as 32-bit values in network byte order, so an IPv4 refid equals the address as it
+    // appears in sockaddr_in (and Endpoint::address_).
+    [[nodiscard]] constexpr uint32_t RefId(const NtpMessage& message)
+    {
+        const auto* id = message.ref_clock_id_;
+        // (Bytes in memory order, assembled for a little-endian host, which is every Windows target.)
+        return static_cast<uint32_t>(id[0]) | static_cast<uint32_t>(id[1]) << 8 | static_cast<uint32_t>(id[2]) << 16 | static_cast<uint32_t>(id[3]) << 24;
+    }
+
+
+    // **** KissCode enum ****
+
+    enum class KissCode : uint8_t
+    {
+        kNone,      // Not a kiss-o'-death (stratum is not 0).
+        kDeny,      // "DENY": Access denied. Stop querying the server.
+        kRestrict,  // "RSTR": Access restricted. Stop querying the server.
+        kRate,      // "RATE": Rate exceeded. Query less often.
+        kOther      // Any other code: Informational (RFC 5905 lists several, servers use more).
+    };
+
+
+    // Kiss code of a reply (stratum 0).
+    [[nodiscard]] constexpr KissCode Kiss(const NtpMessage& message)
+    {
+        if (message.stratum_ != 0) {
+            return KissCode::kNone;
+        }
+
+        const auto code = [&message](const char* text) {
+            return message.ref_clock_id_[0] == text[0] && message.ref_clock_id_[1] == text[1] && message.ref_clock_id_[2] == text[2] &&
+                message.ref_clock_id_[3] == text[3];
+        };
+
+        return code("DENY") ? KissCode::kDeny : code("RSTR") ? KissCode::kRestrict : code("RATE") ? KissCode::kRate : KissCode::kOther;
+    }
+
+
+    // Refid as ntpq shows it: The ASCII code at stratum 0 and 1 (non-printable characters as '.'), a dotted quad above.
+    // (At stratum 2 and above, an IPv6 hash refid is indistinguishable from an IPv4 address, and shows as one.)
+    [[nodiscard]] inline std::string RefIdText(const uint32_t refid, const uint8_t stratum)
+    {
+        std::string text{};
+        for (int i = 0; i < 4; ++i) {
+            const auto byte = static_cast<uint8_t>(refid >> (i * 8));
+            if (stratum <= 1) {
+                if (byte == 0) {
+                    break;
+                }
+                text += byte >= 0x20 && byte < 0x7F ? static_cast<char>(byte) : '.';
+            }
+            else {
+                text += (i > 0 ? "." : "") + std::to_string(byte);
+            }
+        }
+
+        return text;
+    }
+
+
+    namespace detail
+    {
+
+        // MD5 (RFC 1321) of a 16-byte message, which fits one block: Enough for IPv6 refids, no general-purpose hashing.
+        constexpr std::array<uint8_t, 16> Md5Of16(const std::array<uint8_t, 16>& message)
+        {
+            constexpr uint32_t kSines[64] = {
+                0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+                0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+                0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+                0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+                0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+                0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+                0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+                0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+            constexpr int kShifts[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+            // The padded block: The message, a 1 bit, zeros, and the message length in bits (128), little-endian.
+            std::array<uint32_t, 16> block{};
+            for (size_t i = 0; i < 16; ++i) {
+                block[i / 4] |= static_cast<uint32_t>(message[i]) << (i % 4 * 8);
+            }
+            block[4] = 0x80;
+            block[14] = 128;
+
+            const std::array<uint32_t, 4> initial = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+            uint32_t a = initial[0], b = initial[1], c = initial[2], d = initial[3];
+
+            for (int i = 0; i < 64; ++i) {
+                uint32_t f{ 0 };
+                int g{ 0 };
+                switch (i / 16) {
+                case 0: f = (b & c) | (~b & d); g = i; break;
+                case 1: f = (d & b) | (~d & c); g = (5 * i + 1) % 16; break;
+                case 2: f = b ^ c ^ d; g = (3 * i + 5) % 16; break;
+                default: f = c ^ (b | ~d); g = 7 * i % 16; break;
+                }
+
+                const uint32_t sum = a + f + kSines[i] + block[g];
+                const int shift = kShifts[i / 16 * 4 + i % 4];
+                a = d;
+                d = c;
+                c = b;
+                b += sum << shift | sum >> (32 - shift);
+            }
+
+            const std::array<uint32_t, 4> state = { initial[0] + a, initial[1] + b, initial[2] + c, initial[3] + d };
+            std::array<uint8_t, 16> digest{};
+            for (size_t i = 0; i < 16; ++i) {
+                digest[i] = static_cast<uint8_t>(state[i / 4] >> (i % 4 * 8));
+            }
+            return digest;
+        }
+
+    }
+
+
+    // Refid a server synchronized to the IPv6 address (16 bytes, network byte order) reports.
+    [[nodiscard]] constexpr uint32_t Ipv6RefId(const std::array<uint8_t, 16>& address)
+    {
+        const auto digest = detail::Md5Of16(address);
+        return static_cast<uint32_t>(digest[0]) | static_cast<uint32_t>(digest[1]) << 8 | static_cast<uint32_t>(digest[2]) << 16 | static_cast<uint32_t>(digest[3]) << 24;
+    }
+
+
+    // **** RefIdTable class ****
+
+    // Open-addressing hash map from refids (or IPv4 addresses, which are the same thing) to small values.
+    // Lookups are O(1): One multiplicative hash and a short linear probe in a table kept at most half full.
+    // (0 is reserved as the empty key; it is no one's address.) The slots come from Allocator (rebound).
+    template <typename Allocator = std::allocator<std::byte>>
+    class RefIdTable final
+    {
+        struct Slot final
+        {
+            uint32_t key_{ 0 };
+            uint32_t value_{ 0 };
+        };
+
+    public:
+
+        using SlotAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+
+
+        // Constructor:
+        RefIdTable() = default;
+
+        explicit RefIdTable(const Allocator& allocator) : slots_(SlotAllocator(allocator))
+        {
+
+        }
+
+
+        // Add or replace a key.
+        void Insert(const uint32_t key, const uint32_t value)
+        {
+            if (key == 0) {
+                return;
+            }
+
+            if ((size_ + 1) * 2 > slots_.size()) {
+                Grow();
+            }
+
+            Slot& slot = slots_[Probe(key)];
+            if (slot.key_ == 0) {
+                ++size_;
+            }
+            slot = Slot{ key, value };
+        }
+
+
+        // The value of a key, or nullptr.
+        [[nodiscard]] const uint32_t* Find(const uint32_t key) const
+        {
+            if (key == 0 || slots_.empty()) {
+                return nullptr;
+            }
+
+            const Slot& slot = slots_[Probe(key)];
+            return slot.key_ == key ? &slot.value_ : nullptr;
+        }
+
+
+        [[nodiscard]] bool Contains(const uint32_t key) const { return Find(key) != nullptr; }
+
+        [[nodiscard]] size_t Size() const { return size_; }
+
+    private:
+
+        // The slot holding key, or the empty slot where it belongs.
+        [[nodiscard]] size_t Probe(const uint32_t key) const
+        {
+            const size_t mask = slots_.size() - 1;
+            size_t index = static_cast<size_t>(key * 0x9E3779B1u) & mask; // (Fibonacci hashing: Spreads adjacent addresses.)
+            while (slots_[index].key_ != 0 && slots_[index].key_ != key) {
+                index = (index + 1) & mask;
+            }
+            return index;
+        }
+
+
+        void Grow()
+        {
+            std::vector<Slot, SlotAllocator> old(slots_.get_allocator());
+            old.swap(slots_);
+            slots_.resize(old.empty() ? 16 : old.size() * 2);
+            for (const Slot& slot : old) {
+                if (slot.key_ != 0) {
+                    slots_[Probe(slot.key_)] = slot;
+                }
+            }
+        }
+
+
+        std::vector<Slot, SlotAllocator> slots_{}; // Power-of-two size.
+        size_t size_{ 0 };
+    };
+
+
+    // Refids that point at this host: Every local unicast address (IPv4 as is, IPv6 hashed).
+    // Empty if the adapter list cannot be read.
+    std::vector<uint32_t> LocalRefIds();
+
+
+    static_assert(Ipv6RefId({ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 }) == 0xC84D40CF, "::1 hashes to cf:40:4d:c8 (MD5).");
+    static_assert(detail::Md5Of16({ 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 })[15] == 0x0c, "2001:db8::1 (MD5 ...680c).");
+
+}
+
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef AMITG_FC_REFERENCEDRIVER
+#define AMITG_FC_REFERENCEDRIVER
+
+/*
+    ReferenceDriver.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Local reference clocks (refclocks): Time sources other than network servers, such as a GPS receiver
+// daemon writing to shared memory. A driver turns its readings into the same Sample a server reply
+// produces, so references go through the same clock filter and selection as servers (ClientEngine::AddReference).
+
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <istream>
+#include <limits>
+#include <optional>
+
+#include "NtpCore.h"
+
+
+namespace ntp_client
+{
+
+    // **** ReferenceDriver class ****
+
+    class ReferenceDriver
+    {
+    public:
+
+        virtual ~ReferenceDriver() = default;
+
+
+        // Return the newest reading not returned before, or nothing if there is none (yet).
+        [[nodiscard]] virtual std::optional<Sample> Poll() = 0;
+
+
+        // A reading: The reference's time, and the local clock time at the same instant.
+        // Offset = reference minus local; there is no network path, so the delay is 0 and the dispersion is
+        // the reference's precision.
+        [[nodiscard]] static Sample MakeReferenceSample(const Duration reference_time, const Duration local_time, const int8_t precision)
+        {
+            Sample sample{};
+            sample.offset_ = reference_time - local_time;
+            sample.dispersion_ = Log2ToDuration(precision);
+            sample.time_ = local_time;
+            return sample;
+        }
+    };
+
+
+    // **** StreamReferenceDriver class ****
+
+    // Reads readings from a text stream (a file, or a named pipe opened as a file): One reading per line,
+    // "<reference time> <local time>", both in nanoseconds since the unix epoch. Meant for tests and replays.
+    // A malformed line is skipped (rest of the line included), so it cannot block the readings after it.
+    class StreamReferenceDriver final : public ReferenceDriver
+    {
+    public:
+
+        explicit StreamReferenceDriver(std::istream& stream, const int8_t precision = -20) : stream_(stream), precision_(precision)
+        {
+
+        }
+
+
+        [[nodiscard]] std::optional<Sample> Poll() override
+        {
+            for (;;) {
+                int64_t reference_time{ 0 }, local_time{ 0 };
+                if (stream_ >> reference_time >> local_time) {
+                    return MakeReferenceSample(Duration(reference_time), Duration(local_time), precision_);
+                }
+
+                const bool end = stream_.eof();
+                stream_.clear(); // (A pipe or a growing file may have more later.)
+                if (end) {
+                    return std::nullopt;
+                }
+
+                stream_.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // A malformed line: Skip it.
+            }
+        }
+
+    private:
+
+        std::istream& stream_;
+        int8_t precision_{ -20 };
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef AMITG_FC_SEQLOCK
+#define AMITG_FC_SEQLOCK
+
+/*
+    Seqlock.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <atomic>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <cstring> // For std::memcpy.
+#include <thread>
+#include <type_traits>
+
+
+namespace ntp_client
+{
+
+    // **** Seqlock class ****
+
+    // Publishes snapshots of a value from one writer thread to any number of reader threads.
+    // The writer never waits: It bumps a sequence number to odd, stores the value, and bumps it back to even.
+    // Readers copy the value and retry if the sequence was odd or changed meanwhile, so a reader can never
+    // slow the writer down (unlike a mutex, which a monitoring query could hold while the writer needs it).
+    // The value is stored as relaxed atomic words, so the concurrent copy is not a data race.
+    template <typename T>
+    class Seqlock final
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshots are copied word by word.");
+
+        static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    public:
+
+        // Writer: Publish a new snapshot. (Only one thread may publish.)
+        void Publish(const T& value)
+        {
+            std::array<uint64_t, kWords> words{};
+            std::memcpy(words.data(), &value, sizeof(T));
+
+            const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+            sequence_.store(sequence + 1, std::memory_order_relaxed); // Odd: Update in progress.
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (size_t i = 0; i < kWords; ++i) {
+                words_[i].store(words[i], std::memory_order_relaxed);
+            }
+
+            sequence_.store(sequence + 2, std::memory_order_release);
+        }
+
+
+        // Reader: Get the latest snapshot (a value-initialized T before the first Publish).
+        [[nodiscard]] T Read() const
+        {
+            std::array<uint64_t, kWords> words{};
+
+            for (size_t attempt = 0;; ++attempt) {
+                const uint64_t before = sequence_.load(std::memory_order_acquire);
+                if ((before & 1) == 0) {
+                    for (size_t i = 0; i < kWords; ++i) {
+                        words[i] = words_[i].load(std::memory_order_relaxed);
+                    }
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (sequence_.load(std::memory_order_relaxed) == before) {
+                        break;
+                    }
+                }
+
+                if (attempt >= kSpinAttempts) {
+                    std::this_thread::yield(); // The writer may have been preempted mid-update.
+                }
+            }
+
+            T value{};
+            std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+            return value;
+        }
+
+
+        // Number of snapshots published so far.
+        [[nodiscard]] uint64_t Version() const { return sequence_.load(std::memory_order_acquire) / 2; }
+
+    private:
+
+        static constexpr size_t kSpinAttempts = 16;
+
+        std::atomic<uint64_t> sequence_{ 0 };
+        std::array<std::atomic<uint64_t>, kWords> words_{};
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,69 @@
+/*
+    ShmReference.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "ShmReference.h"
+
+#include <string>
+
+#include "SocketApi.h" // (For Windows.h, in the right order relative to Winsock.)
+
+
+namespace ntp_client
+{
+
+    // Constructor:
+    ShmSegment::ShmSegment(const int unit)
+    {
+        // CreateFileMapping opens the existing object if the other side already created it.
+        // Global objects need SeCreateGlobalPrivilege; without it, fall back to the session-local name.
+        for (const std::string prefix : { "Global\\NTP", "NTP" }) {
+            const std::string name = prefix + std::to_string(unit);
+            if (const HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(ShmTime), name.c_str()); mapping != nullptr) {
+                mapping_ = mapping;
+                break;
+            }
+        }
+
+        if (mapping_ == nullptr) {
+            [[maybe_unused]] const auto error{ GetLastError() }; // For debug.
+            return;
+        }
+
+        // A new mapping is zero-filled, which reads as "no valid reading".
+        segment_ = static_cast<ShmTime*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ShmTime)));
+    }
+
+
+    // Destructor:
+    ShmSegment::~ShmSegment()
+    {
+        if (segment_ != nullptr) {
+            UnmapViewOfFile(segment_);
+        }
+
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+    }
+
+}
@@ -0,0 +1,229 @@
+#ifndef AMITG_FC_SHMREFERENCE
+#define AMITG_FC_SHMREFERENCE
+
+/*
+    ShmReference.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Shared-memory reference clock (the ntpd "SHM" refclock, type 28).
+// Another process (for example, a GPS daemon) writes readings to a shared segment; we read them without
+// locks, using the segment's own count/valid protocol (mode 1).
+
+#include <atomic>
+#include <cstdint> // For using uint32_t or similar types.
+#include <optional>
+
+#include "ReferenceDriver.h"
+
+
+namespace ntp_client
+{
+
+    // **** ShmTime struct ****
+
+    // The segment layout, as defined by ntpd (refclock_shm.c), with time_t as 64 bits (as on Windows).
+    struct ShmTime final
+    {
+        int32_t mode_;                 // 1 = Count-protected reads (the only mode supported here).
+        int32_t count_;                // Incremented by the writer before and after every update.
+        int64_t clock_seconds_;        // Reference time...
+        int32_t clock_microseconds_;
+        int64_t receive_seconds_;      // ...and the local clock time at the same instant.
+        int32_t receive_microseconds_;
+        int32_t leap_;
+        int32_t precision_;            // log2 seconds.
+        int32_t samples_;
+        int32_t valid_;                // Set by the writer after an update, cleared by the reader after reading it.
+        uint32_t clock_nanoseconds_;   // Nanosecond versions of the microsecond fields.
+        uint32_t receive_nanoseconds_;
+        int32_t dummy_[8];
+    };
+
+    static_assert(sizeof(ShmTime) == 96, "Must match the layout ntpd and the SHM writers use.");
+
+
+    namespace detail
+    {
+        // The segment is shared with another process that writes it at any time, so every field is read and written
+        // as a whole (through atomic_ref, like ntpd's volatile accesses): An update may tear the record, which the
+        // count check detects, but never a single field.
+        template <typename T>
+        [[nodiscard]] T LoadShm(T& field) { return std::atomic_ref<T>(field).load(std::memory_order_relaxed); }
+
+        template <typename T>
+        void StoreShm(T& field, const T value) { std::atomic_ref<T>(field).store(value, std::memory_order_relaxed); }
+    }
+
+
+    // Read a reading from a segment, lock-free (the reader side of the mode 1 protocol).
+    // Return nothing if there is no new reading, or if the writer updated the segment while we read it. Only a
+    // consistent read consumes the reading (clears valid_); after a torn one, the writer's update sets it again anyway.
+    [[nodiscard]] inline std::optional<Sample> ReadShm(ShmTime& segment)
+    {
+        using detail::LoadShm;
+        std::atomic_ref<int32_t> valid{ segment.valid_ }, count{ segment.count_ };
+
+        if (valid.load(std::memory_order_acquire) == 0) {
+            return std::nullopt;
+        }
+
+        const int32_t count_before = count.load(std::memory_order_acquire);
+        const int32_t mode = LoadShm(segment.mode_);
+        const int64_t clock_seconds = LoadShm(segment.clock_seconds_);
+        const uint32_t clock_nanoseconds = LoadShm(segment.clock_nanoseconds_);
+        const int64_t receive_seconds = LoadShm(segment.receive_seconds_);
+        const uint32_t receive_nanoseconds = LoadShm(segment.receive_nanoseconds_);
+        const int32_t precision = LoadShm(segment.precision_);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const int32_t count_after = count.load(std::memory_order_relaxed);
+
+        if (count_before != count_after) {
+            return std::nullopt; // Torn.
+        }
+
+        valid.store(0, std::memory_order_release); // Consumed.
+
+        if (mode != 1) {
+            return std::nullopt;
+        }
+
+        if (precision < kMinPrecision || precision > kMaxPrecision) {
+            return std::nullopt; // Bogus (checked before the narrowing: The writer is another process).
+        }
+
+        const auto reference_time = std::chrono::seconds(clock_seconds) + Duration(clock_nanoseconds);
+        const auto local_time = std::chrono::seconds(receive_seconds) + Duration(receive_nanoseconds);
+        return ReferenceDriver::MakeReferenceSample(reference_time, local_time, static_cast<int8_t>(precision));
+    }
+
+
+    // Write a reading to a segment (the writer side of the mode 1 protocol). Used by the stand-in writer.
+    inline void WriteShm(ShmTime& segment, const Duration reference_time, const Duration local_time, const int8_t precision)
+    {
+        using detail::StoreShm;
+        std::atomic_ref<int32_t> valid{ segment.valid_ }, count{ segment.count_ };
+        const auto split = [](const Duration time, int64_t& seconds, int32_t& microseconds, uint32_t& nanoseconds) {
+            const int64_t whole_seconds = std::chrono::floor<std::chrono::seconds>(time).count();
+            const auto fraction = static_cast<uint32_t>((time - std::chrono::seconds(whole_seconds)).count());
+            StoreShm(seconds, whole_seconds);
+            StoreShm(nanoseconds, fraction);
+            StoreShm(microseconds, static_cast<int32_t>(fraction / 1000));
+        };
+
+        valid.store(0, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        StoreShm(segment.mode_, int32_t{ 1 });
+        split(reference_time, segment.clock_seconds_, segment.clock_microseconds_, segment.clock_nanoseconds_);
+        split(local_time, segment.receive_seconds_, segment.receive_microseconds_, segment.receive_nanoseconds_);
+        StoreShm(segment.precision_, int32_t{ precision });
+        StoreShm(segment.leap_, int32_t{ 0 });
+
+        count.fetch_add(1, std::memory_order_release);
+        valid.store(1, std::memory_order_release);
+    }
+
+
+    // **** ShmSegment class ****
+
+    // RAII mapping of the named segment of a unit ("Global\NTP<unit>", or "NTP<unit>" without the privilege
+    // to create global objects). Whoever comes first creates it; the other side maps the existing one.
+    class ShmSegment final
+    {
+    public:
+
+        // Constructor:
+        explicit ShmSegment(int unit);
+
+        // Destructor:
+        ~ShmSegment();
+
+        ShmSegment(const ShmSegment&) = delete;
+        ShmSegment& operator=(const ShmSegment&) = delete;
+
+
+        // The mapped segment, or nullptr on error.
+        ShmTime* Get() const { return segment_; }
+
+    private:
+
+        void* mapping_{ nullptr }; // (HANDLE)
+        ShmTime* segment_{ nullptr };
+    };
+
+
+    // **** ShmReferenceDriver class ****
+
+    class ShmReferenceDriver final : public ReferenceDriver
+    {
+    public:
+
+        explicit ShmReferenceDriver(const int unit) : segment_(unit)
+        {
+
+        }
+
+
+        [[nodiscard]] std::optional<Sample> Poll() override
+        {
+            return segment_.Get() != nullptr ? ReadShm(*segment_.Get()) : std::nullopt;
+        }
+
+    private:
+
+        ShmSegment segment_;
+    };
+
+
+    // **** ShmWriter class ****
+
+    // Stand-in for the process that feeds the segment (a GPS daemon, for example), for local testing.
+    class ShmWriter final
+    {
+    public:
+
+        explicit ShmWriter(const int unit) : segment_(unit)
+        {
+
+        }
+
+
+        bool Write(const Duration reference_time, const Duration local_time, const int8_t precision = -20)
+        {
+            if (segment_.Get() == nullptr) {
+                return false;
+            }
+
+            WriteShm(*segment_.Get(), reference_time, local_time, precision);
+            return true;
+        }
+
+    private:
+
+        ShmSegment segment_;
+    };
+
+}
+
+
+#endif
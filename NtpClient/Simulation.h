@@ -0,0 +1,224 @@
+#ifndef AMITG_FC_SIMULATION
+#define AMITG_FC_SIMULATION
+
+/*
+    Simulation.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Simulated network conditions for offline evaluation of the filter, selection and discipline algorithms.
+// Everything is deterministic (fixed seeds), so two runs of the same scenario produce the same samples.
+
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <optional>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "NtpCore.h"
+
+
+namespace ntp_client::simulation
+{
+
+    using std::chrono::microseconds;
+    using std::chrono::milliseconds;
+    using std::chrono::seconds;
+
+
+    // **** ServerModel struct ****
+
+    // One simulated server and the path to it.
+    struct ServerModel final
+    {
+        Duration error_{ 0 };            // Server clock minus true time. Non-zero = falseticker.
+        Duration base_delay_{ milliseconds(20) }; // Round trip without queuing.
+        double asymmetry_{ 0 };          // Share of the base delay moved from the return path to the outbound path (-1..1).
+        Duration queuing_{ microseconds(200) }; // Mean queuing delay per direction (exponential).
+        double burst_probability_{ 0 };  // Probability that a packet hits a queue burst...
+        Duration burst_queuing_{ 0 };    // ...with this mean queuing delay instead.
+        double loss_{ 0 };               // Packet loss probability (request or reply).
+        Duration step_time_{ Duration::max() }; // When the server clock steps...
+        Duration step_{ 0 };             // ...and by how much.
+    };
+
+
+    // **** Scenario struct ****
+
+    struct Scenario final
+    {
+        std::string_view name_{};
+        std::vector<ServerModel> servers_{};
+        Duration poll_interval_{ seconds(16) };
+        Duration duration_{ std::chrono::hours(2) };
+        Duration local_error_{ 0 };      // Local clock minus true time: the offset the client should measure is -local_error_.
+    };
+
+
+    // The scenario library.
+    inline std::vector<Scenario> Scenarios()
+    {
+        std::vector<Scenario> scenarios{};
+
+        // Ideal: Four good servers, symmetric low-jitter paths.
+        scenarios.push_back({ "ideal", std::vector<ServerModel>(4), seconds(16), std::chrono::hours(2), milliseconds(50) });
+
+        // Asymmetric routes: Outbound path much slower than the return path, for most servers.
+        {
+            Scenario scenario{ "asymmetric", std::vector<ServerModel>(4), seconds(16), std::chrono::hours(2), milliseconds(50) };
+            scenario.servers_[0].asymmetry_ = 0.6;
+            scenario.servers_[1].asymmetry_ = 0.4;
+            scenario.servers_[2].asymmetry_ = -0.2;
+            for (auto& server : scenario.servers_) {
+                server.base_delay_ = milliseconds(80);
+            }
+            scenarios.push_back(scenario);
+        }
+
+        // Bursty queuing: 20% of the packets wait tens of milliseconds in a queue.
+        {
+            Scenario scenario{ "bursty", std::vector<ServerModel>(4), seconds(16), std::chrono::hours(2), milliseconds(50) };
+            for (auto& server : scenario.servers_) {
+                server.burst_probability_ = 0.2;
+                server.burst_queuing_ = milliseconds(40);
+            }
+            scenarios.push_back(scenario);
+        }
+
+        // Falsetickers: Two of five servers are wrong by 250 ms and 3 s.
+        {
+            Scenario scenario{ "falsetickers", std::vector<ServerModel>(5), seconds(16), std::chrono::hours(2), milliseconds(50) };
+            scenario.servers_[3].error_ = milliseconds(250);
+            scenario.servers_[4].error_ = seconds(3);
+            scenarios.push_back(scenario);
+        }
+
+        // Server step: One of four servers steps its clock by one second after 30 minutes.
+        {
+            Scenario scenario{ "server-step", std::vector<ServerModel>(4), seconds(16), std::chrono::hours(2), milliseconds(50) };
+            scenario.servers_[0].step_time_ = std::chrono::minutes(30);
+            scenario.servers_[0].step_ = seconds(1);
+            scenarios.push_back(scenario);
+        }
+
+        // Packet loss: 30% loss on every path, plus some bursts.
+        {
+            Scenario scenario{ "lossy", std::vector<ServerModel>(4), seconds(16), std::chrono::hours(2), milliseconds(50) };
+            for (auto& server : scenario.servers_) {
+                server.loss_ = 0.3;
+                server.burst_probability_ = 0.05;
+                server.burst_queuing_ = milliseconds(20);
+            }
+            scenarios.push_back(scenario);
+        }
+
+        return scenarios;
+    }
+
+
+    // **** Network class ****
+
+    // Generates on-wire timestamps (T1..T4) for a scenario.
+    // Simulated time (now) starts at 0; the clocks read it relative to kEpoch.
+    class Network final
+    {
+    public:
+
+        static constexpr Duration kEpoch = seconds(1'700'000'000);
+
+        explicit Network(const Scenario& scenario, const uint64_t seed = 1) : scenario_(scenario), local_error_(scenario.local_error_),
+            random_(seed)
+        {
+
+        }
+
+
+        // Exchange one request/reply with a server at true time now.
+        // Returns the sample as the client would compute it, or nothing if the request or the reply was lost.
+        [[nodiscard]] std::optional<Sample> Exchange(const size_t server_index, const Duration now)
+        {
+            const ServerModel& server = scenario_.servers_[server_index];
+
+            if (Chance(server.loss_)) {
+                return std::nullopt;
+            }
+
+            const Duration half = server.base_delay_ / 2;
+            const auto skew = Duration(static_cast<int64_t>(static_cast<double>(half.count()) * server.asymmetry_));
+            const Duration outbound = half + skew + Queuing(server), inbound = half - skew + Queuing(server);
+            const Duration processing = microseconds(50);
+            const Duration server_error = server.error_ + (now >= server.step_time_ ? server.step_ : Duration(0));
+
+            // True times of the four events, then each read from the clock that stamps it:
+            const Duration t1 = LocalTime(now);
+            const Duration t2 = kEpoch + now + outbound + server_error;
+            const Duration t3 = t2 + processing;
+            const Duration t4 = LocalTime(now + outbound + processing + inbound);
+
+            if (Chance(server.loss_)) {
+                return std::nullopt;
+            }
+
+            return MakeSample(Timestamp::FromUnixTime(t1), Timestamp::FromUnixTime(t2), Timestamp::FromUnixTime(t3),
+                Timestamp::FromUnixTime(t4), -20, -20);
+        }
+
+
+        // What the local clock reads at true (simulated) time now.
+        [[nodiscard]] Duration LocalTime(const Duration now) const { return kEpoch + now + local_error_; }
+
+
+        // The offset a perfect client would measure.
+        [[nodiscard]] Duration TrueOffset() const { return -local_error_; }
+
+
+        // The local clock was adjusted (by a discipline under test): It is now error ahead of true time.
+        void SetLocalError(const Duration error) { local_error_ = error; }
+
+    private:
+
+        bool Chance(const double probability)
+        {
+            return probability > 0 && std::uniform_real_distribution<double>(0, 1)(random_) < probability;
+        }
+
+
+        Duration Queuing(const ServerModel& server)
+        {
+            const Duration mean = Chance(server.burst_probability_) ? server.burst_queuing_ : server.queuing_;
+            if (mean <= Duration(0)) {
+                return Duration(0);
+            }
+
+            return Duration(static_cast<int64_t>(std::exponential_distribution<double>(1.0 / static_cast<double>(mean.count()))(random_)));
+        }
+
+
+        const Scenario& scenario_;
+        Duration local_error_{ 0 }; // Local clock minus true time (the scenario's, until SetLocalError).
+        std::mt19937_64 random_;
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef AMITG_FC_SINGLEFLIGHT
+#define AMITG_FC_SINGLEFLIGHT
+
+/*
+    SingleFlight.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Single-flight calls: Concurrent calls for the same key share one execution. The first caller (the leader) runs the
+// function; callers that arrive while it runs wait for its result instead of starting their own. Once the leader
+// finishes, the key is free again, so a later call runs the function anew (nothing is cached).
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef> // For size_t.
+#include <exception>
+#include <functional> // For std::hash.
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <unordered_map>
+
+
+namespace ntp_client
+{
+
+    // **** SingleFlight class ****
+
+    // The in-flight table is split into kShards shards, each with its own lock and its own cache line, so calls for
+    // different keys rarely contend. A lock is only held to look up, insert or remove a key, never during the call.
+    template <typename Key, typename Value, size_t kShards = 16, typename Hash = std::hash<Key>>
+    class SingleFlight final
+    {
+    public:
+
+        using Deadline = std::chrono::steady_clock::time_point;
+
+
+        // Return function() for key, sharing the execution with any concurrent call for the same key.
+        // If the leader's function throws, every caller of that flight gets the exception.
+        template <typename Function>
+        Value Call(const Key& key, Function&& function)
+        {
+            return *Call(key, [&function](const std::stop_token&, Deadline) { return std::optional<Value>(function()); }, std::stop_token{}, Deadline::max());
+        }
+
+
+        // Cancellable call: function(stop, deadline) returns nothing if it gave up (was stopped).
+        // Any caller, leader or follower, returns nothing as soon as its own stop is requested or its deadline passes:
+        // It never waits for someone else's flight beyond that. If a leader gives up, the followers still waiting
+        // start over (one of them leads a new flight), so one caller's cancellation does not fail the others.
+        template <typename Function>
+        std::optional<Value> Call(const Key& key, Function&& function, const std::stop_token& stop, const Deadline deadline)
+        {
+            Shard& shard = shards_[Hash{}(key) % kShards];
+
+            for (;;) {
+                std::shared_ptr<Flight> flight{};
+                bool leader{ false };
+                {
+                    std::lock_guard lock{ shard.mutex_ };
+                    auto& entry = shard.in_flight_[key];
+                    if (entry == nullptr) {
+                        entry = std::make_shared<Flight>();
+                        leader = true;
+                    }
+                    flight = entry;
+                }
+
+                if (leader) {
+                    // The key is released before the result is published, so that a caller arriving after the
+                    // result runs a new flight (and does not get a result that started before it called).
+                    std::optional<Value> value{};
+                    try {
+                        value = function(stop, deadline);
+                    }
+                    catch (...) {
+                        Release(shard, key);
+                        flight->Finish(std::nullopt, std::current_exception());
+                        throw;
+                    }
+
+                    Release(shard, key);
+                    flight->Finish(value, nullptr);
+                    return value;
+                }
+
+                // A follower: Wait for the leader (or for our own stop or deadline).
+                std::unique_lock lock{ flight->mutex_ };
+                const auto done = [&flight] { return flight->done_; };
+                if (deadline == Deadline::max() ? !flight->finished_.wait(lock, stop, done) : !flight->finished_.wait_until(lock, stop, deadline, done)) {
+                    return std::nullopt;
+                }
+
+                if (flight->error_ != nullptr) {
+                    std::rethrow_exception(flight->error_);
+                }
+
+                if (flight->value_) {
+                    return flight->value_;
+                }
+
+                // The leader gave up: Start over.
+            }
+        }
+
+    private:
+
+        static constexpr size_t kCacheLine = 64;
+
+        struct Flight final
+        {
+            std::mutex mutex_{};
+            std::condition_variable_any finished_{}; // (The _any variant can wait on a stop_token.)
+            bool done_{ false };
+            std::optional<Value> value_{};
+            std::exception_ptr error_{};
+
+            void Finish(const std::optional<Value>& value, const std::exception_ptr error)
+            {
+                {
+                    std::lock_guard lock{ mutex_ };
+                    done_ = true;
+                    value_ = value;
+                    error_ = error;
+                }
+                finished_.notify_all();
+            }
+        };
+
+        struct alignas(kCacheLine) Shard final
+        {
+            std::mutex mutex_{};
+            std::unordered_map<Key, std::shared_ptr<Flight>, Hash> in_flight_{};
+        };
+
+
+        static void Release(Shard& shard, const Key& key)
+        {
+            std::lock_guard lock{ shard.mutex_ };
+            shard.in_flight_.erase(key);
+        }
+
+
+        std::array<Shard, kShards> shards_{};
+    };
+
+}
+
+
+#endif
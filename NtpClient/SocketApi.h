@@ -0,0 +1,92 @@
+#ifndef AMITG_FC_SOCKETAPI
+#define AMITG_FC_SOCKETAPI
+
+/*
+    SocketApi.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Winsock 2 must be included before Windows.h, otherwise Windows.h pulls in the legacy winsock.h.
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <Windows.h>
+
+// Functions like WSAStartup, WSACleanup, socket, recv, sendto, etc., are part of the Winsock API.
+// Including Ws2_32.lib ensures that the linker resolves references to these functions and includes
+// them in the final executable.
+#pragma comment(lib, "Ws2_32.lib")
+
+
+namespace ntp_client::detail
+{
+
+    // **** WSA class ****
+
+    // RAII wrapper for WSADATA:
+    class WSA final
+    {
+    public:
+
+        // Constructor:
+        WSA()
+        {
+            // Initiates use of the Winsock DLL by a process.
+            // If successful, returns zero.
+            // On error, returns one of few error codes.
+            // Note: An application can call WSAStartup more than once if it needs to obtain the WSADATA structure information more than once.
+            // On each such call, the application can specify any version number (here: 2.2) supported by the Winsock DLL.
+            error_ = WSAStartup(MAKEWORD(2, 2), &data_);
+        }
+
+
+        // Destructor:
+        ~WSA()
+        {
+            // Terminates use of the Winsock 2 DLL (Ws2_32.dll).
+            // The return value is zero if the operation was successful.
+            // On error, the value SOCKET_ERROR is returned, and a specific error number can be retrieved by calling WSAGetLastError().
+            // Attention: In multi-threaded environment, WSACleanup terminates Windows Sockets operations for all threads.
+            if (WSACleanup() == SOCKET_ERROR) {
+                [[maybe_unused]] const auto error{ WSAGetLastError() }; // For debug.
+            }
+        }
+
+        WSA(const WSA&) = delete;
+        WSA& operator=(const WSA&) = delete;
+
+
+        // Get Data:
+        const WSADATA& Data() const { return data_; }
+
+
+        // Get Error:
+        const int Error() const { return error_; }
+
+    private:
+
+        WSADATA data_{};
+        int error_{ 0 };
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,679 @@
+/*
+    Sweep.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "Sweep.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit> // For std::rotl.
+#include <charconv>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "Columnar.h"
+#include "CompletionQueue.h"
+#include "DnsResolver.h"
+#include "NtpEngine.h"
+#include "UdpTransport.h"
+
+
+namespace ntp_client
+{
+
+    namespace
+    {
+        constexpr int kSocketBufferSize = 4 * 1024 * 1024; // Room for the replies that arrive while a batch is being sent.
+        constexpr size_t kMaxDatagramSize = 512; // Larger than any reply (header, extension fields, MAC), so none is truncated.
+        constexpr size_t kSendAttempts = 16;     // Per target, while the socket's send buffer is full.
+        constexpr std::chrono::milliseconds kStragglerCheck{ 1 }; // How often the sender checks whether every target replied.
+        constexpr size_t kCompletionQueueSize = 4096; // Replies in flight between the receive thread and the delivery thread.
+        constexpr size_t kCompletionBatch = 64;       // Replies handed over (or delivered) at once.
+
+        using Completions = CompletionQueue<SweepReply, kCompletionQueueSize>;
+
+
+        // **** ScopeExit class ****
+
+        // Runs a function when it goes out of scope: On return and on unwinding alike.
+        template <typename Function>
+        class ScopeExit final
+        {
+        public:
+
+            // Constructor:
+            explicit ScopeExit(Function function) : function_(std::move(function)) {}
+
+            ~ScopeExit() { function_(); }
+
+            ScopeExit(const ScopeExit&) = delete;
+            ScopeExit& operator=(const ScopeExit&) = delete;
+
+        private:
+
+            Function function_;
+        };
+
+
+        // Parse "a.b.c.d/prefix". Returns false if it is not a CIDR range, or the prefix is outside /8 to /32.
+        bool ParseCidr(const std::string& specification, uint32_t& first, uint32_t& last)
+        {
+            const size_t slash = specification.find('/');
+            if (slash == std::string::npos) {
+                return false;
+            }
+
+            in_addr address{};
+            int prefix{ 0 };
+            const char* prefix_end = specification.data() + specification.size();
+            if (inet_pton(AF_INET, specification.substr(0, slash).c_str(), &address) != 1 ||
+                std::from_chars(specification.data() + slash + 1, prefix_end, prefix).ptr != prefix_end || prefix < 8 || prefix > 32) {
+                return false;
+            }
+
+            const uint32_t mask = ~uint32_t{ 0 } << (32 - prefix);
+            first = ntohl(address.s_addr) & mask;
+            last = first | ~mask;
+
+            if (prefix <= 30) { // Skip the network and broadcast addresses.
+                ++first;
+                --last;
+            }
+
+            return true;
+        }
+
+
+        // **** Cookie class ****
+
+        // The state of a request, carried in the request itself: Its transmit timestamp (which the server echoes as
+        // the origin timestamp) holds the send time, 32 bits of microseconds since the sweep started (unambiguous for
+        // 71 minutes after sending), and 32 bits of a keyed hash (SipHash-2-4 under a random per-sweep key) of the
+        // target's address and port and that time. A blind spoofer has to guess those 32 bits.
+        class Cookie final
+        {
+        public:
+
+            // Constructor: start is the local time the sweep starts at.
+            explicit Cookie(const Duration start) : start_(start)
+            {
+                std::random_device device{};
+                for (uint64_t& word : key_) {
+                    word = static_cast<uint64_t>(device()) << 32 | device();
+                }
+            }
+
+
+            // The transmit timestamp of a request to address:port sent at now.
+            [[nodiscard]] Timestamp Make(const uint32_t address, const uint16_t port, const Duration now) const
+            {
+                const auto time = static_cast<uint32_t>(Microseconds(now));
+                return Timestamp::FromUint64(static_cast<uint64_t>(time) << 32 | Hash(address, port, time));
+            }
+
+
+            // The send time (T1) of the request a reply from `from` answers, received at now. Nothing if origin is not
+            // a cookie of this sweep for that address and port.
+            [[nodiscard]] std::optional<Duration> Check(const Timestamp origin, const Endpoint& from, const Duration now) const
+            {
+                const uint32_t time = origin.seconds_;
+                if (origin.fraction_ != Hash(from.address_, from.port_, time)) {
+                    return std::nullopt;
+                }
+
+                // The latest send time (up to now) with these low 32 bits:
+                const int64_t received = Microseconds(now);
+                const uint32_t age = static_cast<uint32_t>(received) - time;
+                return start_ + std::chrono::microseconds(received - age);
+            }
+
+        private:
+
+            [[nodiscard]] int64_t Microseconds(const Duration now) const
+            {
+                return std::chrono::duration_cast<std::chrono::microseconds>(now - start_).count();
+            }
+
+
+            [[nodiscard]] uint32_t Hash(const uint32_t address, const uint16_t port, const uint32_t time) const
+            {
+                return static_cast<uint32_t>(SipHash(key_, static_cast<uint64_t>(port) << 32 | address, time));
+            }
+
+
+            // SipHash-2-4 (Aumasson and Bernstein, 2012) of a 16-byte message, given as two little-endian words.
+            [[nodiscard]] static uint64_t SipHash(const std::array<uint64_t, 2>& key, const uint64_t first, const uint64_t second)
+            {
+                uint64_t v0 = key[0] ^ 0x736F6D6570736575, v1 = key[1] ^ 0x646F72616E646F6D;
+                uint64_t v2 = key[0] ^ 0x6C7967656E657261, v3 = key[1] ^ 0x7465646279746573;
+
+                const auto rounds = [&](const int count) {
+                    for (int i = 0; i < count; ++i) {
+                        v0 += v1; v1 = std::rotl(v1, 13); v1 ^= v0; v0 = std::rotl(v0, 32);
+                        v2 += v3; v3 = std::rotl(v3, 16); v3 ^= v2;
+                        v0 += v3; v3 = std::rotl(v3, 21); v3 ^= v0;
+                        v2 += v1; v1 = std::rotl(v1, 17); v1 ^= v2; v2 = std::rotl(v2, 32);
+                    }
+                };
+
+                for (const uint64_t word : { first, second, uint64_t{ 16 } << 56 }) { // (The last block: The message length.)
+                    v3 ^= word;
+                    rounds(2);
+                    v0 ^= word;
+                }
+
+                v2 ^= 0xFF;
+                rounds(4);
+                return v0 ^ v1 ^ v2 ^ v3;
+            }
+
+
+            std::array<uint64_t, 2> key_{};
+            Duration start_{ 0 };
+        };
+
+
+        // Hand count replies to the delivery thread. While the queue is full this waits rather than drop replies:
+        // The socket's receive buffer absorbs the backlog meanwhile.
+        void Deliver(Completions& completions, SweepReply* replies, size_t count)
+        {
+            for (;;) {
+                const size_t pushed = completions.PushBatch(replies, count);
+                replies += pushed;
+                count -= pushed;
+                if (count == 0) {
+                    return;
+                }
+
+                std::this_thread::yield();
+            }
+        }
+
+
+        // Consume all pending replies, and queue the valid ones for delivery. Returns the number of valid replies.
+        size_t Collect(UdpTransport& transport, const Cookie& cookie, const uint16_t port, Completions& completions)
+        {
+            const SystemClock clock{};
+            size_t replies{ 0 };
+            std::array<SweepReply, kCompletionBatch> batch{};
+            size_t batched{ 0 };
+            std::array<uint8_t, kMaxDatagramSize> datagram{};
+            Endpoint from{};
+
+            for (int bytes_received; (bytes_received = transport.Receive(datagram, from)) >= 0;) {
+                if (static_cast<size_t>(bytes_received) < NtpMessage::kSize || from.port_ != port) {
+                    continue;
+                }
+
+                const Duration now = clock.Now(); // T4.
+
+                NtpMessage::Packet header{};
+                std::copy_n(datagram.begin(), NtpMessage::kSize, header.begin());
+                const NtpMessage reply = NtpMessage::Decode(header);
+
+                const auto sent = cookie.Check(reply.orig_, from, now);
+                if (reply.mode_ != 4 || !sent) {
+                    continue; // Not a server reply, or not an answer to one of our requests (to that address).
+                }
+
+                if (!ValidPrecision(static_cast<int8_t>(reply.precision_))) {
+                    continue; // Bogus precision (it would only distort the sample).
+                }
+
+                const Sample sample = MakeSample(Timestamp::FromUnixTime(*sent), reply.rx_, reply.tx_, Timestamp::FromUnixTime(now),
+                    static_cast<int8_t>(reply.precision_), SystemClock::kPrecision);
+
+                batch[batched++] = SweepReply{ from.address_, reply.leap_, reply.version_, reply.stratum_, static_cast<int8_t>(reply.precision_),
+                    sample.offset_.count(), sample.delay_.count() };
+                ++replies;
+
+                if (batched == batch.size()) {
+                    Deliver(completions, batch.data(), batched);
+                    batched = 0;
+                }
+            }
+
+            Deliver(completions, batch.data(), batched);
+            return replies;
+        }
+
+
+        // One row of the text format.
+        void WriteRow(std::ostream& stream, const uint32_t address_value, const uint8_t replied, const uint8_t leap, const uint8_t version,
+            const uint8_t stratum, const int8_t precision, const int64_t offset, const int64_t delay)
+        {
+            in_addr address{};
+            address.s_addr = address_value;
+            char text[INET_ADDRSTRLEN]{ 0 };
+            inet_ntop(AF_INET, &address, text, sizeof(text));
+
+            stream << text << '\t' << int{ replied } << '\t' << int{ leap } << '\t' << int{ version } << '\t'
+                << int{ stratum } << '\t' << int{ precision } << '\t' << offset << '\t' << delay << '\n';
+        }
+    }
+
+
+    size_t SweepResults::Replies() const
+    {
+        return static_cast<size_t>(std::count(replied_.begin(), replied_.end(), uint8_t{ 1 }));
+    }
+
+
+    void SweepResults::Resize(const size_t size)
+    {
+        address_.resize(size);
+        replied_.resize(size);
+        leap_.resize(size);
+        version_.resize(size);
+        stratum_.resize(size);
+        precision_.resize(size);
+        offset_.resize(size);
+        delay_.resize(size);
+    }
+
+
+    // Write the results as tab-separated text.
+    void SweepResults::WriteText(std::ostream& stream) const
+    {
+        SweepReply::WriteTextHeader(stream);
+
+        for (size_t i = 0; i < Size(); ++i) {
+            WriteRow(stream, address_[i], replied_[i], leap_[i], version_[i], stratum_[i], precision_[i], offset_[i], delay_[i]);
+        }
+    }
+
+
+    // Write a reply as a row of the text format.
+    void SweepReply::WriteText(std::ostream& stream) const
+    {
+        WriteRow(stream, address_, 1, leap_, version_, stratum_, precision_, offset_, delay_);
+    }
+
+
+    void SweepReply::WriteTextHeader(std::ostream& stream)
+    {
+        stream << "address\treplied\tleap\tversion\tstratum\tprecision\toffset_ns\tdelay_ns\n";
+    }
+
+    // Write the results as a columnar binary file.
+    bool SweepResults::WriteColumnar(std::ostream& stream) const
+    {
+        ColumnarWriter writer(stream);
+        writer.AddColumn("address", address_);
+        writer.AddColumn("replied", replied_);
+        writer.AddColumn("leap", leap_);
+        writer.AddColumn("version", version_);
+        writer.AddColumn("stratum", stratum_);
+        writer.AddColumn("precision", precision_);
+        writer.AddColumn("offset_ns", offset_);
+        writer.AddColumn("delay_ns", delay_);
+        return writer.Finish();
+    }
+
+
+    // Constructor:
+    TargetCursor::TargetCursor(const std::vector<std::string>& specifications, const std::chrono::milliseconds dns_timeout) : specifications_(specifications)
+    {
+        // Resolve all the hostnames first, in one batch:
+        std::vector<std::string> hostnames{};
+        for (const auto& specification : specifications_) {
+            if (in_addr address{}; specification.find('/') == std::string::npos && inet_pton(AF_INET, specification.c_str(), &address) != 1) {
+                hostnames.push_back(specification);
+            }
+        }
+
+        if (!hostnames.empty()) {
+            for (const auto& answer : DnsResolver().Resolve(hostnames, dns_timeout)) {
+                answers_.push_back(answer.address_);
+            }
+        }
+    }
+
+
+    // The next target address.
+    bool TargetCursor::Next(uint32_t& address)
+    {
+        for (;;) {
+            if (next_host_ <= last_host_) { // (64 bits, so a range ends after 255.255.255.255.)
+                address = htonl(static_cast<uint32_t>(next_host_++));
+                return true;
+            }
+
+            if (next_specification_ == specifications_.size()) {
+                return false;
+            }
+
+            const std::string& specification = specifications_[next_specification_++];
+            uint32_t first{ 0 }, last{ 0 };
+            if (in_addr parsed{}; inet_pton(AF_INET, specification.c_str(), &parsed) == 1) {
+                address = parsed.s_addr;
+            }
+            else if (ParseCidr(specification, first, last)) {
+                next_host_ = first;
+                last_host_ = last;
+                continue;
+            }
+            else if (specification.find('/') == std::string::npos) {
+                address = next_answer_ < answers_.size() ? answers_[next_answer_] : 0;
+                ++next_answer_;
+            }
+            else {
+                continue;
+            }
+
+            if (address != 0) {
+                return true;
+            }
+        }
+    }
+
+
+    // Expand target specifications into addresses.
+    std::vector<uint32_t> ExpandTargets(const std::vector<std::string>& specifications, const std::chrono::milliseconds dns_timeout)
+    {
+        TargetCursor cursor{ specifications, dns_timeout };
+        std::vector<uint32_t> targets{};
+        std::unordered_set<uint32_t> seen{};
+        for (uint32_t address{ 0 }; cursor.Next(address);) {
+            if (seen.insert(address).second) {
+                targets.push_back(address);
+            }
+        }
+
+        return targets;
+    }
+
+
+    namespace
+    {
+        // Streaming sweep: A send loop on this thread and a receive loop on another, sharing only the socket and a counter.
+        // The receive loop hands replies to a third (delivery) thread through a CompletionQueue, so a slow on_reply
+        // (a console, a file) never keeps the receive loop from draining the socket.
+        // The wait for stragglers lasts timeout_, or until answered_all() (if given) tells that every target replied:
+        // The reply count alone cannot tell, as a target may answer twice (a duplicated or replayed datagram).
+        size_t StreamingSweep(const std::function<bool(uint32_t&)>& next_target, const std::function<void(const SweepReply&)>& on_reply,
+            const SweepOptions& options, const std::function<bool()>& answered_all)
+        {
+            using std::chrono::steady_clock;
+
+            UdpTransport transport{};
+            if (transport.Error() != 0) {
+                return 0;
+            }
+
+            transport.SetBufferSize(kSocketBufferSize);
+
+            const SystemClock clock{};
+            const Cookie cookie{ clock.Now() };
+            const uint16_t port = htons(options.port_);
+            std::atomic<size_t> replies{ 0 };
+            const auto completions = std::make_unique<Completions>();
+
+            std::jthread deliverer([&] {
+                std::array<SweepReply, kCompletionBatch> batch{};
+                for (size_t count; (count = completions->WaitPop(batch.data(), batch.size())) > 0;) {
+                    for (size_t i = 0; i < count; ++i) {
+                        on_reply(batch[i]);
+                    }
+                }
+            });
+
+            std::jthread receiver([&](const std::stop_token& stop) {
+                while (!stop.stop_requested()) {
+                    if (transport.Wait(std::chrono::microseconds::max(), stop)) {
+                        replies.fetch_add(Collect(transport, cookie, port, *completions), std::memory_order_relaxed);
+                    }
+                }
+            });
+
+            // Stop both threads on every way out: If next_target or answered_all throws, the deliverer would otherwise
+            // wait in WaitPop forever, and the unwinding with it (in the jthread destructor's join).
+            const auto shut_down = [&] {
+                receiver.request_stop();
+                if (receiver.joinable()) {
+                    receiver.join();
+                }
+                completions->Close(); // (The deliverer drains what is left before it returns.)
+                if (deliverer.joinable()) {
+                    deliverer.join();
+                }
+            };
+            const ScopeExit shut_down_on_exit{ shut_down };
+
+            NtpMessage request{};
+            request.version_ = 4;
+            request.mode_ = 3; // Client
+
+            // Send at the bounded rate (a token bucket: rate_ tokens per second, up to batch_ at once): Request n is due
+            // (n + 1 - batch_) / rate_ seconds after the start.
+            // Note: Winsock has no sendmmsg(); one sendto() per target is the nearest equivalent.
+            const size_t batch = std::max<size_t>(options.batch_, 1);
+            const auto start = steady_clock::now();
+            size_t sent{ 0 };
+
+            for (uint32_t target{ 0 }; next_target(target); ++sent) {
+                if (options.rate_ != 0 && sent + 1 > batch) {
+                    const auto due = start + std::chrono::duration_cast<steady_clock::duration>(
+                        Duration(static_cast<int64_t>(static_cast<double>(sent + 1 - batch) * kNanosecondsPerSecond / options.rate_)));
+                    if (due > steady_clock::now()) {
+                        std::this_thread::sleep_until(due);
+                    }
+                }
+
+                const Endpoint endpoint{ target, port };
+                request.tx_ = cookie.Make(endpoint.address_, endpoint.port_, clock.Now()); // (T1 is in there.)
+                for (size_t attempt = 0; !transport.Send(endpoint, request.Encode()) && attempt < kSendAttempts; ++attempt) {
+                    std::this_thread::yield(); // The send buffer is full: Let the NIC catch up.
+                }
+            }
+
+            // Wait for the stragglers:
+            const auto deadline = steady_clock::now() + options.timeout_;
+            while (steady_clock::now() < deadline && !(answered_all && answered_all())) {
+                std::this_thread::sleep_for(kStragglerCheck);
+            }
+
+            shut_down();
+            return replies.load(std::memory_order_relaxed);
+        }
+    }
+
+
+    // Query every target once and collect the replies (a streaming sweep into one row per target).
+    SweepResults Sweep(const std::vector<uint32_t>& targets, const SweepOptions& options)
+    {
+        SweepResults results{};
+        results.Resize(targets.size());
+        std::copy(targets.begin(), targets.end(), results.address_.begin());
+
+        std::unordered_map<uint32_t, size_t> rows{};
+        rows.reserve(targets.size());
+        for (size_t i = 0; i < targets.size(); ++i) {
+            rows.emplace(targets[i], i);
+        }
+
+        size_t next{ 0 };
+        const auto next_target = [&targets, &next](uint32_t& address) {
+            if (next == targets.size()) {
+                return false;
+            }
+            address = targets[next++];
+            return true;
+        };
+
+        std::atomic<size_t> answered{ 0 }; // Distinct targets that replied.
+        const auto on_reply = [&rows, &results, &answered](const SweepReply& reply) { // (On the delivery thread: The only writer of results.)
+            const auto row = rows.find(reply.address_);
+            if (row == rows.end() || results.replied_[row->second] != 0) {
+                return; // Not one of the targets (a cookie cannot tell), or a duplicate.
+            }
+
+            const size_t i = row->second;
+            results.replied_[i] = 1;
+            results.leap_[i] = reply.leap_;
+            results.version_[i] = reply.version_;
+            results.stratum_[i] = reply.stratum_;
+            results.precision_[i] = reply.precision_;
+            results.offset_[i] = reply.offset_;
+            results.delay_[i] = reply.delay_;
+            answered.fetch_add(1, std::memory_order_relaxed);
+        };
+
+        StreamingSweep(next_target, on_reply, options, [&answered, &targets] { return answered.load(std::memory_order_relaxed) == targets.size(); });
+        return results;
+    }
+
+
+    // Streaming sweep (with no state per target, it waits for stragglers the whole timeout_).
+    size_t Sweep(const std::function<bool(uint32_t&)>& next_target, const std::function<void(const SweepReply&)>& on_reply, const SweepOptions& options)
+    {
+        return StreamingSweep(next_target, on_reply, options, {});
+    }
+
+
+    // Constructor:
+    LocalResponder::LocalResponder(const char* first_address, const size_t count, const uint16_t port)
+    {
+        in_addr first{};
+        if (wsa_.Error() != 0 || inet_pton(AF_INET, first_address, &first) != 1) {
+            error_ = wsa_.Error() != 0 ? wsa_.Error() : -1;
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(ntohl(first.s_addr) + static_cast<uint32_t>(i));
+            address.sin_port = htons(port);
+
+            const SOCKET s = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            u_long non_blocking{ 1 };
+            if (s == INVALID_SOCKET) {
+                error_ = WSAGetLastError();
+                return;
+            }
+
+            sockets_.push_back(s);
+            if (bind(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+                ioctlsocket(s, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+                error_ = WSAGetLastError();
+                return;
+            }
+        }
+
+        thread_ = std::thread(&LocalResponder::Run, this);
+    }
+
+
+    // Destructor:
+    LocalResponder::~LocalResponder()
+    {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+
+        for (const SOCKET s : sockets_) {
+            closesocket(s);
+        }
+    }
+
+
+    // Answer requests until stopped.
+    void LocalResponder::Run()
+    {
+        constexpr int kPollTimeoutMs = 50; // How quickly the destructor's stop request is noticed.
+
+        std::vector<WSAPOLLFD> descriptors(sockets_.size());
+        for (size_t i = 0; i < sockets_.size(); ++i) {
+            descriptors[i].fd = sockets_[i];
+            descriptors[i].events = POLLRDNORM;
+        }
+
+        const SystemClock clock{};
+        std::array<uint8_t, kMaxDatagramSize> datagram{};
+
+        while (!stop_) {
+            if (WSAPoll(descriptors.data(), static_cast<unsigned long>(descriptors.size()), kPollTimeoutMs) <= 0) {
+                continue;
+            }
+
+            for (const auto& descriptor : descriptors) {
+                if ((descriptor.revents & POLLRDNORM) == 0) {
+                    continue;
+                }
+
+                for (;;) {
+                    sockaddr_in client = {};
+                    socklen_t client_size = sizeof(client);
+                    const int bytes_received = recvfrom(descriptor.fd, reinterpret_cast<char*>(datagram.data()), static_cast<int>(datagram.size()), 0,
+                        reinterpret_cast<sockaddr*>(&client), &client_size);
+
+                    if (bytes_received == SOCKET_ERROR) {
+                        if (WSAGetLastError() == WSAECONNRESET) {
+                            continue; // (See UdpTransport::Receive.)
+                        }
+                        break;
+                    }
+
+                    if (static_cast<size_t>(bytes_received) < NtpMessage::kSize) {
+                        continue;
+                    }
+
+                    const Duration now = clock.Now();
+                    NtpMessage::Packet header{};
+                    std::copy_n(datagram.begin(), NtpMessage::kSize, header.begin());
+                    const NtpMessage request = NtpMessage::Decode(header);
+                    if (request.mode_ != 3) {
+                        continue;
+                    }
+
+                    NtpMessage reply{};
+                    reply.version_ = request.version_;
+                    reply.mode_ = 4; // Server
+                    reply.stratum_ = 2;
+                    reply.poll_ = request.poll_;
+                    reply.precision_ = static_cast<uint8_t>(SystemClock::kPrecision);
+                    std::copy_n("LOCL", 4, reply.ref_clock_id_);
+                    reply.ref_ = Timestamp::FromUnixTime(now);
+                    reply.orig_ = request.tx_;
+                    reply.rx_ = Timestamp::FromUnixTime(now);
+                    reply.tx_ = Timestamp::FromUnixTime(clock.Now());
+
+                    const auto packet = reply.Encode();
+                    sendto(descriptor.fd, reinterpret_cast<const char*>(packet.data()), static_cast<int>(packet.size()), 0,
+                        reinterpret_cast<const sockaddr*>(&client), client_size);
+                    answered_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+}
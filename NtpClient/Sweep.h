@@ -0,0 +1,208 @@
+#ifndef AMITG_FC_SWEEP
+#define AMITG_FC_SWEEP
+
+/*
+    Sweep.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// Monitoring sweep: Query a large set of servers once each (stratum, leap status, offset, delay).
+// Requests go out at a bounded rate from a single socket, and the replies are collected by a separate thread, so
+// 100k targets take (targets / rate + timeout) seconds.
+//
+// The sweep keeps no state per request (in the style of masscan's SYN cookies): Each request's transmit timestamp,
+// which the server echoes as the reply's origin timestamp, is its send time and a keyed hash of the target and that
+// time. The receive thread validates and times each reply from the packet alone, so the sending and receiving
+// threads share nothing but the socket, and memory stays the same whatever the number of targets.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "NtpCore.h"
+#include "SocketApi.h"
+
+
+namespace ntp_client
+{
+
+    // **** SweepOptions struct ****
+
+    struct SweepOptions final
+    {
+        uint32_t rate_{ 20'000 };                              // Requests per second (0 = as fast as the socket takes them).
+        size_t batch_{ 64 };                                   // Requests sent back to back (the token bucket depth).
+        Duration timeout_{ std::chrono::seconds(1) };          // How long to wait for replies after the last request.
+        uint16_t port_{ 123 };                                 // Host byte order.
+        std::chrono::milliseconds dns_timeout_{ 2000 };        // For hostname targets.
+    };
+
+
+    // **** SweepResults struct ****
+
+    // One row per target, in target order. Columnar (structure of arrays): Each field is one contiguous
+    // array, so a scan over a single field (for example, all offsets) touches only that field's memory.
+    struct SweepResults final
+    {
+        std::vector<uint32_t> address_{};  // IPv4, network byte order.
+        std::vector<uint8_t> replied_{};   // 1 if a valid reply arrived. The other fields are 0 otherwise.
+        std::vector<uint8_t> leap_{};
+        std::vector<uint8_t> version_{};
+        std::vector<uint8_t> stratum_{};   // 0 = kiss-o'-death or unspecified.
+        std::vector<int8_t> precision_{};  // log2 seconds.
+        std::vector<int64_t> offset_{};    // Nanoseconds (server minus local).
+        std::vector<int64_t> delay_{};     // Nanoseconds (round trip).
+
+
+        [[nodiscard]] size_t Size() const { return address_.size(); }
+        [[nodiscard]] size_t Replies() const;
+
+        void Resize(size_t size);
+
+
+        // Write the results as tab-separated text, one row per target, with a header line.
+        void WriteText(std::ostream& stream) const;
+
+
+        // Write the results as a columnar binary file (Columnar.h). Returns false if a write failed.
+        bool WriteColumnar(std::ostream& stream) const;
+    };
+
+
+    // Expand target specifications into addresses (network byte order), in order, without duplicates.
+    // A specification is a dotted-quad address, a CIDR range ("192.0.2.0/24", prefixes /8 to /32; the network and
+    // broadcast addresses of ranges up to /30 are skipped) or a hostname (all hostnames are resolved in one DNS batch).
+    // Invalid specifications and unresolved hostnames are skipped.
+    std::vector<uint32_t> ExpandTargets(const std::vector<std::string>& specifications, std::chrono::milliseconds dns_timeout);
+
+
+    // **** TargetCursor class ****
+
+    // ExpandTargets one address at a time, in constant memory (hostnames are still resolved up front, in one batch),
+    // for sweeps too large to hold the targets. Without a set of the addresses seen, overlapping specifications are
+    // not deduplicated.
+    class TargetCursor final
+    {
+    public:
+
+        // Constructor: Resolves the hostnames among specifications.
+        TargetCursor(const std::vector<std::string>& specifications, std::chrono::milliseconds dns_timeout);
+
+
+        // The next target address (network byte order). Returns false after the last one.
+        bool Next(uint32_t& address);
+
+    private:
+
+        std::vector<std::string> specifications_{};
+        std::vector<uint32_t> answers_{};  // Resolved hostnames, in order (0 = not resolved).
+        size_t next_specification_{ 0 };
+        size_t next_answer_{ 0 };
+        uint64_t next_host_{ 1 };          // The CIDR range in progress (host byte order; empty when next_host_ > last_host_).
+        uint64_t last_host_{ 0 };
+    };
+
+
+    // **** SweepReply struct ****
+
+    // A valid reply of a streaming sweep (the fields of one SweepResults row).
+    struct SweepReply final
+    {
+        uint32_t address_{ 0 };
+        uint8_t leap_{ 0 };
+        uint8_t version_{ 0 };
+        uint8_t stratum_{ 0 };
+        int8_t precision_{ 0 };
+        int64_t offset_{ 0 };
+        int64_t delay_{ 0 };
+
+
+        // Write the reply as one row of SweepResults::WriteText (replied = 1), and the header line of that format.
+        void WriteText(std::ostream& stream) const;
+        static void WriteTextHeader(std::ostream& stream);
+    };
+
+
+    // Query every target once (mode 3) and collect the replies.
+    // A reply must come from the target's address and port, and echo the request's transmit timestamp.
+    // Unsynchronized (leap 3) and kiss-o'-death (stratum 0) replies are recorded as they are: They are what an audit looks for.
+    SweepResults Sweep(const std::vector<uint32_t>& targets, const SweepOptions& options = {});
+
+
+    // Streaming sweep: Query every address next_target yields (until it returns false), and pass each valid reply to
+    // on_reply as it arrives. Returns the number of valid replies.
+    // next_target runs on the calling thread (which sends); on_reply runs on a delivery thread (fed by the receive thread
+    // through a CompletionQueue, so it may be slow), one reply at a time, and must not throw.
+    // With no state per target, a target that answers twice is reported twice, and the wait for stragglers always lasts
+    // timeout_ (a reply count cannot tell that every target answered).
+    size_t Sweep(const std::function<bool(uint32_t& address)>& next_target, const std::function<void(const SweepReply& reply)>& on_reply,
+        const SweepOptions& options = {});
+
+
+    // **** LocalResponder class ****
+
+    // A minimal NTP server on a range of local addresses (127.0.0.1 up to 127.0.0.<count>, or any other
+    // consecutive range), for testing sweeps without touching the network. It answers every client request with a
+    // stratum 2 reply stamped from the system clock, on a background thread.
+    class LocalResponder final
+    {
+    public:
+
+        // Constructor: Binds count consecutive addresses, starting from first_address (dotted quad), on port.
+        LocalResponder(const char* first_address, size_t count, uint16_t port);
+
+        // Destructor:
+        ~LocalResponder();
+
+        LocalResponder(const LocalResponder&) = delete;
+        LocalResponder& operator=(const LocalResponder&) = delete;
+
+
+        // Number of requests answered so far.
+        [[nodiscard]] size_t Answered() const { return answered_.load(std::memory_order_relaxed); }
+
+
+        // Get Error: 0 if all the addresses are bound.
+        int Error() const { return error_; }
+
+    private:
+
+        void Run();
+
+        detail::WSA wsa_{};
+        std::vector<SOCKET> sockets_{};
+        std::atomic<bool> stop_{ false };
+        std::atomic<size_t> answered_{ 0 };
+        std::thread thread_{};
+        int error_{ 0 };
+    };
+
+}
+
+
+#endif
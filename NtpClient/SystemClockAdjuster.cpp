@@ -0,0 +1,153 @@
+/*
+    SystemClockAdjuster.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "SystemClockAdjuster.h"
+
+#include <chrono>
+#include <cmath> // For std::llround.
+
+#include "SocketApi.h" // (For Windows.h, in the right order relative to Winsock.)
+
+// AdjustTokenPrivileges and friends are part of the Advanced Windows API.
+#pragma comment(lib, "Advapi32.lib")
+
+
+namespace // (Anonymous namespace)
+{
+
+    // FILETIME counts 100-nanosecond intervals since Jan 1, 1601.
+    constexpr int64_t kFileTimeToUnixEpoch = 116'444'736'000'000'000; // 100ns intervals from 1601 to 1970.
+
+
+    // Enable the SE_SYSTEMTIME_NAME privilege for this process.
+    // Return 0 on success, the Windows error code otherwise.
+    DWORD EnableSystemTimePrivilege()
+    {
+        HANDLE token{ nullptr };
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            return GetLastError();
+        }
+
+        TOKEN_PRIVILEGES privileges{};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+        DWORD error{ ERROR_SUCCESS };
+        if (!LookupPrivilegeValue(nullptr, SE_SYSTEMTIME_NAME, &privileges.Privileges[0].Luid) ||
+            !AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)) {
+            error = GetLastError();
+        } else {
+            // AdjustTokenPrivileges succeeds even if the privilege is not held (ERROR_NOT_ALL_ASSIGNED).
+            error = GetLastError();
+        }
+
+        CloseHandle(token);
+        return error;
+    }
+
+}
+
+
+namespace ntp_client
+{
+
+    // Constructor:
+    SystemClockAdjuster::SystemClockAdjuster()
+    {
+        error_ = EnableSystemTimePrivilege();
+
+        // The current adjustment state tells us the nominal increment per clock tick. A slew is expressed as
+        // an adjustment slightly larger (or smaller) than it.
+        DWORD64 adjustment{ 0 }, increment{ 0 };
+        BOOL disabled{ TRUE };
+        if (error_ == ERROR_SUCCESS) {
+            if (GetSystemTimeAdjustmentPrecise(&adjustment, &increment, &disabled)) {
+                time_increment_ = increment;
+            } else {
+                error_ = GetLastError();
+            }
+        }
+    }
+
+
+    // Destructor:
+    SystemClockAdjuster::~SystemClockAdjuster()
+    {
+        if (error_ == ERROR_SUCCESS) {
+            SetSlewRate(0); // Hand the clock rate back to the system.
+        }
+    }
+
+
+    // Current system time, since the unix epoch.
+    Duration SystemClockAdjuster::Now() const
+    {
+        FILETIME file_time{};
+        GetSystemTimePreciseAsFileTime(&file_time);
+
+        const auto intervals = static_cast<int64_t>(static_cast<uint64_t>(file_time.dwHighDateTime) << 32 | file_time.dwLowDateTime);
+        return Duration((intervals - kFileTimeToUnixEpoch) * 100);
+    }
+
+
+    // Jump the system clock by correction.
+    bool SystemClockAdjuster::Step(const Duration correction)
+    {
+        if (error_ != ERROR_SUCCESS) {
+            return false;
+        }
+
+        // SYSTEMTIME has millisecond resolution: Setting it at an arbitrary moment would drop the sub-millisecond
+        // part of the target (up to 1 ms of error). Instead, wait until the target is on a millisecond boundary, and
+        // set it then. The step is exact up to the latency of this wait and of SetSystemTime (microseconds).
+        constexpr Duration kMillisecond = std::chrono::milliseconds(1);
+        const Duration fraction = ((Now() + correction) % kMillisecond + kMillisecond) % kMillisecond;
+        const Duration until = Now() + (kMillisecond - fraction);
+        while (Now() < until) {
+        }
+
+        const auto target = std::chrono::round<std::chrono::milliseconds>(Now() + correction);
+        const auto intervals = static_cast<uint64_t>(Duration(target).count() / 100 + kFileTimeToUnixEpoch);
+        const FILETIME file_time{ static_cast<DWORD>(intervals), static_cast<DWORD>(intervals >> 32) };
+
+        SYSTEMTIME system_time{};
+        return FileTimeToSystemTime(&file_time, &system_time) && SetSystemTime(&system_time);
+    }
+
+
+    // Run the system clock fast (ppm > 0) or slow (ppm < 0). 0 = Nominal rate (adjustment disabled).
+    bool SystemClockAdjuster::SetSlewRate(const double ppm)
+    {
+        if (error_ != ERROR_SUCCESS) {
+            return false;
+        }
+
+        if (ppm == 0) {
+            return SetSystemTimeAdjustmentPrecise(0, TRUE);
+        }
+
+        const auto adjustment = static_cast<DWORD64>(std::llround(static_cast<double>(time_increment_) * (1 + ppm / 1e6)));
+        return SetSystemTimeAdjustmentPrecise(adjustment, FALSE);
+    }
+
+}
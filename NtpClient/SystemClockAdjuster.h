@@ -0,0 +1,73 @@
+#ifndef AMITG_FC_SYSTEMCLOCKADJUSTER
+#define AMITG_FC_SYSTEMCLOCKADJUSTER
+
+/*
+    SystemClockAdjuster.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <cstdint> // For using uint32_t or similar types.
+
+#include "ClockDiscipline.h"
+
+
+namespace ntp_client
+{
+
+    // **** SystemClockAdjuster class ****
+
+    // Clock adjuster policy for the Windows system clock (see ClockController):
+    // Steps with SetSystemTime and slews with SetSystemTimeAdjustmentPrecise. (SetSystemTime takes whole milliseconds,
+    // so Step waits, at most 1 ms, until the target time is on a millisecond boundary.)
+    // Requires the SE_SYSTEMTIME_NAME privilege (an elevated process). The constructor enables it, and Error()
+    // reports failure. The destructor hands the clock rate back to the system.
+    class SystemClockAdjuster final
+    {
+    public:
+
+        // Constructor:
+        SystemClockAdjuster();
+
+        // Destructor:
+        ~SystemClockAdjuster();
+
+        SystemClockAdjuster(const SystemClockAdjuster&) = delete;
+        SystemClockAdjuster& operator=(const SystemClockAdjuster&) = delete;
+
+
+        [[nodiscard]] Duration Now() const;
+        bool Step(Duration correction);
+        bool SetSlewRate(double ppm);
+
+
+        // Get Error: 0 if the clock can be adjusted.
+        unsigned long Error() const { return error_; }
+
+    private:
+
+        uint64_t time_increment_{ 0 }; // Nominal amount added to the clock per tick (the "no adjustment" value).
+        unsigned long error_{ 0 };
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,111 @@
+/*
+    CircuitBreakerTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "CircuitBreaker.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+    using Admission = CircuitBreaker::Admission;
+
+}
+
+
+NTP_TEST(CircuitBreakerOpensAfterThreshold)
+{
+    CircuitBreaker breaker(BreakerOptions{ 2, 50ms, 1000ms });
+
+    NTP_CHECK(breaker.Admit("a") == Admission::kAllow);
+    breaker.Record("a", false);
+    NTP_CHECK(breaker.Admit("a") == Admission::kAllow); // One failure: Still closed.
+    breaker.Record("a", false);
+    NTP_CHECK(breaker.Admit("a") == Admission::kReject);
+    NTP_CHECK(breaker.Admit("b") == Admission::kAllow); // Breakers are per key.
+}
+
+
+NTP_TEST(CircuitBreakerAdmitsOneProbe)
+{
+    CircuitBreaker breaker(BreakerOptions{ 1, 20ms, 1000ms });
+    breaker.Record("a", false);
+
+    std::this_thread::sleep_for(30ms); // (Past the backoff, jittered down from 20 ms.)
+    NTP_CHECK(breaker.Admit("a") == Admission::kProbe);
+    NTP_CHECK(breaker.Admit("a") == Admission::kReject); // Half-open: The probe is on its way.
+
+    breaker.Record("a", true);
+    NTP_CHECK(breaker.Admit("a") == Admission::kAllow);
+}
+
+
+NTP_TEST(CircuitBreakerReopensOnFailedProbe)
+{
+    CircuitBreaker breaker(BreakerOptions{ 1, 20ms, 1000ms });
+    breaker.Record("a", false);
+
+    std::this_thread::sleep_for(30ms);
+    NTP_CHECK(breaker.Admit("a") == Admission::kProbe);
+    breaker.Record("a", false);
+
+    // The backoff doubled (to 20-40 ms); 15 ms later it is still open.
+    std::this_thread::sleep_for(15ms);
+    NTP_CHECK(breaker.Admit("a") == Admission::kReject);
+}
+
+
+NTP_TEST(CircuitBreakerForgetsClosedKeys)
+{
+    CircuitBreaker breaker{};
+    for (int i = 0; i < 100; ++i) {
+        const std::string key = "server" + std::to_string(i);
+        breaker.Record(key, false);
+        breaker.Record(key, true);
+    }
+
+    NTP_CHECK(breaker.Size() == 0);
+}
+
+
+NTP_TEST(CircuitBreakerIsBounded)
+{
+    BreakerOptions options{};
+    options.threshold_ = 1;
+    options.max_keys_ = 16;
+    CircuitBreaker breaker(options);
+
+    for (int i = 0; i < 1000; ++i) {
+        breaker.Record("server" + std::to_string(i), false);
+        NTP_CHECK(breaker.Size() <= options.max_keys_);
+    }
+
+    NTP_CHECK(breaker.Admit("server999") == Admission::kReject); // The latest failures are kept.
+}
@@ -0,0 +1,163 @@
+/*
+    ClockDisciplineTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+
+#include "ClockDiscipline.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+    using Controller = ClockController<SimulatedClock>;
+
+    constexpr Duration kUpdate = 10ms;
+
+
+    Duration Magnitude(const Duration value) { return value < Duration(0) ? -value : value; }
+
+
+    // Advance true time in kUpdate steps, updating the controller, until the slew ends (or limit passes).
+    Duration RunSlew(SimulatedClock& clock, Controller& controller, const Duration limit)
+    {
+        Duration elapsed{ 0 };
+        while (controller.Slewing() && elapsed < limit) {
+            clock.Advance(kUpdate);
+            controller.Update();
+            elapsed += kUpdate;
+        }
+        return elapsed;
+    }
+
+
+    // **** RefusingClock class ****
+
+    // A clock adjuster that lacks the privilege to adjust anything.
+    class RefusingClock final
+    {
+    public:
+
+        [[nodiscard]] Duration Now() const { return Duration(0); }
+        bool Step(Duration) { return false; }
+        bool SetSlewRate(double) { return false; }
+    };
+
+}
+
+
+NTP_TEST(ClockDisciplineStepsLargeOffsets)
+{
+    SimulatedClock clock{ 1'700'000'000s, -2s };
+    Controller controller{ clock };
+
+    NTP_CHECK(controller.Apply(2s) == Controller::Action::kStep);
+    NTP_CHECK(clock.Error() == 0s && clock.Steps() == 1);
+    NTP_CHECK(!controller.Slewing() && clock.SlewRate() == 0);
+
+    // Just above the threshold (128 ms by default) steps, at it slews.
+    NTP_CHECK(controller.Apply(-129ms) == Controller::Action::kStep);
+    NTP_CHECK(controller.Apply(128ms) == Controller::Action::kSlew);
+    NTP_CHECK(clock.Steps() == 2);
+}
+
+
+NTP_TEST(ClockDisciplineSlewsSmallOffsets)
+{
+    for (const Duration offset : { Duration(50ms), Duration(-50ms), Duration(3us) }) {
+        SimulatedClock clock{ 1'700'000'000s, -offset };
+        Controller controller{ clock };
+
+        NTP_CHECK(controller.Apply(offset) == Controller::Action::kSlew);
+        NTP_CHECK(controller.Slewing());
+        NTP_CHECK(clock.SlewRate() == (offset > 0s ? 500 : -500));
+
+        // 50 ms at 500 ppm takes 100 s; the clock never jumps meanwhile.
+        const Duration elapsed = RunSlew(clock, controller, 1000s);
+        NTP_CHECK(!controller.Slewing() && clock.SlewRate() == 0 && clock.Steps() == 0);
+        NTP_CHECK(elapsed <= Magnitude(offset) * 2000 + kUpdate);
+        NTP_CHECK(Magnitude(clock.Error()) <= 5us); // The overshoot: 500 ppm of one update interval.
+    }
+}
+
+
+NTP_TEST(ClockDisciplineReplacesSlewAndIgnoresZero)
+{
+    SimulatedClock clock{ 1'700'000'000s, -40ms };
+    Controller controller{ clock };
+
+    NTP_CHECK(controller.Apply(0s) == Controller::Action::kNone);
+    NTP_CHECK(!controller.Slewing());
+
+    NTP_CHECK(controller.Apply(40ms) == Controller::Action::kSlew);
+    RunSlew(clock, controller, 20s); // Part way: 10 ms worked off.
+
+    // A new measurement replaces the slew in progress, whatever its direction.
+    NTP_CHECK(controller.Apply(-clock.Error()) == Controller::Action::kSlew);
+    RunSlew(clock, controller, 1000s);
+    NTP_CHECK(Magnitude(clock.Error()) <= 5us);
+
+    // A step cancels a slew.
+    clock.Step(-10ms);
+    controller.Apply(10ms);
+    NTP_CHECK(controller.Apply(1s) == Controller::Action::kStep && !controller.Slewing() && clock.SlewRate() == 0);
+}
+
+
+NTP_TEST(ClockDisciplineTracksDrift)
+{
+    // A 20 ppm oscillator, corrected from a (perfect) measurement every 64 s: The error stays near one poll's drift.
+    SimulatedClock clock{ 1'700'000'000s, 30ms };
+    clock.SetDrift(20);
+    Controller controller{ clock };
+
+    Duration worst{ 0 };
+    for (int poll = 0; poll < 100; ++poll) {
+        controller.Apply(-clock.Error());
+        for (Duration elapsed{ 0 }; elapsed < 64s; elapsed += kUpdate) {
+            clock.Advance(kUpdate);
+            controller.Update();
+        }
+        if (poll >= 10) {
+            worst = std::max(worst, Magnitude(clock.Error()));
+        }
+    }
+
+    NTP_CHECK(worst <= 2ms); // 20 ppm of 64 s is 1.28 ms.
+    NTP_CHECK(clock.Steps() == 0);
+}
+
+
+NTP_TEST(ClockDisciplineReportsFailures)
+{
+    RefusingClock clock{};
+    ClockController<RefusingClock> controller{ clock };
+
+    NTP_CHECK(controller.Apply(1s) == ClockController<RefusingClock>::Action::kFailed);
+    NTP_CHECK(controller.Apply(1ms) == ClockController<RefusingClock>::Action::kFailed);
+    NTP_CHECK(!controller.Slewing());
+}
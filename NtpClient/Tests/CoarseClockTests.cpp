@@ -0,0 +1,90 @@
+/*
+    CoarseClockTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <optional>
+#include <thread>
+
+#include "CoarseClock.h"
+#include "MonotonicClock.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+}
+
+
+NTP_TEST(CoarseClockFollowsItsSource)
+{
+    const MonotonicClock source{};
+    const CoarseClock clock{ 1ms, source };
+    NTP_CHECK(CoarseClock::Running());
+
+    // Readable as soon as the constructor returns, then at most a tick (plus scheduling) behind the source.
+    const Duration first = CoarseNow();
+    NTP_CHECK(first > 0s && first <= source.Now());
+
+    std::this_thread::sleep_for(50ms);
+    const Duration later = CoarseNow();
+    NTP_CHECK(later > first);
+    NTP_CHECK(source.Now() - later < 40ms);
+
+    // Never decreases (the source never does).
+    Duration last = CoarseNow();
+    for (int i = 0; i < 100'000; ++i) {
+        const Duration now = CoarseNow();
+        NTP_CHECK(now >= last);
+        last = now;
+    }
+}
+
+
+NTP_TEST(CoarseClockLastInstanceStopsTheTicker)
+{
+    NTP_CHECK(!CoarseClock::Running());
+
+    std::optional<CoarseClock> first{};
+    first.emplace(1ms);
+    {
+        const CoarseClock second{ 5ms }; // Shares the running ticker (with the first instance's tick).
+        NTP_CHECK(CoarseClock::Running());
+    }
+    NTP_CHECK(CoarseClock::Running());
+
+    first.reset();
+    NTP_CHECK(!CoarseClock::Running());
+
+    // The last time stays readable, and no longer moves.
+    const Duration stopped = CoarseNow();
+    std::this_thread::sleep_for(20ms);
+    NTP_CHECK(CoarseNow() == stopped && stopped > 0s);
+
+    // And a new instance starts it again.
+    const CoarseClock again{};
+    NTP_CHECK(CoarseClock::Running() && CoarseNow() >= stopped);
+}
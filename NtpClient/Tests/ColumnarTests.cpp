@@ -0,0 +1,218 @@
+/*
+    ColumnarTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <cstring> // For std::memcpy.
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Columnar.h"
+#include "NtpEngine.h"
+#include "Sweep.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+
+
+    // The bytes a stream received. (std::vector's storage is aligned for any scalar type, as a mapped view would be.)
+    std::vector<std::byte> Bytes(const std::ostringstream& stream)
+    {
+        const std::string text = stream.str();
+        std::vector<std::byte> bytes(text.size());
+        std::transform(text.begin(), text.end(), bytes.begin(), [](const char c) { return static_cast<std::byte>(c); });
+        return bytes;
+    }
+
+
+    template <typename T>
+    bool Equal(const std::span<const T> column, const std::vector<T>& values)
+    {
+        return std::equal(column.begin(), column.end(), values.begin(), values.end());
+    }
+
+}
+
+
+NTP_TEST(ColumnarRoundTripsEveryType)
+{
+    const std::vector<uint8_t> u8{ 0, 1, 255 };
+    const std::vector<int8_t> i8{ -128, 0, 127 };
+    const std::vector<uint16_t> u16{ 0, 65535 };
+    const std::vector<int16_t> i16{ -32768, 32767 };
+    const std::vector<uint32_t> u32{ 0, 4'000'000'000u, 7 };
+    const std::vector<int32_t> i32{ -2'000'000'000, 2'000'000'000 };
+    const std::vector<uint64_t> u64{ UINT64_MAX, 0 };
+    const std::vector<int64_t> i64{ INT64_MIN, -1, INT64_MAX };
+    const std::vector<double> f64{ -0.5, 3.25, 1e300 };
+
+    std::ostringstream stream(std::ios::binary);
+    ColumnarWriter writer(stream);
+    writer.AddColumn("u8", u8);
+    writer.AddColumn("i8", i8);
+    writer.AddColumn("u16", u16);
+    writer.AddColumn("i16", i16);
+    writer.AddColumn("u32", u32);
+    writer.AddColumn("i32", i32);
+    writer.AddColumn("u64", u64);
+    writer.AddColumn("i64", i64);
+    writer.AddColumn("f64", f64);
+    NTP_CHECK(writer.Finish());
+
+    const auto file = Bytes(stream);
+    const ColumnarReader reader(file);
+    NTP_CHECK(reader.Valid());
+    NTP_CHECK(reader.Columns().size() == 9);
+
+    NTP_CHECK(Equal(reader.Column<uint8_t>("u8"), u8));
+    NTP_CHECK(Equal(reader.Column<int8_t>("i8"), i8));
+    NTP_CHECK(Equal(reader.Column<uint16_t>("u16"), u16));
+    NTP_CHECK(Equal(reader.Column<int16_t>("i16"), i16));
+    NTP_CHECK(Equal(reader.Column<uint32_t>("u32"), u32));
+    NTP_CHECK(Equal(reader.Column<int32_t>("i32"), i32));
+    NTP_CHECK(Equal(reader.Column<uint64_t>("u64"), u64));
+    NTP_CHECK(Equal(reader.Column<int64_t>("i64"), i64));
+    NTP_CHECK(Equal(reader.Column<double>("f64"), f64));
+
+    for (const auto& column : reader.Columns()) {
+        NTP_CHECK(column.offset_ % ColumnarWriter::kAlignment == 0);
+    }
+}
+
+
+NTP_TEST(ColumnarLookupChecksNameAndType)
+{
+    std::ostringstream stream(std::ios::binary);
+    ColumnarWriter writer(stream);
+    writer.AddColumn("offset_ns", std::vector<int64_t>{ 1, 2, 3 });
+    writer.AddColumn("empty", std::vector<uint32_t>{});
+    writer.AddColumn("a_name_longer_than_twenty_three_characters", std::vector<uint8_t>{ 9 });
+    NTP_CHECK(writer.Finish());
+
+    const auto file = Bytes(stream);
+    const ColumnarReader reader(file);
+    NTP_CHECK(reader.Valid());
+
+    NTP_CHECK(reader.Column<int64_t>("offset_ns").size() == 3);
+    NTP_CHECK(reader.Column<uint64_t>("offset_ns").empty()); // Wrong type.
+    NTP_CHECK(reader.Column<int64_t>("missing").empty());
+    NTP_CHECK(reader.Columns().size() == 3 && reader.Columns()[1].rows_ == 0);
+    NTP_CHECK(reader.Column<uint8_t>("a_name_longer_than_twen").size() == 1); // Truncated to ColumnEntry::kMaxName.
+}
+
+
+NTP_TEST(ColumnarRejectsDamagedFiles)
+{
+    std::ostringstream stream(std::ios::binary);
+    ColumnarWriter writer(stream);
+    writer.AddColumn("values", std::vector<int64_t>(100, 7));
+    NTP_CHECK(writer.Finish());
+    const auto file = Bytes(stream);
+
+    NTP_CHECK(!ColumnarReader(std::span<const std::byte>(file).first(file.size() - 1)).Valid()); // Truncated.
+    NTP_CHECK(!ColumnarReader(std::span<const std::byte>(file).first(10)).Valid());
+    NTP_CHECK(!ColumnarReader(std::span<const std::byte>{}).Valid());
+
+    auto bad_magic = file;
+    bad_magic[0] = std::byte{ 'X' };
+    NTP_CHECK(!ColumnarReader(bad_magic).Valid());
+
+    // A footer entry that points past the end of the file: The reader stays valid, but the column is not returned.
+    auto bad_rows = file;
+    const size_t rows_field = file.size() - sizeof(ColumnarTrailer) - sizeof(ColumnEntry) + offsetof(ColumnEntry, rows_);
+    bad_rows[rows_field + 4] = std::byte{ 1 };
+    const ColumnarReader reader(bad_rows);
+    NTP_CHECK(reader.Valid() && reader.Column<int64_t>("values").empty());
+
+    // A row count whose size in bytes wraps around: 2^61 + 1 rows of 8 bytes "take" 8 bytes.
+    auto wrapping_rows = file;
+    const uint64_t rows = (uint64_t{ 1 } << 61) + 1;
+    std::memcpy(wrapping_rows.data() + rows_field, &rows, sizeof(rows));
+    NTP_CHECK(ColumnarReader(wrapping_rows).Column<int64_t>("values").empty());
+
+    // A name that fills its field without a terminator: It is cut at kMaxName characters, and never read past.
+    auto long_name = file;
+    const size_t name_field = file.size() - sizeof(ColumnarTrailer) - sizeof(ColumnEntry) + offsetof(ColumnEntry, name_);
+    std::memset(long_name.data() + name_field, 'n', ColumnEntry::kMaxName + 1);
+    const ColumnarReader long_name_reader(long_name);
+    NTP_CHECK(long_name_reader.Valid());
+    NTP_CHECK(long_name_reader.Column<int64_t>(std::string(ColumnEntry::kMaxName + 1, 'n')).empty());
+    NTP_CHECK(long_name_reader.Column<int64_t>(std::string(ColumnEntry::kMaxName, 'n')).size() == 100);
+}
+
+
+NTP_TEST(ColumnarSweepResultsRoundTrip)
+{
+    SweepResults results{};
+    results.Resize(3);
+    results.address_ = { 0x0100007F, 0x0200007F, 0x0300007F };
+    results.replied_ = { 1, 0, 1 };
+    results.stratum_ = { 2, 0, 16 };
+    results.precision_ = { -20, 0, -6 };
+    results.offset_ = { 1500, 0, -250'000 };
+    results.delay_ = { 40'000, 0, 90'000 };
+
+    std::ostringstream stream(std::ios::binary);
+    NTP_CHECK(results.WriteColumnar(stream));
+
+    const auto file = Bytes(stream);
+    const ColumnarReader reader(file);
+    NTP_CHECK(reader.Valid());
+    NTP_CHECK(Equal(reader.Column<uint32_t>("address"), results.address_));
+    NTP_CHECK(Equal(reader.Column<uint8_t>("replied"), results.replied_));
+    NTP_CHECK(Equal(reader.Column<uint8_t>("stratum"), results.stratum_));
+    NTP_CHECK(Equal(reader.Column<int8_t>("precision"), results.precision_));
+    NTP_CHECK(Equal(reader.Column<int64_t>("offset_ns"), results.offset_));
+    NTP_CHECK(Equal(reader.Column<int64_t>("delay_ns"), results.delay_));
+}
+
+
+NTP_TEST(ColumnarSampleLogRoundTrip)
+{
+    SampleLog log{};
+    Sample sample{};
+    sample.time_ = std::chrono::seconds(1'700'000'000);
+    sample.offset_ = std::chrono::microseconds(-12);
+    sample.delay_ = std::chrono::milliseconds(3);
+    sample.dispersion_ = std::chrono::microseconds(40);
+    log.Append(0, 2, sample);
+    log.Append(1, 0, sample);
+
+    std::ostringstream stream(std::ios::binary);
+    NTP_CHECK(log.WriteColumnar(stream));
+
+    const auto file = Bytes(stream);
+    const ColumnarReader reader(file);
+    NTP_CHECK(Equal(reader.Column<int64_t>("time_ns"), log.time_));
+    NTP_CHECK(Equal(reader.Column<uint32_t>("peer"), log.peer_));
+    NTP_CHECK(Equal(reader.Column<uint8_t>("stratum"), log.stratum_));
+    NTP_CHECK(Equal(reader.Column<int64_t>("offset_ns"), log.offset_));
+    NTP_CHECK(Equal(reader.Column<int64_t>("delay_ns"), log.delay_));
+    NTP_CHECK(Equal(reader.Column<int64_t>("dispersion_ns"), log.dispersion_));
+}
@@ -0,0 +1,183 @@
+/*
+    CompletionQueueTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "CompletionQueue.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+}
+
+
+NTP_TEST(CompletionQueueFifoAcrossLaps)
+{
+    CompletionQueue<int, 4> queue{};
+    int value{ 0 };
+    NTP_CHECK(queue.Empty() && !queue.TryPop(value));
+
+    // Several laps around the ring, filling it each time.
+    int next_in{ 0 };
+    int next_out{ 0 };
+    for (int lap = 0; lap < 5; ++lap) {
+        while (queue.TryPush(next_in)) {
+            ++next_in;
+        }
+        NTP_CHECK(next_in == (lap + 1) * 4);
+
+        while (queue.TryPop(value)) {
+            NTP_CHECK(value == next_out++);
+        }
+        NTP_CHECK(next_out == next_in && queue.Empty());
+    }
+}
+
+
+NTP_TEST(CompletionQueueBatches)
+{
+    CompletionQueue<std::unique_ptr<int>, 8> queue{}; // Move-only completions.
+
+    std::array<std::unique_ptr<int>, 10> in{};
+    for (int i = 0; i < 10; ++i) {
+        in[i] = std::make_unique<int>(i);
+    }
+    NTP_CHECK(queue.PushBatch(in.data(), in.size()) == 8); // Full after 8.
+    NTP_CHECK(in[8] != nullptr && in[9] != nullptr);         // The rest are left to the caller.
+
+    std::array<std::unique_ptr<int>, 5> out{};
+    NTP_CHECK(queue.PopBatch(out.data(), out.size()) == 5);
+    NTP_CHECK(*out[0] == 0 && *out[4] == 4);
+    NTP_CHECK(queue.PushBatch(&in[8], 2) == 2);
+    NTP_CHECK(queue.PopBatch(out.data(), out.size()) == 5);
+    NTP_CHECK(*out[0] == 5 && *out[2] == 7 && *out[4] == 9);
+    NTP_CHECK(queue.Empty());
+}
+
+
+NTP_TEST(CompletionQueueManyProducersManyConsumers)
+{
+    constexpr uint32_t kProducers = 4;
+    constexpr uint32_t kConsumers = 2;
+    constexpr uint32_t kPerProducer = 20000;
+    CompletionQueue<uint32_t, 64> queue{};
+
+    std::vector<std::atomic<uint32_t>> seen(kProducers * kPerProducer);
+    std::atomic<size_t> out_of_order{ 0 };
+    std::atomic<uint32_t> finished_producers{ 0 };
+
+    std::vector<std::jthread> consumers{};
+    for (uint32_t c = 0; c < kConsumers; ++c) {
+        consumers.emplace_back([&] {
+            std::array<uint32_t, 16> batch{};
+            std::array<int64_t, kProducers> last{};
+            last.fill(-1);
+            while (const size_t count = queue.WaitPop(batch.data(), batch.size())) {
+                for (size_t i = 0; i < count; ++i) {
+                    const uint32_t producer = batch[i] / kPerProducer;
+                    // Each producer's completions reach any one consumer in the order they were pushed.
+                    if (static_cast<int64_t>(batch[i]) <= last[producer]) {
+                        ++out_of_order;
+                    }
+                    last[producer] = batch[i];
+                    seen[batch[i]].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+
+    {
+        std::vector<std::jthread> producers{};
+        for (uint32_t p = 0; p < kProducers; ++p) {
+            producers.emplace_back([&, p] {
+                for (uint32_t i = 0; i < kPerProducer; ++i) {
+                    while (!queue.TryPush(p * kPerProducer + i)) {
+                        std::this_thread::yield(); // Full: Let the consumers catch up.
+                    }
+                }
+                ++finished_producers;
+            });
+        }
+    }
+
+    // Every completion is popped before Close() releases the consumers (WaitPop drains first).
+    while (!queue.Empty()) {
+        std::this_thread::sleep_for(1ms);
+    }
+    queue.Close();
+    consumers.clear();
+
+    size_t missing{ 0 };
+    size_t duplicated{ 0 };
+    for (const auto& count : seen) {
+        missing += count.load() == 0 ? 1 : 0;
+        duplicated += count.load() > 1 ? 1 : 0;
+    }
+    NTP_CHECK(finished_producers.load() == kProducers);
+    NTP_CHECK(missing == 0);
+    NTP_CHECK(duplicated == 0);
+    NTP_CHECK(out_of_order.load() == 0);
+}
+
+
+NTP_TEST(CompletionQueueWaitPopWakesAndCloses)
+{
+    CompletionQueue<int, 8> queue{};
+    std::atomic<int> received{ -1 };
+
+    std::jthread consumer([&] {
+        int value{ 0 };
+        NTP_CHECK(queue.WaitPop(&value, 1) == 1);
+        received = value;
+        NTP_CHECK(queue.WaitPop(&value, 1) == 0); // Released by Close().
+    });
+
+    std::this_thread::sleep_for(50ms); // (Let it fall asleep.)
+    NTP_CHECK(queue.TryPush(7));
+
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (received.load() != 7 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    NTP_CHECK(received.load() == 7);
+
+    std::this_thread::sleep_for(50ms);
+    queue.Close();
+    consumer.join();
+
+    NTP_CHECK(queue.TryPush(8)); // Still accepted after Close().
+    int value{ 0 };
+    NTP_CHECK(queue.WaitPop(&value, 1) == 1 && value == 8); // Drains before reporting closed.
+}
@@ -0,0 +1,222 @@
+/*
+    ControlServerTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ControlServer.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+
+
+    constexpr auto kQueryTimeout = std::chrono::milliseconds(300);
+
+    using Fragments = std::vector<std::pair<size_t, size_t>>; // (Offset, count) of each fragment, in sending order.
+
+
+    // **** FragmentingServer class ****
+
+    // A mode 6 server on 127.0.0.1 that answers every request with the given fragments of data, in the given order
+    // (fragments may repeat, or be left out). The fragment that reaches the end of data carries the M bit clear.
+    class FragmentingServer final
+    {
+    public:
+
+        // Constructor:
+        FragmentingServer(std::string data, Fragments fragments) : data_(std::move(data)), fragments_(std::move(fragments))
+        {
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t address_size = sizeof(address);
+
+            socket_ = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (socket_ == INVALID_SOCKET || bind(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+                getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &address_size) == SOCKET_ERROR) {
+                return;
+            }
+
+            port_ = ntohs(address.sin_port);
+            thread_ = std::thread(&FragmentingServer::Run, this);
+        }
+
+
+        // Destructor:
+        ~FragmentingServer()
+        {
+            stop_ = true;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+
+            if (socket_ != INVALID_SOCKET) {
+                closesocket(socket_);
+            }
+        }
+
+        FragmentingServer(const FragmentingServer&) = delete;
+        FragmentingServer& operator=(const FragmentingServer&) = delete;
+
+
+        // The port the server listens on (0 if it could not bind).
+        [[nodiscard]] uint16_t Port() const { return port_; }
+
+    private:
+
+        void Run()
+        {
+            constexpr int kPollTimeoutMs = 20;
+
+            WSAPOLLFD descriptor{};
+            descriptor.fd = socket_;
+            descriptor.events = POLLRDNORM;
+
+            std::array<uint8_t, 512> datagram{};
+            while (!stop_) {
+                if (WSAPoll(&descriptor, 1, kPollTimeoutMs) <= 0) {
+                    continue;
+                }
+
+                sockaddr_in client = {};
+                socklen_t client_size = sizeof(client);
+                if (recvfrom(socket_, reinterpret_cast<char*>(datagram.data()), static_cast<int>(datagram.size()), 0,
+                    reinterpret_cast<sockaddr*>(&client), &client_size) < 12) {
+                    continue;
+                }
+
+                for (const auto& [offset, count] : fragments_) {
+                    std::array<uint8_t, 512> reply{};
+                    reply[0] = datagram[0];                                              // LI, VN, mode 6.
+                    reply[1] = static_cast<uint8_t>(0x80 | (offset + count < data_.size() ? 0x20 : 0) | (datagram[1] & 0x1f));
+                    std::copy_n(&datagram[2], 2, &reply[2]);                             // Sequence.
+                    std::copy_n(&datagram[6], 2, &reply[6]);                             // Association ID.
+                    reply[8] = static_cast<uint8_t>(offset >> 8);
+                    reply[9] = static_cast<uint8_t>(offset);
+                    reply[10] = static_cast<uint8_t>(count >> 8);
+                    reply[11] = static_cast<uint8_t>(count);
+                    std::copy_n(data_.begin() + static_cast<std::ptrdiff_t>(offset), count, &reply[12]);
+
+                    sendto(socket_, reinterpret_cast<const char*>(reply.data()), static_cast<int>(12 + (count + 3) / 4 * 4), 0,
+                        reinterpret_cast<const sockaddr*>(&client), client_size);
+                }
+            }
+        }
+
+
+        detail::WSA wsa_{};
+        std::string data_{};
+        Fragments fragments_{};
+        SOCKET socket_{ INVALID_SOCKET };
+        uint16_t port_{ 0 };
+        std::atomic<bool> stop_{ false };
+        std::thread thread_{};
+    };
+
+
+    // An engine snapshot with two synchronized servers.
+    EngineStatus TwoPeers()
+    {
+        EngineStatus status{};
+        status.valid_ = 1;
+        status.offset_ = 1'500'000;
+        status.survivors_ = 2;
+        status.peer_count_ = 2;
+        for (uint32_t i = 0; i < status.peer_count_; ++i) {
+            status.peers_[i].endpoint_ = Endpoint{ htonl(0xC0000201 + i), htons(123) }; // 192.0.2.1, 192.0.2.2
+            status.peers_[i].stratum_ = 2;
+            status.peers_[i].reach_ = 0xff;
+            status.peers_[i].samples_ = 8;
+        }
+        return status;
+    }
+
+}
+
+
+NTP_TEST(ControlServerAnswersFromSnapshot)
+{
+    Seqlock<EngineStatus> status{};
+    status.Publish(TwoPeers());
+
+    const ControlServer server(status, 0);
+    NTP_CHECK(server.Error() == 0);
+
+    ControlClient client(server.Port(), kQueryTimeout);
+    const auto associations = client.Associations();
+    NTP_CHECK(associations && *associations == (std::vector<uint16_t>{ 1, 2 }));
+
+    const auto system = client.Variables(0);
+    NTP_CHECK(system && system->find("leap=0") != std::string::npos && system->find("peers=2") != std::string::npos);
+    NTP_CHECK(system && system->find("offset=1.500000") != std::string::npos);
+
+    const auto peer = client.Variables(2);
+    NTP_CHECK(peer && peer->find("srcadr=192.0.2.2") != std::string::npos && peer->find("reach=0xff") != std::string::npos);
+
+    NTP_CHECK(!client.Variables(3)); // No such association: An error response.
+}
+
+
+NTP_TEST(ControlServerServesLatestSnapshot)
+{
+    Seqlock<EngineStatus> status{};
+    const ControlServer server(status, 0);
+    ControlClient client(server.Port(), kQueryTimeout);
+
+    NTP_CHECK(client.Associations() == std::vector<uint16_t>{}); // Before the first Publish: No peers.
+
+    status.Publish(TwoPeers());
+    NTP_CHECK(client.Associations() == (std::vector<uint16_t>{ 1, 2 }));
+}
+
+
+NTP_TEST(ControlClientReassemblesFragmentsInAnyOrder)
+{
+    const std::string data = "srcadr=192.0.2.1, stratum=2, offset=0.25";
+    const FragmentingServer server(data, Fragments{ { 24, 16 }, { 0, 12 }, { 12, 12 } });
+
+    ControlClient client(server.Port(), kQueryTimeout);
+    NTP_CHECK(client.Variables(1) == data);
+}
+
+
+NTP_TEST(ControlClientIgnoresDuplicateFragments)
+{
+    // The first fragment arrives twice and the middle one never does: The byte count adds up, but the data has a gap.
+    const std::string data = "srcadr=192.0.2.1, stratum=2, offset=0.25";
+    const FragmentingServer server(data, Fragments{ { 0, 12 }, { 24, 16 }, { 0, 12 } });
+
+    ControlClient client(server.Port(), kQueryTimeout);
+    NTP_CHECK(!client.Variables(1));
+}
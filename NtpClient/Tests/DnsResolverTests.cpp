@@ -0,0 +1,280 @@
+/*
+    DnsResolverTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype> // For std::tolower.
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DnsResolver.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+
+
+    constexpr auto kTimeout = std::chrono::milliseconds(500);
+
+    using Names = std::map<std::string, std::string>; // Lowercase name (without the root dot) -> dotted quad.
+
+
+    // **** FakeDnsServer class ****
+
+    // A DNS server on 127.0.0.1 (on a port of the system's choosing) that answers A queries from a fixed table:
+    // One A record for a known name, NXDOMAIN for any other. Optionally, each answer is preceded by a forged one
+    // (wrong query ID, wrong address), as an off-path spoofer would send.
+    class FakeDnsServer final
+    {
+    public:
+
+        // Constructor: Answers the names, and nothing else.
+        explicit FakeDnsServer(const Names& names, const bool forge = false) : forge_(forge)
+        {
+            for (const auto& [name, address] : names) {
+                in_addr value{};
+                inet_pton(AF_INET, address.c_str(), &value);
+                names_[name] = value.s_addr;
+            }
+
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t address_size = sizeof(address);
+
+            socket_ = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (socket_ == INVALID_SOCKET || bind(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+                getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &address_size) == SOCKET_ERROR) {
+                return;
+            }
+
+            port_ = ntohs(address.sin_port);
+            thread_ = std::thread(&FakeDnsServer::Run, this);
+        }
+
+
+        // Destructor:
+        ~FakeDnsServer()
+        {
+            stop_ = true;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+
+            if (socket_ != INVALID_SOCKET) {
+                closesocket(socket_);
+            }
+        }
+
+        FakeDnsServer(const FakeDnsServer&) = delete;
+        FakeDnsServer& operator=(const FakeDnsServer&) = delete;
+
+
+        // The port the server listens on (0 if it could not bind).
+        [[nodiscard]] uint16_t Port() const { return port_; }
+
+
+        // Query IDs received so far (retransmissions included).
+        [[nodiscard]] std::vector<uint16_t> Ids() const
+        {
+            const std::lock_guard lock(mutex_);
+            return ids_;
+        }
+
+    private:
+
+        void Run()
+        {
+            constexpr int kPollTimeoutMs = 20;
+
+            detail::WSA wsa{};
+            WSAPOLLFD descriptor{};
+            descriptor.fd = socket_;
+            descriptor.events = POLLRDNORM;
+
+            std::array<uint8_t, 512> query{};
+            while (!stop_) {
+                if (WSAPoll(&descriptor, 1, kPollTimeoutMs) <= 0) {
+                    continue;
+                }
+
+                sockaddr_in client = {};
+                socklen_t client_size = sizeof(client);
+                const int bytes_received = recvfrom(socket_, reinterpret_cast<char*>(query.data()), static_cast<int>(query.size()), 0,
+                    reinterpret_cast<sockaddr*>(&client), &client_size);
+                if (bytes_received < 12) {
+                    continue;
+                }
+
+                // The question: Labels up to the root label, then QTYPE and QCLASS.
+                std::string name{};
+                size_t offset{ 12 };
+                while (offset < static_cast<size_t>(bytes_received) && query[offset] != 0) {
+                    if (!name.empty()) {
+                        name.push_back('.');
+                    }
+                    for (size_t i = 1; i <= query[offset]; ++i) {
+                        name.push_back(static_cast<char>(std::tolower(query[offset + i])));
+                    }
+                    offset += 1 + query[offset];
+                }
+                const size_t question_end = offset + 1 + 4;
+
+                const uint16_t id = static_cast<uint16_t>(query[0] << 8 | query[1]);
+                {
+                    const std::lock_guard lock(mutex_);
+                    ids_.push_back(id);
+                }
+
+                const auto found = names_.find(name);
+                if (forge_) {
+                    Answer(client, std::span<const uint8_t>(query.data(), question_end), static_cast<uint16_t>(id ^ 0x5A5A), htonl(0x0A000001));
+                }
+                Answer(client, std::span<const uint8_t>(query.data(), question_end), id, found != names_.end() ? found->second : 0);
+            }
+        }
+
+
+        // Send a reply with the query's question, and one A record (or NXDOMAIN, if address is 0).
+        void Answer(const sockaddr_in& client, const std::span<const uint8_t> question, const uint16_t id, const uint32_t address) const
+        {
+            std::vector<uint8_t> reply(question.begin(), question.end());
+            reply[0] = static_cast<uint8_t>(id >> 8);
+            reply[1] = static_cast<uint8_t>(id);
+            reply[2] = 0x81;                              // Response, recursion desired.
+            reply[3] = address != 0 ? 0x80 : 0x83;        // Recursion available; RCODE 0, or 3 (NXDOMAIN).
+            reply[7] = address != 0 ? 1 : 0;              // ANCOUNT
+
+            if (address != 0) {
+                const uint8_t record[] = { 0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4 }; // Name = the question's; A, IN, TTL 60, 4 bytes.
+                reply.insert(reply.end(), std::begin(record), std::end(record));
+                const auto bytes = reinterpret_cast<const uint8_t*>(&address);
+                reply.insert(reply.end(), bytes, bytes + 4);
+            }
+
+            sendto(socket_, reinterpret_cast<const char*>(reply.data()), static_cast<int>(reply.size()), 0,
+                reinterpret_cast<const sockaddr*>(&client), sizeof(client));
+        }
+
+
+        detail::WSA wsa_{};
+        std::map<std::string, uint32_t> names_{};
+        bool forge_{ false };
+        SOCKET socket_{ INVALID_SOCKET };
+        uint16_t port_{ 0 };
+        std::atomic<bool> stop_{ false };
+        mutable std::mutex mutex_{};
+        std::vector<uint16_t> ids_{};
+        std::thread thread_{};
+    };
+
+
+    uint32_t Address(const char* dotted_quad)
+    {
+        in_addr address{};
+        inet_pton(AF_INET, dotted_quad, &address);
+        return address.s_addr;
+    }
+
+}
+
+
+NTP_TEST(DnsResolverResolvesBatch)
+{
+    const FakeDnsServer server(Names{ { "a.test", "192.0.2.1" }, { "b.test", "192.0.2.2" } });
+    NTP_CHECK(server.Port() != 0);
+
+    DnsResolver resolver("127.0.0.1", server.Port());
+    NTP_CHECK(resolver.Error() == 0);
+
+    const auto answers = resolver.Resolve({ "a.test", "b.test", "missing.test", "198.51.100.7" }, kTimeout);
+    NTP_CHECK(answers.size() == 4);
+    NTP_CHECK(answers[0].hostname_ == "a.test" && answers[0].address_ == Address("192.0.2.1"));
+    NTP_CHECK(answers[1].address_ == Address("192.0.2.2"));
+    NTP_CHECK(answers[2].address_ == 0);                        // NXDOMAIN.
+    NTP_CHECK(answers[3].address_ == Address("198.51.100.7"));  // Dotted quad: No query.
+    NTP_CHECK(server.Ids().size() == 3);
+}
+
+
+NTP_TEST(DnsResolverAcceptsFullyQualifiedNames)
+{
+    const FakeDnsServer server(Names{ { "time.example", "192.0.2.3" } });
+    DnsResolver resolver("127.0.0.1", server.Port());
+
+    NTP_CHECK(resolver.Resolve("time.example.", kTimeout) == Address("192.0.2.3"));
+    NTP_CHECK(resolver.Resolve("TIME.Example.", kTimeout) == Address("192.0.2.3"));
+}
+
+
+NTP_TEST(DnsResolverIgnoresForgedReplies)
+{
+    const FakeDnsServer server(Names{ { "a.test", "192.0.2.1" } }, true);
+    DnsResolver resolver("127.0.0.1", server.Port());
+
+    NTP_CHECK(resolver.Resolve("a.test", kTimeout) == Address("192.0.2.1")); // Not the forged 10.0.0.1 that arrives first.
+}
+
+
+NTP_TEST(DnsResolverDrawsRandomQueryIds)
+{
+    const FakeDnsServer server(Names{});
+    DnsResolver resolver("127.0.0.1", server.Port());
+
+    std::vector<std::string> names{};
+    for (int i = 0; i < 16; ++i) {
+        names.push_back("n" + std::to_string(i) + ".test");
+    }
+    resolver.Resolve(names, kTimeout);
+
+    auto ids = server.Ids();
+    NTP_CHECK(ids.size() == names.size());
+
+    // Sequential IDs (one random start, then +1) would make every difference 1:
+    size_t sequential{ 0 };
+    std::sort(ids.begin(), ids.end());
+    for (size_t i = 1; i < ids.size(); ++i) {
+        sequential += ids[i] - ids[i - 1] == 1 ? 1 : 0;
+    }
+    NTP_CHECK(sequential < ids.size() / 2);
+}
+
+
+NTP_TEST(DnsResolverTimesOut)
+{
+    DnsResolver resolver("127.0.0.1", 9); // (The discard port: Nothing answers.)
+
+    const auto start = std::chrono::steady_clock::now();
+    NTP_CHECK(resolver.Resolve("a.test", std::chrono::milliseconds(100)) == 0);
+    NTP_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
@@ -0,0 +1,154 @@
+/*
+    HybridClockTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <thread>
+#include <vector>
+
+#include "HybridClock.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+
+    // A clock source the test sets by hand. (One instance per test at a time: The tests run one after another.)
+    struct ManualClock final
+    {
+        static inline Duration now_{ 0 };
+
+        [[nodiscard]] Duration Now() const { return now_; }
+    };
+
+    using Clock = HybridClock<ManualClock>;
+
+}
+
+
+NTP_TEST(HybridClockFollowsPhysicalTime)
+{
+    ManualClock::now_ = 1'700'000'000'000ms;
+    Clock clock{};
+
+    const HlcTimestamp first = clock.Now();
+    NTP_CHECK(first.Physical() == 1'700'000'000'000 && first.Logical() == 0);
+
+    const HlcTimestamp second = clock.Now(); // Same millisecond: The counter counts.
+    NTP_CHECK(second.Physical() == first.Physical() && second.Logical() == 1);
+
+    ManualClock::now_ += 5ms;
+    const HlcTimestamp third = clock.Now();
+    NTP_CHECK(third.Physical() == first.Physical() + 5 && third.Logical() == 0);
+}
+
+
+NTP_TEST(HybridClockNeverGoesBackwards)
+{
+    ManualClock::now_ = 1'700'000'000'000ms;
+    Clock clock{};
+    const HlcTimestamp before = clock.Now();
+
+    ManualClock::now_ -= 2s; // The physical clock is stepped back.
+    const HlcTimestamp after = clock.Now();
+    NTP_CHECK(after > before);
+    NTP_CHECK(after.Physical() == before.Physical() && after.Logical() == before.Logical() + 1);
+}
+
+
+NTP_TEST(HybridClockCounterCarries)
+{
+    ManualClock::now_ = 1'700'000'000'000ms;
+    Clock clock{};
+
+    HlcTimestamp last = clock.Now();
+    for (int i = 0; i < 70'000; ++i) { // More than 65536 timestamps in one millisecond.
+        const HlcTimestamp next = clock.Now();
+        NTP_CHECK(next > last);
+        last = next;
+    }
+    NTP_CHECK(last.Physical() == 1'700'000'000'001); // Ran ahead of the physical clock by one millisecond.
+}
+
+
+NTP_TEST(HybridClockMergeRespectsCausality)
+{
+    ManualClock::now_ = 1'700'000'000'000ms;
+    Clock clock{ 1s };
+
+    // A message from a clock 300 ms ahead: The receive event comes after the send event.
+    const HlcTimestamp remote = HlcTimestamp::Make(1'700'000'000'300, 7);
+    HlcTimestamp received{};
+    NTP_CHECK(clock.Merge(remote, received));
+    NTP_CHECK(received > remote);
+    NTP_CHECK(clock.Now() > received);
+
+    // A message from a clock an hour ahead is refused, and does not drag this clock along.
+    const HlcTimestamp broken = HlcTimestamp::Make(1'700'003'600'000, 0);
+    HlcTimestamp unchanged{};
+    NTP_CHECK(!clock.Merge(broken, unchanged));
+    NTP_CHECK(clock.Now() < broken);
+}
+
+
+NTP_TEST(HybridClockAppliesNtpOffset)
+{
+    ManualClock::now_ = 1'700'000'000'000ms;
+    Clock clock{};
+    clock.SetOffset(250ms);
+
+    NTP_CHECK(clock.Now().Physical() == 1'700'000'000'250);
+}
+
+
+NTP_TEST(HybridClockIsUniqueAcrossThreads)
+{
+    ManualClock::now_ = 1'700'000'000'000ms;
+    Clock clock{};
+
+    constexpr size_t kThreads = 4, kPerThread = 10'000;
+    std::vector<std::vector<uint64_t>> stamps(kThreads);
+    {
+        std::vector<std::jthread> threads{};
+        for (size_t t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&clock, &stamps, t] {
+                for (size_t i = 0; i < kPerThread; ++i) {
+                    stamps[t].push_back(clock.Now().value_);
+                }
+            });
+        }
+    }
+
+    std::vector<uint64_t> all{};
+    for (const auto& thread : stamps) {
+        NTP_CHECK(std::is_sorted(thread.begin(), thread.end())); // Increasing within each thread...
+        all.insert(all.end(), thread.begin(), thread.end());
+    }
+    std::sort(all.begin(), all.end());
+    NTP_CHECK(std::adjacent_find(all.begin(), all.end()) == all.end()); // ...and never issued twice.
+}
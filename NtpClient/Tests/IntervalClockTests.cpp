@@ -0,0 +1,134 @@
+/*
+    IntervalClockTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+
+#include "IntervalClock.h"
+#include "NtpEngine.h"
+#include "ScriptedTransport.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace ntp_client::test;
+    using namespace std::chrono_literals;
+
+
+    // **** ManualClock struct ****
+
+    // A clock source the test sets by hand. (Static: IntervalClock default-constructs its clock source.)
+    struct ManualClock final
+    {
+        static inline Duration now_{ 0 };
+
+        [[nodiscard]] Duration Now() const { return now_; }
+    };
+
+}
+
+
+NTP_TEST(IntervalClockEmptyBeforeFirstEstimate)
+{
+    ManualClock::now_ = 1'700'000'000s;
+    IntervalClock<ManualClock> clock{};
+
+    NTP_CHECK(!clock.Now());
+    NTP_CHECK(!clock.CommitWait(0s));
+
+    clock.Update(TimeEstimate{ false, ManualClock::now_, 1s, 1ms }); // Invalid: Ignored.
+    NTP_CHECK(!clock.Now());
+}
+
+
+NTP_TEST(IntervalClockWidensInHoldover)
+{
+    ManualClock::now_ = 1'700'000'000s;
+    IntervalClock<ManualClock> clock{};
+    clock.Update(TimeEstimate{ true, ManualClock::now_, 100ms, 2ms });
+
+    const auto now = clock.Now();
+    NTP_CHECK(now && now->earliest_ == ManualClock::now_ + 98ms && now->latest_ == ManualClock::now_ + 102ms);
+
+    // 1000 s without an update: The bound grows by 15 ppm (15 ms) on each side, and the midpoint follows the local clock.
+    ManualClock::now_ += 1000s;
+    const auto later = clock.Now();
+    NTP_CHECK(later && later->Width() == 4ms + 2 * DispersionGrowth(1000s));
+    NTP_CHECK(later->earliest_ == ManualClock::now_ + 100ms - 2ms - 15ms);
+
+    // An invalid estimate keeps the old one in holdover; a valid one resets the growth.
+    clock.Update(TimeEstimate{});
+    NTP_CHECK(clock.Now()->Width() == later->Width());
+    clock.Update(TimeEstimate{ true, ManualClock::now_, -5ms, 1ms });
+    NTP_CHECK(clock.Now()->earliest_ == ManualClock::now_ - 6ms && clock.Now()->Width() == 2ms);
+
+    // A local clock that went backwards does not shrink the bound below the estimate's own.
+    ManualClock::now_ -= 10s;
+    NTP_CHECK(clock.Now()->Width() == 2ms);
+}
+
+
+NTP_TEST(IntervalClockCommitWait)
+{
+    IntervalClock<> clock{};
+    clock.Update(TimeEstimate{ true, SystemClock{}.Now(), 0s, 5ms });
+
+    const auto start = std::chrono::steady_clock::now();
+    const Duration timestamp = clock.Now()->latest_;
+    NTP_CHECK(clock.CommitWait(timestamp));
+
+    NTP_CHECK(clock.Now()->earliest_ > timestamp);
+    NTP_CHECK(std::chrono::steady_clock::now() - start >= 10ms); // Twice the error bound.
+}
+
+
+NTP_TEST(IntervalClockEstimateExcludesFalseticker)
+{
+    // Three servers agree on +100 ms, one is 5 s off: It must neither move the offset nor widen the error bound,
+    // so the interval still contains the (scripted) true time.
+    constexpr uint16_t kPort = 0x7B00; // 123
+    ClientEngine<ScriptedTransport> engine{};
+    for (const uint32_t address : { 0x0A00000Au, 0x0B00000Au, 0x0C00000Au, 0x0D00000Au }) {
+        engine.AddServer(Endpoint{ address, kPort });
+        engine.GetTransport().SetScript(address, ServerScript{ .offset_ = address == 0x0D00000Au ? 5s : 100ms });
+    }
+
+    engine.Poll();
+    NTP_CHECK(engine.Process() == 4);
+
+    const TimeEstimate estimate = engine.Estimate();
+    NTP_CHECK(estimate.valid_);
+    NTP_CHECK(estimate.offset_ > 98ms && estimate.offset_ < 102ms);
+    NTP_CHECK(estimate.error_ < 50ms);
+    NTP_CHECK(engine.Synchronize().survivors_ == 3);
+
+    IntervalClock<> clock{};
+    clock.Update(estimate);
+    const Duration before = SystemClock{}.Now() + 100ms;
+    const auto now = clock.Now();
+    const Duration after = SystemClock{}.Now() + 100ms;
+    NTP_CHECK(now && now->earliest_ <= after && now->latest_ >= before);
+}
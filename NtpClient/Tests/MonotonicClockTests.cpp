@@ -0,0 +1,161 @@
+/*
+    MonotonicClockTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <thread>
+#include <vector>
+
+#include "MonotonicClock.h"
+#include "NtpEngine.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+
+    // The clock's correction: How far it is ahead of the system clock (to within the time between the two reads).
+    Duration Correction(const MonotonicClock& clock) { return clock.Now() - SystemClock{}.Now(); }
+
+
+    bool Near(const Duration value, const Duration expected, const Duration tolerance)
+    {
+        return value > expected - tolerance && value < expected + tolerance;
+    }
+
+
+    // **** SteppedSystemClock struct ****
+
+    // The system clock, stepped by step_ (as another time service, or the discipline mode, would step it).
+    struct SteppedSystemClock final
+    {
+        static inline Duration step_{ 0 };
+
+        static Duration Now() { return SystemClock{}.Now() + step_; }
+    };
+
+}
+
+
+NTP_TEST(MonotonicClockStartsAtTheSystemClock)
+{
+    const MonotonicClock clock{};
+    NTP_CHECK(Near(Correction(clock), 0s, 50ms));
+
+    Duration last = clock.Now();
+    for (int i = 0; i < 100'000; ++i) {
+        const Duration now = clock.Now();
+        NTP_CHECK(now >= last);
+        last = now;
+    }
+}
+
+
+NTP_TEST(MonotonicClockSlewsTowardTheOffset)
+{
+    // At 10% (100'000 ppm), a 20 ms correction takes 200 ms: Long enough to see it under way, short enough for a test.
+    MonotonicClock clock{ 100'000 };
+
+    clock.Update(20ms);
+    NTP_CHECK(Near(Correction(clock), 0s, 10ms)); // No jump.
+
+    std::this_thread::sleep_for(100ms);
+    const Duration halfway = Correction(clock);
+    NTP_CHECK(halfway > 1ms && halfway < 20ms + 5ms);
+
+    std::this_thread::sleep_for(300ms);
+    NTP_CHECK(Near(Correction(clock), 20ms, 5ms));
+
+    // Backwards: The clock slows down (at 90% of the nominal rate here) instead of going back.
+    const Duration before = clock.Now();
+    clock.Update(-20ms);
+    std::this_thread::sleep_for(100ms);
+    NTP_CHECK(clock.Now() > before);
+    std::this_thread::sleep_for(500ms);
+    NTP_CHECK(Near(Correction(clock), -20ms, 5ms));
+}
+
+
+NTP_TEST(MonotonicClockNeverDecreasesAcrossUpdates)
+{
+    // Readers on several threads while the offset swings back and forth: No thread ever sees time go back, and
+    // every reading taken after another thread's reading is not less than it.
+    constexpr size_t kReaders = 3;
+    MonotonicClock clock{ 500'000 };
+    std::atomic<bool> stop{ false };
+    std::atomic<size_t> backwards{ 0 };
+    std::atomic<int64_t> published{ 0 };
+
+    {
+        std::vector<std::jthread> readers{};
+        for (size_t i = 0; i < kReaders; ++i) {
+            readers.emplace_back([&] {
+                Duration last{ 0 };
+                while (!stop.load(std::memory_order_relaxed)) {
+                    const int64_t seen = published.load(std::memory_order_acquire); // Another thread's earlier reading.
+                    const Duration now = clock.Now();
+                    if (now < last || now.count() < seen) {
+                        ++backwards;
+                    }
+                    last = now;
+
+                    int64_t mark = published.load(std::memory_order_relaxed);
+                    while (mark < now.count() && !published.compare_exchange_weak(mark, now.count(), std::memory_order_release)) {
+                    }
+                }
+            });
+        }
+
+        for (int update = 0; update < 40; ++update) {
+            clock.Update(update % 2 == 0 ? 50ms : -50ms);
+            std::this_thread::sleep_for(5ms);
+        }
+        stop = true;
+    }
+
+    NTP_CHECK(backwards.load() == 0);
+}
+
+
+NTP_TEST(MonotonicClockIgnoresSystemClockSteps)
+{
+    // The system clock is stepped back 1 s after construction. A server that is right reports +1 s against it:
+    // Monotonic time must stay where it was (true time), not move 1 s ahead.
+    SteppedSystemClock::step_ = 0s;
+    MonotonicClock clock{ 100'000, &SteppedSystemClock::Now };
+
+    SteppedSystemClock::step_ = -1s;
+    clock.Update(1s);
+    std::this_thread::sleep_for(300ms); // (Enough to slew 30 ms, had the target moved.)
+    NTP_CHECK(Near(Correction(clock), 0s, 5ms));
+
+    // And a real correction measured against the stepped clock is still applied in full.
+    clock.Update(1s + 10ms);
+    std::this_thread::sleep_for(300ms);
+    NTP_CHECK(Near(Correction(clock), 10ms, 5ms));
+}
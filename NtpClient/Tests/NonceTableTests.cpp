@@ -0,0 +1,221 @@
+/*
+    NonceTableTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "NonceTable.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+
+    using Table = NonceTable<>;
+
+
+    Table::Request MakeRequest(const uint64_t nonce)
+    {
+        return Table::Request{ nonce, Timestamp::FromUint64(nonce * 3), static_cast<uint32_t>(nonce), static_cast<uint32_t>(nonce >> 32) };
+    }
+
+
+    // **** CountingAllocator class ****
+
+    // Counts the allocations made through it (and its rebound copies). (Not final: std::vector derives from it.)
+    template <typename T>
+    class CountingAllocator
+    {
+    public:
+
+        using value_type = T;
+
+        explicit CountingAllocator(size_t& allocations) : allocations_(&allocations) {}
+
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U>& other) : allocations_(other.allocations_) {}
+
+        T* allocate(const size_t count)
+        {
+            ++*allocations_;
+            return std::allocator<T>{}.allocate(count);
+        }
+
+        void deallocate(T* pointer, const size_t count) { std::allocator<T>{}.deallocate(pointer, count); }
+
+        template <typename U>
+        bool operator==(const CountingAllocator<U>& other) const { return allocations_ == other.allocations_; }
+
+        size_t* allocations_{ nullptr };
+    };
+
+}
+
+
+NTP_TEST(NonceTableInsertFindErase)
+{
+    Table table{};
+    NTP_CHECK(table.Find(42) == nullptr);
+
+    table.Insert(MakeRequest(42));
+    table.Insert(MakeRequest(7));
+    NTP_CHECK(table.Size() == 2);
+
+    const auto* request = table.Find(42);
+    NTP_CHECK(request != nullptr && request->sent_ == Timestamp::FromUint64(126) && request->peer_ == 42);
+    NTP_CHECK(table.Find(0) == nullptr);
+
+    table.Erase(42);
+    table.Erase(42); // (Absent: No effect.)
+    NTP_CHECK(table.Find(42) == nullptr && table.Find(7) != nullptr && table.Size() == 1);
+}
+
+
+NTP_TEST(NonceTableBackwardShiftKeepsClusters)
+{
+    // Nonces with the same low bits share a home slot (the table starts with 16 slots), so they form one cluster,
+    // and nonces homed at the last slots wrap around into it. Erasing from the middle must leave every other
+    // nonce reachable.
+    Table table{};
+    const uint64_t colliding[] = { 0x103, 0x203, 0x303, 0x403 }; // Home slot 3.
+    const uint64_t wrapping[] = { 0x10F, 0x20F };                // Home slot 15, then slot 0.
+    for (const uint64_t nonce : colliding) {
+        table.Insert(MakeRequest(nonce));
+    }
+    for (const uint64_t nonce : wrapping) {
+        table.Insert(MakeRequest(nonce));
+    }
+    table.Insert(MakeRequest(0x100)); // Home slot 0, taken by a wrapped nonce: Moves on to slot 1.
+
+    table.Erase(0x203);
+    table.Erase(0x10F); // Frees slot 15: The wrapped nonce must shift back into it, and 0x100 into slot 0.
+
+    for (const uint64_t nonce : { 0x103, 0x303, 0x403, 0x20F, 0x100 }) {
+        NTP_CHECK(table.Find(nonce) != nullptr);
+    }
+    NTP_CHECK(table.Find(0x203) == nullptr && table.Find(0x10F) == nullptr);
+    NTP_CHECK(table.Size() == 5);
+}
+
+
+NTP_TEST(NonceTableMatchesModelUnderChurn)
+{
+    // Many requests come and go (as in a long-running engine): The table must agree with a reference map throughout.
+    Table table{};
+    std::unordered_map<uint64_t, uint32_t> model{};
+    std::mt19937_64 random{ 1234 };
+
+    for (int step = 0; step < 100'000; ++step) {
+        const uint64_t nonce = (random() % 512) + 1; // (A small key space: Plenty of collisions and re-insertions.)
+        if (model.contains(nonce)) {
+            table.Erase(nonce);
+            model.erase(nonce);
+        }
+        else {
+            table.Insert(MakeRequest(nonce));
+            model.emplace(nonce, static_cast<uint32_t>(nonce));
+        }
+    }
+
+    NTP_CHECK(table.Size() == model.size());
+    for (uint64_t nonce = 1; nonce <= 512; ++nonce) {
+        const auto* request = table.Find(nonce);
+        NTP_CHECK((request != nullptr) == model.contains(nonce));
+        NTP_CHECK(request == nullptr || request->peer_ == model.at(nonce));
+    }
+}
+
+
+NTP_TEST(NonceTableUsesAllocator)
+{
+    using CountedTable = NonceTable<CountingAllocator<std::byte>>;
+
+    size_t allocations{ 0 };
+    CountedTable table{ CountingAllocator<std::byte>(allocations) };
+
+    for (uint64_t nonce = 1; nonce <= 100; ++nonce) {
+        table.Insert(CountedTable::Request{ nonce, Timestamp{}, 0, 0 });
+    }
+
+    NTP_CHECK(allocations > 0); // (16 slots, then doubled up to 256.)
+    NTP_CHECK(table.Find(100) != nullptr);
+}
+
+
+NTP_TEST(NewNonceIsRandomAndNonzero)
+{
+    std::set<uint64_t> nonces{};
+    for (int i = 0; i < 10'000; ++i) {
+        const uint64_t nonce = NewNonce();
+        NTP_CHECK(nonce != 0);
+        nonces.insert(nonce);
+    }
+
+    NTP_CHECK(nonces.size() == 10'000);
+}
+
+
+NTP_TEST(NonceTableChaCha20TestVector)
+{
+    // RFC 8439, section 2.3.2: Key 00:01:...:1f, nonce 00:00:00:09:00:00:00:4a:00:00:00:00, block counter 1.
+    const std::array<uint32_t, 16> expected{ 0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3, 0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+        0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9, 0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2 };
+
+    const auto block = detail::ChaCha20Block({ 0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c, 0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c },
+        1, { 0x09000000, 0x4a000000, 0 });
+    NTP_CHECK(block == expected);
+}
+
+
+NTP_TEST(NonceTableNoncesDifferAcrossThreads)
+{
+    // Each thread keys its own stream from the system generator: No two threads share a sequence.
+    std::array<std::vector<uint64_t>, 2> streams{};
+    {
+        std::vector<std::jthread> threads{};
+        for (auto& stream : streams) {
+            threads.emplace_back([&stream] {
+                for (int i = 0; i < 1000; ++i) {
+                    stream.push_back(NewNonce());
+                }
+            });
+        }
+    }
+
+    std::set<uint64_t> nonces(streams[0].begin(), streams[0].end());
+    nonces.insert(streams[1].begin(), streams[1].end());
+    NTP_CHECK(nonces.size() == 2000);
+
+    std::array<uint8_t, 64> bytes{};
+    SystemRandom(bytes);
+    NTP_CHECK(std::set<uint8_t>(bytes.begin(), bytes.end()).size() > 16); // (64 zero bytes, or a constant fill, would fail.)
+}
@@ -0,0 +1,214 @@
+/*
+    NtpCoreTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+
+#include "NtpCore.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+
+    // A sample with the given offset and delay, taken at time.
+    Sample MakeTestSample(const Duration offset, const Duration delay, const Duration time)
+    {
+        Sample sample{};
+        sample.offset_ = offset;
+        sample.delay_ = delay;
+        sample.dispersion_ = 1ms;
+        sample.time_ = time;
+        return sample;
+    }
+
+}
+
+
+NTP_TEST(NtpCoreCodecRoundTrips)
+{
+    NtpMessage message{};
+    message.leap_ = 1;
+    message.version_ = 4;
+    message.mode_ = 4;
+    message.stratum_ = 3;
+    message.poll_ = 6;
+    message.precision_ = static_cast<uint8_t>(-23);
+    message.root_delay_ = 0x00012345;
+    message.root_dispersion_ = 0x00000678;
+    std::copy_n("GPS", 4, message.ref_clock_id_);
+    message.ref_ = Timestamp{ 0xE8000001, 0x00000002 };
+    message.orig_ = Timestamp{ 0xE8000003, 0x00000004 };
+    message.rx_ = Timestamp{ 0xE8000005, 0x00000006 };
+    message.tx_ = Timestamp{ 0xE8000007, 0xFFFFFFFF };
+
+    const auto packet = message.Encode();
+    NTP_CHECK(packet[0] == (1 << 6 | 4 << 3 | 4));
+    NTP_CHECK(packet[1] == 3 && packet[2] == 6 && packet[3] == 0xE9);
+
+    const auto decoded = NtpMessage::Decode(packet);
+    NTP_CHECK(decoded.leap_ == 1 && decoded.version_ == 4 && decoded.mode_ == 4);
+    NTP_CHECK(decoded.stratum_ == 3 && decoded.poll_ == 6 && static_cast<int8_t>(decoded.precision_) == -23);
+    NTP_CHECK(decoded.root_delay_ == message.root_delay_ && decoded.root_dispersion_ == message.root_dispersion_);
+    NTP_CHECK(std::equal(std::begin(decoded.ref_clock_id_), std::end(decoded.ref_clock_id_), std::begin(message.ref_clock_id_)));
+    NTP_CHECK(decoded.ref_ == message.ref_ && decoded.orig_ == message.orig_ && decoded.rx_ == message.rx_ && decoded.tx_ == message.tx_);
+    NTP_CHECK(decoded.Encode() == packet);
+}
+
+
+NTP_TEST(NtpCoreTimestampConversions)
+{
+    const Duration time = 1'700'000'000s + 123'456'789ns;
+    const Timestamp timestamp = Timestamp::FromUnixTime(time);
+    NTP_CHECK(timestamp.ToTimeT() == 1'700'000'000);
+
+    const Duration back = timestamp.ToUnixTime();
+    NTP_CHECK(time - back >= 0ns && time - back <= 1ns); // (2^-32 s fractions: Truncation loses under a nanosecond.)
+
+    NTP_CHECK(Timestamp::FromUint64(timestamp.ToUint64()) == timestamp);
+    NTP_CHECK(Timestamp::FractionToDuration(0x80000000) == 500ms);
+}
+
+
+NTP_TEST(NtpCoreDifferenceIsSigned)
+{
+    const Timestamp a = Timestamp::FromUnixTime(1'700'000'000s);
+    const Timestamp b = Timestamp::FromUnixTime(1'700'000'000s + 1500ms);
+
+    NTP_CHECK(Difference(b, a) == 1500ms);
+    NTP_CHECK(Difference(a, b) == -1500ms);
+
+    // Across the era rollover (2036): The last half second of era 0 to the first half second of era 1.
+    NTP_CHECK(Difference(Timestamp{ 0, 0x80000000 }, Timestamp{ UINT32_MAX, 0x80000000 }) == 1s);
+}
+
+
+NTP_TEST(NtpCoreSampleFromAsymmetricRoundTrip)
+{
+    // Server 50 ms behind; 30 ms out, 10 ms back; 2 ms in the server. The asymmetry (10 ms) shows as an offset error
+    // of half the difference of the legs, and the delay excludes the server's processing time.
+    const Duration t1 = 1'700'000'000s;
+    const Duration t2 = t1 + 30ms - 50ms;
+    const Duration t3 = t2 + 2ms;
+    const Duration t4 = t3 + 10ms + 50ms;
+
+    const Sample sample = MakeSample(Timestamp::FromUnixTime(t1), Timestamp::FromUnixTime(t2), Timestamp::FromUnixTime(t3),
+        Timestamp::FromUnixTime(t4), -20, -20);
+
+    const auto near = [](const Duration a, const Duration b) { return a - b > -10ns && a - b < 10ns; };
+    NTP_CHECK(near(sample.offset_, -50ms + 10ms));
+    NTP_CHECK(near(sample.delay_, 40ms));
+    NTP_CHECK(sample.dispersion_ > 0ns);
+    NTP_CHECK(RootDistance(sample) == Distance(sample)); // (No root delay or dispersion.)
+}
+
+
+NTP_TEST(NtpCoreSampleSurvivesBogusPrecision)
+{
+    // Precision is a signed byte off the wire: The extremes must neither overflow nor shift out of range.
+    NTP_CHECK(Log2ToDuration(static_cast<int8_t>(0x80)) == Duration(0));                  // -128
+    NTP_CHECK(Log2ToDuration(static_cast<int8_t>(0x7F)) == std::chrono::seconds(1 << 30)); // 127, clamped to 30.
+    NTP_CHECK(Log2ToDuration(-20) == Duration(953));
+    NTP_CHECK(Log2ToDuration(0) == std::chrono::seconds(1));
+
+    NTP_CHECK(!ValidPrecision(static_cast<int8_t>(0x80)) && !ValidPrecision(static_cast<int8_t>(0x7F)) && !ValidPrecision(1));
+    NTP_CHECK(ValidPrecision(-32) && ValidPrecision(-20) && ValidPrecision(0));
+
+    const auto t1 = Timestamp::FromUnixTime(std::chrono::seconds(1'700'000'000));
+    const auto t4 = Timestamp::FromUnixTime(t1.ToUnixTime() + std::chrono::milliseconds(10));
+    for (const uint8_t precision : { uint8_t{ 0x80 }, uint8_t{ 0x7F } }) {
+        const Sample sample = MakeSample(t1, t1, t1, t4, static_cast<int8_t>(precision), -20);
+        NTP_CHECK(sample.dispersion_ > Duration(0));
+        NTP_CHECK(sample.delay_ > std::chrono::microseconds(9'999) && sample.delay_ < std::chrono::microseconds(10'001));
+    }
+}
+
+
+NTP_TEST(NtpCoreFilterPicksLowestDelay)
+{
+    ClockFilter<4> filter{};
+    NTP_CHECK(!filter.Best(0s));
+
+    filter.Add(MakeTestSample(10ms, 30ms, 1s));
+    filter.Add(MakeTestSample(2ms, 5ms, 2s));
+    filter.Add(MakeTestSample(8ms, 20ms, 3s));
+    NTP_CHECK(filter.Size() == 3);
+
+    const auto best = filter.Best(3s);
+    NTP_CHECK(best && best->offset_ == 2ms);
+    NTP_CHECK(best && best->dispersion_ > 1ms); // Aged since the sample was taken (1 s at 15 ppm).
+    NTP_CHECK(filter.Jitter(3s) > 0ns);
+
+    // Four more samples push the best one out of the 4-stage filter:
+    for (int i = 0; i < 4; ++i) {
+        filter.Add(MakeTestSample(7ms, 25ms, 4s + std::chrono::seconds(i)));
+    }
+    NTP_CHECK(filter.Size() == 4);
+    NTP_CHECK(filter.Best(8s)->offset_ == 7ms);
+    NTP_CHECK(filter.Jitter(8s) == 0ns);
+}
+
+
+NTP_TEST(NtpCoreSelectRejectsFalseticker)
+{
+    const std::array<Candidate, 5> candidates{ {
+        { 10ms, 4ms }, { 12ms, 4ms }, { 11ms, 4ms }, { 9ms, 4ms }, { -300ms, 4ms } } };
+
+    const Selection selection = Select(candidates);
+    NTP_CHECK(selection.valid_);
+    NTP_CHECK(selection.survivors_ == 4);
+    NTP_CHECK(selection.low_ <= 10ms && selection.high_ >= 11ms); // The intersection holds the truechimers' agreement...
+    NTP_CHECK(selection.low_ >= 5ms && selection.high_ <= 16ms);   // ...and not the falseticker.
+    NTP_CHECK(selection.offset_ > 9ms && selection.offset_ < 12ms);
+}
+
+
+NTP_TEST(NtpCoreSelectNeedsMajority)
+{
+    NTP_CHECK(!Select({}).valid_);
+
+    // Two servers that disagree: Neither can be the majority.
+    const std::array<Candidate, 2> split{ { { 0ms, 1ms }, { 100ms, 1ms } } };
+    NTP_CHECK(!Select(split).valid_);
+
+    // A lone server is its own majority.
+    const std::array<Candidate, 1> single{ { { 7ms, 2ms } } };
+    const Selection selection = Select(single);
+    NTP_CHECK(selection.valid_ && selection.survivors_ == 1 && selection.offset_ == 7ms);
+}
+
+
+NTP_TEST(NtpCoreSelectWeightsByDistance)
+{
+    // Both intervals overlap; the closer server (smaller distance) pulls the combined offset toward itself.
+    const std::array<Candidate, 2> candidates{ { { 0ms, 10ms }, { 6ms, 40ms } } };
+
+    const Selection selection = Select(candidates);
+    NTP_CHECK(selection.valid_ && selection.survivors_ == 2);
+    NTP_CHECK(selection.offset_ > 0ms && selection.offset_ < 3ms);
+}
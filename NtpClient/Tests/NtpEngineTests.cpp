@@ -0,0 +1,280 @@
+/*
+    NtpEngineTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <memory>
+
+#include "NtpEngine.h"
+#include "ScriptedTransport.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace ntp_client::test;
+    using namespace std::chrono_literals;
+
+    using Engine = ClientEngine<ScriptedTransport>;
+
+    constexpr uint32_t kServerA = 0x0A00000A; // 10.0.0.10, 10.0.0.11, 10.0.0.12 (network byte order).
+    constexpr uint32_t kServerB = 0x0B00000A;
+    constexpr uint32_t kServerC = 0x0C00000A;
+    constexpr uint16_t kPort = 0x7B00;        // 123
+
+
+    constexpr Endpoint Server(const uint32_t address) { return Endpoint{ address, kPort }; }
+
+
+    bool Near(const Duration value, const Duration expected) { return value > expected - 2ms && value < expected + 2ms; }
+
+
+    // **** CountingAllocator class ****
+
+    // Counts the allocations made through it (and its rebound copies). (Not final: std::vector derives from it.)
+    template <typename T>
+    class CountingAllocator
+    {
+    public:
+
+        using value_type = T;
+
+        explicit CountingAllocator(size_t& allocations) : allocations_(&allocations) {}
+
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U>& other) : allocations_(other.allocations_) {}
+
+        T* allocate(const size_t count)
+        {
+            ++*allocations_;
+            return std::allocator<T>{}.allocate(count);
+        }
+
+        void deallocate(T* pointer, const size_t count) { std::allocator<T>{}.deallocate(pointer, count); }
+
+        template <typename U>
+        bool operator==(const CountingAllocator<U>& other) const { return allocations_ == other.allocations_; }
+
+        size_t* allocations_{ nullptr };
+    };
+
+}
+
+
+NTP_TEST(NtpEngineAcceptsAndSelects)
+{
+    Engine engine{};
+    for (const uint32_t address : { kServerA, kServerB, kServerC }) {
+        engine.AddServer(Server(address));
+        engine.GetTransport().SetScript(address, ServerScript{ .offset_ = 250ms });
+    }
+
+    engine.Poll();
+    NTP_CHECK(engine.GetTransport().Sent() == 3);
+    NTP_CHECK(engine.Process() == 3);
+    NTP_CHECK(engine.Counters().accepted_ == 3 && engine.Counters().rejected_ == 0);
+
+    for (const auto& peer : engine.Peers()) {
+        NTP_CHECK(peer.reach_ == 1);
+        NTP_CHECK(peer.stratum_ == 2);
+        NTP_CHECK(peer.filter_.Size() == 1);
+    }
+
+    const Selection selection = engine.Synchronize();
+    NTP_CHECK(selection.valid_);
+    NTP_CHECK(selection.survivors_ == 3);
+    NTP_CHECK(Near(selection.offset_, 250ms));
+}
+
+
+NTP_TEST(NtpEngineRejectsDuplicateAndSpoofedReplies)
+{
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    engine.AddServer(Server(kServerB));
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .copies_ = 3 });
+    engine.GetTransport().SetScript(kServerB, ServerScript{ .from_address_ = kServerC }); // Answers from the wrong address.
+
+    engine.Poll();
+    NTP_CHECK(engine.Process() == 1);
+    NTP_CHECK(engine.Counters().received_ == 4);
+    NTP_CHECK(engine.Counters().accepted_ == 1);
+    NTP_CHECK(engine.Counters().rejected_ == 3); // Two copies, one spoof.
+    NTP_CHECK(engine.Peers()[0].filter_.Size() == 1);
+    NTP_CHECK(engine.Peers()[1].filter_.Size() == 0);
+}
+
+
+NTP_TEST(NtpEngineDenyKissStopsPolling)
+{
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .kiss_ = "DENY" });
+
+    NTP_CHECK(engine.Poll(0));
+    NTP_CHECK(engine.Process() == 0);
+    NTP_CHECK(engine.Counters().kisses_ == 1 && engine.Counters().rejected_ == 1);
+    NTP_CHECK(engine.Peers()[0].denied_);
+
+    NTP_CHECK(!engine.Poll(0));
+    engine.Burst(0, 4, 0s);
+    NTP_CHECK(engine.GetTransport().Sent() == 1);
+    NTP_CHECK(engine.Status().peers_[0].denied_ == 1);
+}
+
+
+NTP_TEST(NtpEngineRateKissEndsBurst)
+{
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .kiss_ = "RATE" });
+
+    engine.Burst(0, 4, 1h); // The first packet goes out now, three more are scheduled.
+    NTP_CHECK(engine.Peers()[0].burst_remaining_ == 3);
+    NTP_CHECK(engine.NextTimeout() != Duration::max());
+
+    engine.Process();
+    NTP_CHECK(engine.Counters().kisses_ == 1);
+    NTP_CHECK(engine.Peers()[0].burst_remaining_ == 0);
+    NTP_CHECK(!engine.Peers()[0].denied_); // Still polled, just less often.
+    NTP_CHECK(engine.NextTimeout() == Duration::max());
+}
+
+
+NTP_TEST(NtpEngineRejectsUnsynchronizedServers)
+{
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    engine.AddServer(Server(kServerB));
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .leap_ = 3 });
+    engine.GetTransport().SetScript(kServerB, ServerScript{ .stratum_ = 16 });
+
+    engine.Poll();
+    NTP_CHECK(engine.Process() == 0);
+    NTP_CHECK(engine.Counters().rejected_ == 2 && engine.Counters().kisses_ == 0);
+    NTP_CHECK(engine.Peers()[0].reach_ == 0 && engine.Peers()[1].reach_ == 0);
+    NTP_CHECK(!engine.Synchronize().valid_);
+}
+
+
+NTP_TEST(NtpEngineRejectsBogusPrecision)
+{
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    engine.AddServer(Server(kServerB));
+    engine.AddServer(Server(kServerC));
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .precision_ = static_cast<int8_t>(0x80) });
+    engine.GetTransport().SetScript(kServerB, ServerScript{ .precision_ = static_cast<int8_t>(0x7F) });
+    engine.GetTransport().SetScript(kServerC, ServerScript{ .precision_ = -32 });
+
+    engine.Poll();
+    NTP_CHECK(engine.Process() == 1);
+    NTP_CHECK(engine.Counters().rejected_ == 2);
+    NTP_CHECK(engine.Peers()[0].filter_.Size() == 0 && engine.Peers()[1].filter_.Size() == 0);
+    NTP_CHECK(engine.Peers()[2].filter_.Size() == 1);
+}
+
+
+NTP_TEST(NtpEngineRejectsZeroTransmitAndDistantServers)
+{
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    engine.AddServer(Server(kServerB));
+    engine.AddServer(Server(kServerC));
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .zero_transmit_ = true });
+    engine.GetTransport().SetScript(kServerB, ServerScript{ .root_dispersion_ = std::chrono::seconds(2) });
+    engine.GetTransport().SetScript(kServerC, ServerScript{ .root_dispersion_ = std::chrono::milliseconds(500) });
+
+    engine.Poll();
+    NTP_CHECK(engine.Process() == 1);
+    NTP_CHECK(engine.Counters().rejected_ == 2);
+    NTP_CHECK(engine.Peers()[0].filter_.Size() == 0 && engine.Peers()[1].filter_.Size() == 0);
+    NTP_CHECK(engine.Peers()[2].filter_.Size() == 1);
+
+    const TimeEstimate estimate = engine.Estimate();
+    NTP_CHECK(estimate.valid_);
+}
+
+
+NTP_TEST(NtpEngineReachShiftsUnansweredPolls)
+{
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    ServerScript script{};
+
+    const auto poll = [&](const bool answer) {
+        script.answer_ = answer;
+        engine.GetTransport().SetScript(kServerA, script);
+        engine.Poll(0);
+        engine.Process();
+    };
+
+    poll(true);
+    poll(false);
+    poll(false);
+    poll(true);
+    NTP_CHECK(engine.Peers()[0].reach_ == 0b1001);
+
+    for (int i = 0; i < 8; ++i) {
+        poll(false);
+    }
+    NTP_CHECK(engine.Peers()[0].reach_ == 0);
+    NTP_CHECK(engine.Counters().sent_ == 12 && engine.Counters().accepted_ == 2);
+}
+
+
+NTP_TEST(NtpEngineLateReplyToDroppedRequestIsRejected)
+{
+    // A peer keeps Peer::kMaxOutstanding requests in flight: Sending one more drops the oldest, and its reply is bogus.
+    Engine engine{};
+    engine.AddServer(Server(kServerA));
+    engine.GetTransport().SetScript(kServerA, ServerScript{});
+
+    for (size_t i = 0; i <= Engine::PeerType::kMaxOutstanding; ++i) {
+        engine.Poll(0);
+    }
+
+    NTP_CHECK(engine.Process() == Engine::PeerType::kMaxOutstanding);
+    NTP_CHECK(engine.Counters().rejected_ == 1);
+}
+
+
+NTP_TEST(NtpEngineUsesAllocator)
+{
+    size_t allocations{ 0 };
+    using Allocator = CountingAllocator<std::byte>;
+    ClientEngine<ScriptedTransport, SystemClock, NoAuthentication, 8, Allocator> engine{ Allocator(allocations) };
+
+    engine.AddServer(Server(kServerA));
+    engine.AddLocalRefId(0x0100007F);
+    const size_t after_setup = allocations;
+    NTP_CHECK(after_setup >= 3); // The peers, the address table and the local refids.
+
+    engine.GetTransport().SetScript(kServerA, ServerScript{});
+    engine.Poll();
+    NTP_CHECK(allocations > after_setup); // The table of requests in flight.
+    NTP_CHECK(engine.Process() == 1);
+}
@@ -0,0 +1,169 @@
+/*
+    RefIdTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <unordered_map>
+
+#include "NtpEngine.h"
+#include "RefId.h"
+#include "ScriptedTransport.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace ntp_client::test;
+
+    using Engine = ClientEngine<ScriptedTransport>;
+
+    constexpr uint32_t kServerA = 0x0A00000A; // 10.0.0.10, 10.0.0.11 (network byte order).
+    constexpr uint32_t kServerB = 0x0B00000A;
+    constexpr uint32_t kLocalAddress = 0x0100A8C0; // 192.168.0.1
+    constexpr uint16_t kPort = 0x7B00;        // 123
+
+
+    NtpMessage WithRefId(const uint8_t stratum, const char (&id)[5])
+    {
+        NtpMessage message{};
+        message.stratum_ = stratum;
+        std::copy_n(id, 4, message.ref_clock_id_);
+        return message;
+    }
+
+}
+
+
+NTP_TEST(RefIdDecodesInNetworkOrder)
+{
+    NtpMessage message{};
+    message.stratum_ = 2;
+    const uint8_t address[4] = { 192, 168, 0, 1 };
+    std::copy_n(address, 4, message.ref_clock_id_);
+
+    NTP_CHECK(RefId(message) == kLocalAddress); // The address as it appears in sockaddr_in.
+    NTP_CHECK(RefIdText(RefId(message), 2) == "192.168.0.1");
+
+    NTP_CHECK(RefIdText(RefId(WithRefId(1, "GPS\0")), 1) == "GPS");
+    NTP_CHECK(RefIdText(RefId(WithRefId(1, "PPS\x01")), 1) == "PPS."); // Non-printable.
+    NTP_CHECK(RefIdText(RefId(WithRefId(0, "RATE")), 0) == "RATE");
+    NTP_CHECK(RefIdText(0, 3) == "0.0.0.0");
+}
+
+
+NTP_TEST(RefIdKissCodes)
+{
+    NTP_CHECK(Kiss(WithRefId(0, "DENY")) == KissCode::kDeny);
+    NTP_CHECK(Kiss(WithRefId(0, "RSTR")) == KissCode::kRestrict);
+    NTP_CHECK(Kiss(WithRefId(0, "RATE")) == KissCode::kRate);
+    NTP_CHECK(Kiss(WithRefId(0, "INIT")) == KissCode::kOther);
+    NTP_CHECK(Kiss(WithRefId(0, "DENx")) == KissCode::kOther);
+    NTP_CHECK(Kiss(WithRefId(1, "DENY")) == KissCode::kNone); // Only stratum 0 is a kiss.
+    NTP_CHECK(Kiss(WithRefId(2, "RATE")) == KissCode::kNone);
+}
+
+
+NTP_TEST(RefIdIpv6Hash)
+{
+    // The first four bytes of the MD5 digest of the address (as ntpd computes them), in network order.
+    NTP_CHECK(Ipv6RefId({ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 }) == 0xC84D40CF);
+    NTP_CHECK(RefIdText(Ipv6RefId({ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 }), 2) == "207.64.77.200");
+    NTP_CHECK(Ipv6RefId({ 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 }) !=
+        Ipv6RefId({ 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2 }));
+}
+
+
+NTP_TEST(RefIdTableMatchesModel)
+{
+    RefIdTable<> table{};
+    std::unordered_map<uint32_t, uint32_t> model{};
+
+    table.Insert(0, 7); // Reserved: Ignored.
+    NTP_CHECK(table.Size() == 0 && !table.Contains(0));
+
+    // Adjacent addresses (the worst case for a weak hash) and a few far apart, through several growths.
+    for (uint32_t i = 1; i <= 1000; ++i) {
+        const uint32_t key = i % 3 == 0 ? i * 0x01000193u : i;
+        table.Insert(key, i);
+        model[key] = i;
+    }
+    table.Insert(5, 12345); // Replace.
+    model[5] = 12345;
+
+    NTP_CHECK(table.Size() == model.size());
+    for (const auto& [key, value] : model) {
+        const uint32_t* found = table.Find(key);
+        NTP_CHECK(found != nullptr && *found == value);
+    }
+    NTP_CHECK(table.Find(0xFFFFFFFF) == nullptr);
+    NTP_CHECK(!table.Contains(1001));
+}
+
+
+NTP_TEST(RefIdEngineRejectsLocalLoop)
+{
+    // A stratum 2 server synchronized to one of our addresses is a loop; a stratum 1 refid is a clock name, never one.
+    Engine engine{};
+    engine.AddLocalRefId(kLocalAddress);
+    engine.AddServer(Endpoint{ kServerA, kPort });
+    engine.AddServer(Endpoint{ kServerB, kPort });
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .stratum_ = 2, .refid_ = kLocalAddress });
+    engine.GetTransport().SetScript(kServerB, ServerScript{ .stratum_ = 1, .refid_ = kLocalAddress });
+
+    engine.Poll();
+    NTP_CHECK(engine.Process() == 1);
+    NTP_CHECK(engine.Counters().loops_ == 1);
+    NTP_CHECK(engine.Peers()[0].filter_.Size() == 0);
+    NTP_CHECK(engine.Peers()[1].filter_.Size() == 1);
+    NTP_CHECK(engine.Peers()[0].refid_ == kLocalAddress); // Kept, so ntpq-style status shows why.
+}
+
+
+NTP_TEST(RefIdEngineRejectsMutualPeerLoop)
+{
+    // A is synchronized to B and B to A: Once both refids are known, each reply is a loop.
+    Engine engine{};
+    engine.AddServer(Endpoint{ kServerA, kPort });
+    engine.AddServer(Endpoint{ kServerB, kPort });
+    engine.GetTransport().SetScript(kServerA, ServerScript{ .refid_ = kServerB });
+
+    engine.Poll(0);
+    NTP_CHECK(engine.Process() == 1); // B's refid is not known yet.
+
+    engine.GetTransport().SetScript(kServerB, ServerScript{ .refid_ = kServerA });
+    engine.Poll(1);
+    NTP_CHECK(engine.Process() == 0);
+    engine.Poll(0);
+    NTP_CHECK(engine.Process() == 0);
+    NTP_CHECK(engine.Counters().loops_ == 2);
+
+    // B moves to another upstream server: Once its new refid is known, A is usable again.
+    engine.GetTransport().SetScript(kServerB, ServerScript{ .refid_ = kLocalAddress });
+    engine.Poll(1);
+    engine.Poll(0);
+    NTP_CHECK(engine.Process() == 2);
+    NTP_CHECK(engine.Counters().loops_ == 2);
+}
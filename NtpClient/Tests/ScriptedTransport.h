@@ -0,0 +1,142 @@
+#ifndef AMITG_FC_SCRIPTED_TRANSPORT
+#define AMITG_FC_SCRIPTED_TRANSPORT
+
+/*
+    ScriptedTransport.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+// An in-memory network for ClientEngine tests: Each server answers from a script (stratum, refid, offset, copies...),
+// and the replies wait in a queue until the engine's Process() receives them.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <deque>
+#include <map>
+#include <span>
+#include <utility>
+
+#include "NtpEngine.h"
+
+
+namespace ntp_client::test
+{
+
+    // **** ServerScript struct ****
+
+    // How a scripted server answers. (The defaults: A synchronized stratum 2 server with the local clock's time.)
+    struct ServerScript final
+    {
+        bool answer_{ true };
+        uint8_t leap_{ 0 };
+        uint8_t stratum_{ 2 };
+        uint32_t refid_{ 0 };              // Network byte order (see RefId.h).
+        const char* kiss_{ nullptr };      // A kiss code ("DENY", "RATE"...): Sent at stratum 0 instead of a time.
+        Duration offset_{ 0 };             // Server time minus local time.
+        size_t copies_{ 1 };               // Each reply sent this many times.
+        uint32_t from_address_{ 0 };       // Nonzero: The replies claim to come from this address instead.
+        int8_t precision_{ -20 };          // log2 seconds.
+        Duration root_dispersion_{ 0 };    // Sent as NTP short format (16.16 seconds).
+        bool zero_transmit_{ false };      // The reply's transmit timestamp is left 0.
+    };
+
+
+    // **** ScriptedTransport class ****
+
+    class ScriptedTransport final
+    {
+    public:
+
+        void SetScript(const uint32_t address, const ServerScript& script) { scripts_[address] = script; }
+
+
+        bool Send(const Endpoint& to, const std::span<const uint8_t> datagram)
+        {
+            ++sent_;
+            const auto script = scripts_.find(to.address_);
+            if (script == scripts_.end() || !script->second.answer_) {
+                return true; // Lost.
+            }
+
+            NtpMessage::Packet header{};
+            std::copy_n(datagram.begin(), NtpMessage::kSize, header.begin());
+            const NtpMessage request = NtpMessage::Decode(header);
+            const ServerScript& server = script->second;
+
+            NtpMessage reply{};
+            reply.leap_ = server.leap_;
+            reply.version_ = 4;
+            reply.mode_ = 4; // Server
+            reply.stratum_ = server.kiss_ != nullptr ? 0 : server.stratum_;
+            reply.precision_ = static_cast<uint8_t>(server.precision_);
+            reply.root_dispersion_ = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(server.root_dispersion_).count() * 65536 / 1'000'000);
+            if (server.kiss_ != nullptr) {
+                std::copy_n(server.kiss_, 4, reply.ref_clock_id_);
+            }
+            else {
+                for (size_t i = 0; i < 4; ++i) {
+                    reply.ref_clock_id_[i] = static_cast<uint8_t>(server.refid_ >> (i * 8));
+                }
+            }
+            reply.orig_ = request.tx_;
+            reply.rx_ = Timestamp::FromUnixTime(clock_.Now() + server.offset_);
+            reply.tx_ = server.zero_transmit_ ? Timestamp{} : reply.rx_;
+
+            const Endpoint from{ server.from_address_ != 0 ? server.from_address_ : to.address_, to.port_ };
+            for (size_t i = 0; i < server.copies_; ++i) {
+                pending_.emplace_back(from, reply.Encode());
+            }
+            return true;
+        }
+
+
+        int Receive(const std::span<uint8_t> datagram, Endpoint& from)
+        {
+            if (pending_.empty()) {
+                return -1;
+            }
+
+            const auto& [source, packet] = pending_.front();
+            std::copy(packet.begin(), packet.end(), datagram.begin());
+            from = source;
+            pending_.pop_front();
+            return static_cast<int>(NtpMessage::kSize);
+        }
+
+
+        // Requests sent so far (answered or not).
+        [[nodiscard]] size_t Sent() const { return sent_; }
+
+    private:
+
+        SystemClock clock_{};
+        std::map<uint32_t, ServerScript> scripts_{};
+        std::deque<std::pair<Endpoint, NtpMessage::Packet>> pending_{};
+        size_t sent_{ 0 };
+    };
+
+}
+
+
+#endif
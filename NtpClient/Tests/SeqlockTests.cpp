@@ -0,0 +1,138 @@
+/*
+    SeqlockTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <cstdint> // For using uint32_t or similar types.
+#include <thread>
+#include <vector>
+
+#include "NtpEngine.h"
+#include "Seqlock.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+
+    // A snapshot whose words must always agree: Any mix of two writes shows up as a mismatch.
+    // (Odd-sized, so the last word is only partly used.)
+    struct Snapshot final
+    {
+        std::array<uint64_t, 9> words_{};
+        uint8_t tail_{ 0 };
+
+        [[nodiscard]] bool Consistent() const
+        {
+            for (const uint64_t word : words_) {
+                if (word != words_[0]) {
+                    return false;
+                }
+            }
+            return tail_ == static_cast<uint8_t>(words_[0]);
+        }
+    };
+
+
+    Snapshot MakeSnapshot(const uint64_t value)
+    {
+        Snapshot snapshot{};
+        snapshot.words_.fill(value);
+        snapshot.tail_ = static_cast<uint8_t>(value);
+        return snapshot;
+    }
+
+}
+
+
+NTP_TEST(SeqlockPublishesSnapshots)
+{
+    Seqlock<Snapshot> seqlock{};
+    NTP_CHECK(seqlock.Version() == 0);
+    NTP_CHECK(seqlock.Read().words_[0] == 0 && seqlock.Read().Consistent()); // Value-initialized.
+
+    seqlock.Publish(MakeSnapshot(41));
+    seqlock.Publish(MakeSnapshot(42));
+    NTP_CHECK(seqlock.Version() == 2);
+    NTP_CHECK(seqlock.Read().words_[8] == 42 && seqlock.Read().tail_ == 42);
+
+    // The engine status is the snapshot it was made for (see ControlServer.h).
+    Seqlock<EngineStatus> status{};
+    EngineStatus published{};
+    published.counters_.accepted_ = 7;
+    published.peer_count_ = 1;
+    published.peers_[0].refid_ = 0x0100007F;
+    status.Publish(published);
+    NTP_CHECK(status.Read().counters_.accepted_ == 7 && status.Read().peers_[0].refid_ == 0x0100007F);
+}
+
+
+NTP_TEST(SeqlockReadersNeverSeeTornSnapshots)
+{
+    constexpr size_t kReaders = 3;
+    Seqlock<Snapshot> seqlock{};
+    std::atomic<bool> stop{ false };
+    std::atomic<size_t> torn{ 0 };
+    std::atomic<size_t> backwards{ 0 };
+    std::atomic<size_t> reads{ 0 };
+
+    {
+        std::vector<std::jthread> readers{};
+        for (size_t i = 0; i < kReaders; ++i) {
+            readers.emplace_back([&] {
+                uint64_t last{ 0 };
+                while (!stop.load(std::memory_order_relaxed)) {
+                    const Snapshot snapshot = seqlock.Read();
+                    if (!snapshot.Consistent()) {
+                        ++torn;
+                    }
+                    if (snapshot.words_[0] < last) {
+                        ++backwards;
+                    }
+                    last = snapshot.words_[0];
+                    ++reads;
+                }
+            });
+        }
+
+        // The writer never waits for the readers (and yields, so they get to run on a single core).
+        const auto deadline = std::chrono::steady_clock::now() + 300ms;
+        for (uint64_t value = 1; std::chrono::steady_clock::now() < deadline; ++value) {
+            seqlock.Publish(MakeSnapshot(value));
+            if (value % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        stop = true;
+    }
+
+    NTP_CHECK(reads.load() > 0);
+    NTP_CHECK(torn.load() == 0);
+    NTP_CHECK(backwards.load() == 0);
+}
@@ -0,0 +1,150 @@
+/*
+    ShmReferenceTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <sstream>
+#include <thread>
+
+#include "ShmReference.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+
+    constexpr int kUnit = 7; // (A unit no SHM driver of the test machine is likely to use.)
+
+}
+
+
+NTP_TEST(ShmReadingIsConsumedOnce)
+{
+    ShmTime segment{};
+    NTP_CHECK(!ReadShm(segment)); // Zero-filled: No reading.
+
+    const Duration local = 1'700'000'000s + 123'456'789ns;
+    WriteShm(segment, local + 250us, local, -20);
+
+    const auto sample = ReadShm(segment);
+    NTP_CHECK(sample && sample->offset_ == 250us && sample->time_ == local);
+    NTP_CHECK(segment.clock_microseconds_ == 123'706 && segment.count_ == 2);
+    NTP_CHECK(!ReadShm(segment)); // valid_ was cleared.
+
+    WriteShm(segment, local - 1s, local, -20);
+    NTP_CHECK(ReadShm(segment)->offset_ == -1s);
+}
+
+
+NTP_TEST(ShmRejectsUnknownMode)
+{
+    ShmTime segment{};
+    WriteShm(segment, 10s, 9s, -20);
+
+    segment.mode_ = 0; // Mode 0 (no count protection) is not supported.
+    NTP_CHECK(!ReadShm(segment));
+    NTP_CHECK(segment.valid_ == 0);
+}
+
+
+NTP_TEST(ShmRejectsBogusPrecision)
+{
+    // The writer is another process: Its int32 precision is checked before it is narrowed to a log2 byte.
+    for (const int32_t precision : { 1000, -128, 127, 1, -33 }) { // (1000 would narrow to -24, a plausible value.)
+        ShmTime segment{};
+        WriteShm(segment, 10s, 9s, -20);
+        segment.precision_ = precision;
+        NTP_CHECK(!ReadShm(segment));
+    }
+
+    ShmTime segment{};
+    WriteShm(segment, 10s, 9s, -32);
+    NTP_CHECK(ReadShm(segment).has_value());
+}
+
+
+NTP_TEST(ShmConcurrentReadsAreNeverTorn)
+{
+    // Every record the writer stores has the same offset, so a read that mixed two records would show another one.
+    constexpr Duration kOffset = 3ms + 17ns;
+    ShmTime segment{};
+    std::atomic<bool> stop{ false };
+
+    std::thread writer([&] {
+        Duration local = 1'000'000'000s;
+        while (!stop.load(std::memory_order_relaxed)) {
+            local += 999'999'937ns; // (Changes the seconds and the fraction on most updates.)
+            WriteShm(segment, local + kOffset, local, -20);
+            std::this_thread::yield(); // (Lets the reader run on a single core too.)
+        }
+    });
+
+    size_t reads{ 0 }, wrong{ 0 };
+    // Read for 200 ms, and longer if no read got through yet (a loaded or single core machine).
+    const auto start = std::chrono::steady_clock::now();
+    for (auto now = start; now < start + 200ms || (reads == 0 && now < start + 10s); now = std::chrono::steady_clock::now()) {
+        if (const auto sample = ReadShm(segment)) {
+            ++reads;
+            wrong += sample->offset_ != kOffset ? 1 : 0;
+        }
+    }
+
+    stop = true;
+    writer.join();
+    NTP_CHECK(reads > 0);
+    NTP_CHECK(wrong == 0);
+}
+
+
+NTP_TEST(ShmWriterFeedsDriver)
+{
+    ShmWriter writer(kUnit);
+    ShmReferenceDriver driver(kUnit);
+
+    NTP_CHECK(writer.Write(5s + 40us, 5s));
+    const auto sample = driver.Poll();
+    NTP_CHECK(sample && sample->offset_ == 40us);
+    NTP_CHECK(!driver.Poll());
+}
+
+
+NTP_TEST(ShmStreamDriverSkipsMalformedLines)
+{
+    std::stringstream stream{};
+    stream << "1000 900\n" << "garbage 12\n" << "2000 x\n" << "3000 2500\n";
+    StreamReferenceDriver driver(stream);
+
+    NTP_CHECK(driver.Poll()->offset_ == 100ns);
+    NTP_CHECK(driver.Poll()->offset_ == 500ns); // Past both malformed lines.
+    NTP_CHECK(!driver.Poll());
+
+    // More data later (a pipe, a growing file).
+    stream << "4000 4001\n";
+    NTP_CHECK(driver.Poll()->offset_ == -1ns);
+    NTP_CHECK(!driver.Poll());
+}
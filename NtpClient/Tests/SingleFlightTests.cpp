@@ -0,0 +1,212 @@
+/*
+    SingleFlightTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstddef> // For size_t.
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "SingleFlight.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+    using Flights = SingleFlight<int, int>;
+
+    // How long a leader keeps its flight open once every caller has arrived, so the followers can join it.
+    constexpr auto kJoinTime = 200ms;
+
+
+    // Spin (politely) until condition holds, or give up after 10 s. Returns condition().
+    template <typename Condition>
+    bool WaitFor(const Condition& condition)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (!condition() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        return condition();
+    }
+
+}
+
+
+NTP_TEST(SingleFlightCoalescesConcurrentCalls)
+{
+    constexpr size_t kCallers = 8;
+    Flights flights{};
+    std::atomic<size_t> arrived{ 0 };
+    std::atomic<int> executions{ 0 };
+    std::vector<int> results(kCallers, 0);
+
+    {
+        std::vector<std::jthread> callers{};
+        for (size_t i = 0; i < kCallers; ++i) {
+            callers.emplace_back([&, i] {
+                ++arrived;
+                results[i] = flights.Call(7, [&] {
+                    const int execution = ++executions;
+                    WaitFor([&] { return arrived.load() == kCallers; });
+                    std::this_thread::sleep_for(kJoinTime);
+                    return execution;
+                });
+            });
+        }
+    }
+
+    NTP_CHECK(executions.load() == 1);
+    for (const int result : results) {
+        NTP_CHECK(result == 1);
+    }
+
+    // The key is free again: Nothing is cached.
+    NTP_CHECK(flights.Call(7, [&] { return ++executions; }) == 2);
+}
+
+
+NTP_TEST(SingleFlightSharesTheLeadersException)
+{
+    constexpr size_t kCallers = 4;
+    Flights flights{};
+    std::atomic<size_t> arrived{ 0 };
+    std::atomic<size_t> exceptions{ 0 };
+
+    {
+        std::vector<std::jthread> callers{};
+        for (size_t i = 0; i < kCallers; ++i) {
+            callers.emplace_back([&] {
+                ++arrived;
+                try {
+                    flights.Call(3, [&]() -> int {
+                        WaitFor([&] { return arrived.load() == kCallers; });
+                        std::this_thread::sleep_for(kJoinTime);
+                        throw std::runtime_error("server unreachable");
+                    });
+                }
+                catch (const std::runtime_error&) {
+                    ++exceptions;
+                }
+            });
+        }
+    }
+
+    NTP_CHECK(exceptions.load() == kCallers);
+    NTP_CHECK(flights.Call(3, [] { return 5; }) == 5); // Released after the exception.
+}
+
+
+NTP_TEST(SingleFlightFollowerStopsAndTimesOut)
+{
+    Flights flights{};
+    std::atomic<bool> release{ false };
+    std::atomic<bool> leading{ false };
+
+    std::jthread leader([&] {
+        flights.Call(1, [&] {
+            leading = true;
+            WaitFor([&] { return release.load(); });
+            return 1;
+        });
+    });
+    NTP_CHECK(WaitFor([&] { return leading.load(); }));
+
+    // A follower returns as soon as its own deadline passes (never running the function).
+    const auto start = std::chrono::steady_clock::now();
+    const auto timed_out = flights.Call(1, [](const std::stop_token&, Flights::Deadline) { return std::optional<int>(2); },
+        std::stop_token{}, start + 50ms);
+    NTP_CHECK(!timed_out);
+    NTP_CHECK(std::chrono::steady_clock::now() - start < 5s);
+
+    // ... or as soon as its own stop is requested.
+    std::stop_source stop{};
+    std::optional<int> stopped{ 0 };
+    std::jthread follower([&] {
+        stopped = flights.Call(1, [](const std::stop_token&, Flights::Deadline) { return std::optional<int>(2); },
+            stop.get_token(), Flights::Deadline::max());
+    });
+    std::this_thread::sleep_for(50ms);
+    stop.request_stop();
+    follower.join();
+    NTP_CHECK(!stopped);
+
+    release = true;
+}
+
+
+NTP_TEST(SingleFlightFollowersOutliveACancelledLeader)
+{
+    // The leader gives up (its stop is requested): The waiting follower starts over and leads a new flight.
+    Flights flights{};
+    std::stop_source leader_stop{};
+    std::atomic<bool> leading{ false };
+    std::optional<int> leader_result{ 0 };
+    std::optional<int> follower_result{};
+
+    std::jthread leader([&] {
+        leader_result = flights.Call(9, [&](const std::stop_token& stop, Flights::Deadline) {
+            leading = true;
+            WaitFor([&] { return stop.stop_requested(); });
+            return std::optional<int>{};
+        }, leader_stop.get_token(), Flights::Deadline::max());
+    });
+    NTP_CHECK(WaitFor([&] { return leading.load(); }));
+
+    std::jthread follower([&] {
+        follower_result = flights.Call(9, [](const std::stop_token&, Flights::Deadline) { return std::optional<int>(42); },
+            std::stop_token{}, Flights::Deadline::max());
+    });
+    std::this_thread::sleep_for(kJoinTime);
+    leader_stop.request_stop();
+    leader.join();
+    follower.join();
+
+    NTP_CHECK(!leader_result);
+    NTP_CHECK(follower_result == 42);
+}
+
+
+NTP_TEST(SingleFlightKeysAreIndependent)
+{
+    // A call for one key never waits for another key's flight (even in the same shard).
+    SingleFlight<int, int, 1> flights{};
+    std::atomic<bool> other_done{ false };
+    int first{ 0 };
+
+    std::jthread caller([&] {
+        first = flights.Call(1, [&] { return WaitFor([&] { return other_done.load(); }) ? 1 : -1; });
+    });
+
+    NTP_CHECK(flights.Call(2, [] { return 2; }) == 2);
+    other_done = true;
+    caller.join();
+    NTP_CHECK(first == 1);
+}
@@ -0,0 +1,236 @@
+/*
+    SweepTests.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "NtpEngine.h" // For SystemClock.
+#include "Sweep.h"
+#include "Test.h"
+
+
+namespace // (Anonymous namespace)
+{
+
+    using namespace ntp_client;
+    using namespace std::chrono_literals;
+
+
+    // **** FakeNtpServer class ****
+
+    // An NTP server on one loopback address that answers each request `copies` times, after a delay.
+    class FakeNtpServer final
+    {
+    public:
+
+        // Constructor: port 0 = any free port (see Port()).
+        FakeNtpServer(const char* address, const uint16_t port, const size_t copies = 1, const std::chrono::milliseconds delay = 0ms) :
+            copies_(copies), delay_(delay)
+        {
+            sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            inet_pton(AF_INET, address, &local.sin_addr);
+            local.sin_port = htons(port);
+            socklen_t local_size = sizeof(local);
+
+            socket_ = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (socket_ == INVALID_SOCKET || bind(socket_, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) == SOCKET_ERROR ||
+                getsockname(socket_, reinterpret_cast<sockaddr*>(&local), &local_size) == SOCKET_ERROR) {
+                return;
+            }
+
+            port_ = ntohs(local.sin_port);
+            thread_ = std::thread(&FakeNtpServer::Run, this);
+        }
+
+
+        // Destructor:
+        ~FakeNtpServer()
+        {
+            stop_ = true;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+
+            if (socket_ != INVALID_SOCKET) {
+                closesocket(socket_);
+            }
+        }
+
+        FakeNtpServer(const FakeNtpServer&) = delete;
+        FakeNtpServer& operator=(const FakeNtpServer&) = delete;
+
+
+        // The port the server listens on (0 if it could not bind).
+        [[nodiscard]] uint16_t Port() const { return port_; }
+
+    private:
+
+        void Run()
+        {
+            constexpr int kPollTimeoutMs = 20;
+
+            WSAPOLLFD descriptor{};
+            descriptor.fd = socket_;
+            descriptor.events = POLLRDNORM;
+
+            const SystemClock clock{};
+            std::array<uint8_t, 512> datagram{};
+            while (!stop_) {
+                if (WSAPoll(&descriptor, 1, kPollTimeoutMs) <= 0) {
+                    continue;
+                }
+
+                sockaddr_in client = {};
+                socklen_t client_size = sizeof(client);
+                if (recvfrom(socket_, reinterpret_cast<char*>(datagram.data()), static_cast<int>(datagram.size()), 0,
+                    reinterpret_cast<sockaddr*>(&client), &client_size) < static_cast<int>(NtpMessage::kSize)) {
+                    continue;
+                }
+
+                NtpMessage::Packet header{};
+                std::copy_n(datagram.begin(), NtpMessage::kSize, header.begin());
+                const NtpMessage request = NtpMessage::Decode(header);
+
+                std::this_thread::sleep_for(delay_);
+
+                NtpMessage reply{};
+                reply.version_ = request.version_;
+                reply.mode_ = 4; // Server
+                reply.stratum_ = 2;
+                reply.orig_ = request.tx_;
+                reply.rx_ = Timestamp::FromUnixTime(clock.Now());
+                reply.tx_ = reply.rx_;
+
+                const auto packet = reply.Encode();
+                for (size_t i = 0; i < copies_; ++i) {
+                    sendto(socket_, reinterpret_cast<const char*>(packet.data()), static_cast<int>(packet.size()), 0,
+                        reinterpret_cast<const sockaddr*>(&client), client_size);
+                }
+            }
+        }
+
+
+        detail::WSA wsa_{};
+        size_t copies_{ 1 };
+        std::chrono::milliseconds delay_{ 0 };
+        SOCKET socket_{ INVALID_SOCKET };
+        uint16_t port_{ 0 };
+        std::atomic<bool> stop_{ false };
+        std::thread thread_{};
+    };
+
+
+    uint32_t Address(const char* dotted_quad)
+    {
+        in_addr address{};
+        inet_pton(AF_INET, dotted_quad, &address);
+        return address.s_addr;
+    }
+
+}
+
+
+NTP_TEST(SweepEndsOnceEveryTargetReplied)
+{
+    const FakeNtpServer first("127.0.0.1", 0);
+    const FakeNtpServer second("127.0.0.2", first.Port());
+    NTP_CHECK(first.Port() != 0 && second.Port() != 0);
+
+    SweepOptions options{};
+    options.port_ = first.Port();
+    options.timeout_ = 5s;
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto results = Sweep({ Address("127.0.0.1"), Address("127.0.0.2") }, options);
+    NTP_CHECK(results.Replies() == 2);
+    NTP_CHECK(std::chrono::steady_clock::now() - start < 2s); // (Not the whole timeout.)
+}
+
+
+NTP_TEST(SweepWaitsForStragglersDespiteDuplicates)
+{
+    // The first target answers three times at once, the second one late: Three replies for two requests must not
+    // end the wait before the second target's reply.
+    const FakeNtpServer chatty("127.0.0.1", 0, 3);
+    const FakeNtpServer slow("127.0.0.2", chatty.Port(), 1, 150ms);
+
+    SweepOptions options{};
+    options.port_ = chatty.Port();
+    options.timeout_ = 600ms;
+
+    const auto results = Sweep({ Address("127.0.0.1"), Address("127.0.0.2") }, options);
+    NTP_CHECK(results.Replies() == 2);
+
+    std::mutex mutex{};
+    std::vector<uint32_t> replied{};
+    const std::vector<uint32_t> targets{ Address("127.0.0.1"), Address("127.0.0.2") };
+    size_t next{ 0 };
+    const size_t replies = Sweep([&](uint32_t& address) {
+        if (next == targets.size()) {
+            return false;
+        }
+        address = targets[next++];
+        return true;
+    }, [&](const SweepReply& reply) {
+        const std::lock_guard lock(mutex);
+        replied.push_back(reply.address_);
+    }, options);
+
+    NTP_CHECK(replies == 4); // (The streaming sweep reports every copy.)
+    NTP_CHECK(std::count(replied.begin(), replied.end(), Address("127.0.0.2")) == 1);
+}
+
+
+NTP_TEST(SweepUnwindsWhenTheTargetSourceThrows)
+{
+    // The exception reaches the caller (instead of leaving the delivery thread waiting, and the unwinding with it).
+    const FakeNtpServer server("127.0.0.1", 0);
+    SweepOptions options{};
+    options.port_ = server.Port();
+    options.timeout_ = 5s;
+
+    size_t next{ 0 };
+    bool thrown{ false };
+    try {
+        Sweep([&](uint32_t& address) {
+            if (next++ == 1) {
+                throw std::runtime_error("target list unreadable");
+            }
+            address = Address("127.0.0.1");
+            return true;
+        }, [](const SweepReply&) {}, options);
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+
+    NTP_CHECK(thrown);
+}
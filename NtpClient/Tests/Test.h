@@ -0,0 +1,115 @@
+#ifndef AMITG_FC_TEST
+#define AMITG_FC_TEST
+
+/*
+    Test.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+// A minimal test harness for NtpClientTests (no external framework): NTP_TEST defines and registers a test,
+// NTP_CHECK records a failed check (and the test carries on), and RunTests() runs the registered tests.
+
+#include <atomic>
+#include <cstddef> // For size_t.
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+
+namespace ntp_client::test
+{
+
+    using TestFunction = void (*)();
+
+
+    struct TestCase final
+    {
+        const char* name_{ nullptr };
+        TestFunction function_{ nullptr };
+    };
+
+
+    inline std::vector<TestCase>& Tests()
+    {
+        static std::vector<TestCase> tests{};
+        return tests;
+    }
+
+
+    inline std::atomic<size_t>& Failures()
+    {
+        static std::atomic<size_t> failures{ 0 };
+        return failures;
+    }
+
+
+    // **** Registration struct ****
+
+    // Adds a test to Tests() during static initialization (see NTP_TEST).
+    struct Registration final
+    {
+        // Constructor:
+        Registration(const char* name, const TestFunction function) { Tests().push_back(TestCase{ name, function }); }
+    };
+
+
+    // Record a failed check. Any thread (a test may check from the threads it starts).
+    inline void Check(const bool condition, const char* expression, const char* file, const int line)
+    {
+        if (!condition) {
+            Failures().fetch_add(1, std::memory_order_relaxed);
+            std::cerr << file << "(" << line << "): check failed: " << expression << "\n";
+        }
+    }
+
+
+    // Run every test whose name contains filter (all of them, if it is empty).
+    // Returns the number of failed checks.
+    inline size_t RunTests(const std::string_view filter)
+    {
+        size_t run{ 0 };
+        for (const TestCase& test : Tests()) {
+            if (!filter.empty() && std::string_view(test.name_).find(filter) == std::string_view::npos) {
+                continue;
+            }
+
+            const size_t failures = Failures().load();
+            test.function_();
+            std::cout << (Failures().load() == failures ? "pass  " : "FAIL  ") << test.name_ << "\n";
+            ++run;
+        }
+
+        std::cout << run << " tests, " << Failures().load() << " failed checks\n";
+        return Failures().load();
+    }
+
+}
+
+
+#define NTP_TEST(name) \
+    static void name(); \
+    static const ntp_client::test::Registration name##_registration{ #name, name }; \
+    static void name()
+
+#define NTP_CHECK(condition) ntp_client::test::Check((condition), #condition, __FILE__, __LINE__)
+
+
+#endif
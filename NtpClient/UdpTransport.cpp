@@ -0,0 +1,113 @@
+/*
+    UdpTransport.cpp
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "UdpTransport.h"
+
+
+namespace ntp_client
+{
+
+    // Constructor:
+    UdpTransport::UdpTransport()
+    {
+        if (wsa_.Error() != 0) {
+            error_ = wsa_.Error();
+            return;
+        }
+
+        socket_ = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP); // Creates a UDP socket
+        u_long non_blocking{ 1 };
+        if (socket_ == INVALID_SOCKET || ioctlsocket(socket_, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+            error_ = WSAGetLastError();
+        }
+    }
+
+
+    // Destructor:
+    UdpTransport::~UdpTransport()
+    {
+        if (socket_ != INVALID_SOCKET) {
+            closesocket(socket_);
+        }
+    }
+
+
+    // Send a datagram.
+    bool UdpTransport::Send(const Endpoint& to, const std::span<const uint8_t> datagram)
+    {
+        sockaddr_in address = {}; // Initializes the struct to its default values.
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = to.address_;
+        address.sin_port = to.port_;
+
+        if (sendto(socket_, reinterpret_cast<const char*>(datagram.data()), static_cast<int>(datagram.size()), 0,
+            reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+            [[maybe_unused]] const auto error{ WSAGetLastError() }; // For debug.
+            return false;
+        }
+
+        return true;
+    }
+
+
+    // Receive one pending datagram, without blocking.
+    int UdpTransport::Receive(const std::span<uint8_t> datagram, Endpoint& from)
+    {
+        for (;;) {
+            sockaddr_in address = {};
+            socklen_t address_size = sizeof(address);
+
+            const int bytes_received = recvfrom(socket_, reinterpret_cast<char*>(datagram.data()), static_cast<int>(datagram.size()), 0,
+                reinterpret_cast<sockaddr*>(&address), &address_size);
+
+            if (bytes_received != SOCKET_ERROR) {
+                from = Endpoint{ address.sin_addr.s_addr, address.sin_port };
+                return bytes_received;
+            }
+
+            // WSAECONNRESET: An ICMP port unreachable from an earlier send (Windows reports it on the next recvfrom).
+            // WSAEMSGSIZE: The datagram was larger than the buffer (it is discarded).
+            // The datagrams behind either are still readable. Anything else, including WSAEWOULDBLOCK, ends the batch.
+            if (const int error = WSAGetLastError(); error != WSAECONNRESET && error != WSAEMSGSIZE) {
+                return -1;
+            }
+        }
+    }
+
+
+    // Set the socket's send and receive buffer sizes.
+    bool UdpTransport::SetBufferSize(const int bytes)
+    {
+        const auto value = reinterpret_cast<const char*>(&bytes);
+        return setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, value, sizeof(bytes)) != SOCKET_ERROR &&
+            setsockopt(socket_, SOL_SOCKET, SO_SNDBUF, value, sizeof(bytes)) != SOCKET_ERROR;
+    }
+
+
+    // Block until a datagram is pending, the timeout expires, or a stop is requested.
+    bool UdpTransport::Wait(const std::chrono::microseconds timeout, const std::stop_token& stop) const
+    {
+        return WaitReadable(socket_, timeout, stop) == WaitResult::kReadable;
+    }
+
+}
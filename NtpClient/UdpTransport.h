@@ -0,0 +1,93 @@
+#ifndef AMITG_FC_UDPTRANSPORT
+#define AMITG_FC_UDPTRANSPORT
+
+/*
+    UdpTransport.h
+    Copyright (c) 2024, Amit Gefen
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <chrono>
+#include <cstdint> // For using uint32_t or similar types.
+#include <span>
+#include <stop_token>
+
+#include "Cancellation.h"
+#include "NtpEngine.h"
+#include "SocketApi.h"
+
+
+namespace ntp_client
+{
+
+    // **** UdpTransport class ****
+
+    // Winsock transport policy for ClientEngine: One non-blocking, unconnected UDP socket for all servers.
+    class UdpTransport final
+    {
+    public:
+
+        // Constructor:
+        UdpTransport();
+
+        // Destructor:
+        ~UdpTransport();
+
+        UdpTransport(const UdpTransport&) = delete;
+        UdpTransport& operator=(const UdpTransport&) = delete;
+
+
+        // Send a datagram. Return false on error.
+        bool Send(const Endpoint& to, std::span<const uint8_t> datagram);
+
+
+        // Receive one pending datagram, without blocking.
+        // Return the number of bytes received, -1 if nothing is pending (or on error).
+        int Receive(std::span<uint8_t> datagram, Endpoint& from);
+
+
+        // Set the socket's send and receive buffer sizes, so a burst of many replies is not dropped by the kernel.
+        bool SetBufferSize(int bytes);
+
+
+        // Block until a datagram is pending, the timeout expires, or a stop is requested (which wakes the wait at once).
+        // Return true if a datagram is pending.
+        bool Wait(std::chrono::microseconds timeout, const std::stop_token& stop = {}) const;
+
+
+        // The socket, for registering with an event loop (readable = Receive() has a datagram; see ClientEngine).
+        // The transport still owns it: Do not close it or change its mode.
+        [[nodiscard]] SOCKET Handle() const { return socket_; }
+
+
+        // Get Error: 0 if the socket is usable.
+        int Error() const { return error_; }
+
+    private:
+
+        detail::WSA wsa_{};
+        SOCKET socket_{ INVALID_SOCKET };
+        int error_{ 0 };
+    };
+
+}
+
+
+#endif
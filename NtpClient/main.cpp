@@ -1,16 +1,328 @@
 // NtpClient.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
 
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Benchmark.h"
+#include "ClockDiscipline.h"
+#include "ControlServer.h"
+#include "NtpEngine.h"
 #include "NtpClient.h"
+#include "Sweep.h"
+#include "SystemClockAdjuster.h"
+#include "UdpTransport.h"
 
 
-int main()
+namespace // (Anonymous namespace)
 {
+
+    constexpr auto kDisciplineUpdate = std::chrono::milliseconds(100); // How often a running slew is checked for its end.
+
+
+    // Synchronize against hostnames every interval, and feed each offset to a ClockController over clock.
+    // Rounds = 0: Run until the process is stopped.
+    // The dry run disciplines a SimulatedClock that starts out equal to the system clock: It advances with real time,
+    // and its own offset is the measured system clock offset minus the corrections it has applied so far.
+    template <typename ClockAdjuster>
+    void Discipline(ClockAdjuster& clock, const std::vector<std::string>& hostnames, const std::chrono::seconds interval, const size_t rounds)
+    {
+        constexpr bool kDryRun = std::is_same_v<ClockAdjuster, ntp_client::SimulatedClock>;
+        ntp_client::ClockController<ClockAdjuster> controller{ clock };
+        auto last = std::chrono::steady_clock::now();
+
+        // Let the controller end a running slew on time (and the simulated clock follow real time).
+        const auto update = [&] {
+            if constexpr (kDryRun) {
+                const auto now = std::chrono::steady_clock::now();
+                clock.Advance(now - last);
+                last = now;
+            }
+            controller.Update();
+        };
+
+        for (size_t round = 0; rounds == 0 || round < rounds; ++round) {
+            for (auto waited = std::chrono::steady_clock::duration(0); round > 0 && waited < interval; waited += kDisciplineUpdate) {
+                std::this_thread::sleep_for(kDisciplineUpdate);
+                update();
+            }
+
+            // A measurement takes seconds; the slew keeps being watched meanwhile.
+            auto measurement = std::async(std::launch::async, [&hostnames] { return ntp_client::Synchronize(hostnames); });
+            while (measurement.wait_for(kDisciplineUpdate) != std::future_status::ready) {
+                update();
+            }
+            update();
+
+            const auto offset = measurement.get();
+            if (!offset) {
+                std::cout << "no majority of the servers agree; clock left alone\n";
+                continue;
+            }
+
+            ntp_client::Duration correction = *offset;
+            if constexpr (kDryRun) {
+                correction -= clock.Error();
+            }
+
+            static constexpr const char* kActions[] = { "none", "slew", "step", "FAILED" };
+            std::cout << "offset " << std::chrono::duration_cast<std::chrono::microseconds>(correction).count() << " us: "
+                << kActions[static_cast<int>(controller.Apply(correction))] << "\n";
+        }
+    }
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    // Offline benchmarks (no network): NtpClient bench [accuracy|clocks|queue|engine]
+    if (argc > 1 && std::string_view(argv[1]) == "bench") {
+        const std::string_view which = argc > 2 ? argv[2] : "";
+        if (which.empty() || which == "accuracy") {
+            ntp_client::benchmark::RunAccuracyBenchmark(std::cout);
+        }
+        if (which.empty() || which == "clocks") {
+            ntp_client::benchmark::RunClockBenchmark(std::cout);
+        }
+        if (which.empty() || which == "queue") {
+            ntp_client::benchmark::RunQueueBenchmark(std::cout);
+        }
+        if (which.empty() || which == "engine") {
+            ntp_client::benchmark::RunEngineBenchmark(std::cout);
+        }
+        return 0;
+    }
+
+    // Monitoring sweep: NtpClient sweep [--rate <requests/s>] [--port <port>] [--out <file>] [--columnar <file>] [--stream] <address|cidr|hostname>...
+    // (--stream: Write each reply as it arrives, in constant memory, instead of one row per target at the end.)
+    if (argc > 1 && std::string_view(argv[1]) == "sweep") {
+        ntp_client::SweepOptions options{};
+        std::string output{}, columnar{};
+        bool stream{ false };
+        std::vector<std::string> specifications{};
+        for (int i = 2; i < argc; ++i) {
+            const std::string_view argument(argv[i]);
+            if (argument == "--rate" && i + 1 < argc) {
+                options.rate_ = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--port" && i + 1 < argc) {
+                options.port_ = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--out" && i + 1 < argc) {
+                output = argv[++i];
+            }
+            else if (argument == "--columnar" && i + 1 < argc) {
+                columnar = argv[++i];
+            }
+            else if (argument == "--stream") {
+                stream = true;
+            }
+            else {
+                specifications.emplace_back(argument);
+            }
+        }
+
+        if (stream) {
+            std::ofstream file{};
+            if (!output.empty()) {
+                file.open(output);
+            }
+            std::ostream& out = output.empty() ? std::cout : file;
+
+            ntp_client::TargetCursor cursor{ specifications, options.dns_timeout_ };
+            ntp_client::SweepReply::WriteTextHeader(out);
+            const size_t replies = ntp_client::Sweep([&cursor](uint32_t& address) { return cursor.Next(address); },
+                [&out](const ntp_client::SweepReply& reply) { reply.WriteText(out); }, options);
+            std::cerr << replies << " replies\n";
+            return 0;
+        }
+
+        const auto targets = ntp_client::ExpandTargets(specifications, options.dns_timeout_);
+        const auto results = ntp_client::Sweep(targets, options);
+        std::cerr << results.Replies() << " of " << results.Size() << " targets replied\n";
+
+        if (!columnar.empty()) {
+            std::ofstream file(columnar, std::ios::binary);
+            if (!results.WriteColumnar(file)) {
+                std::cerr << "cannot write " << columnar << "\n";
+                return 1;
+            }
+        }
+        else if (output.empty()) {
+            results.WriteText(std::cout);
+        }
+        else {
+            std::ofstream file(output);
+            results.WriteText(file);
+        }
+        return 0;
+    }
+
+    // Local test responder for sweeps: NtpClient respond <first address> <count> [port]
+    // (For example, "respond 127.0.0.1 1000 12300", then "sweep --port 12300 127.0.0.0/22" from another console.)
+    if (argc > 3 && std::string_view(argv[1]) == "respond") {
+        const auto port = static_cast<uint16_t>(argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 123);
+        ntp_client::LocalResponder responder(argv[2], std::strtoul(argv[3], nullptr, 10), port);
+        if (responder.Error() != 0) {
+            std::cerr << "cannot bind the responder addresses (error " << responder.Error() << ")\n";
+            return 1;
+        }
+
+        std::cout << "answering; press Enter to stop\n";
+        std::cin.get();
+        std::cout << responder.Answered() << " requests answered\n";
+        return 0;
+    }
+
+    // Long-running engine with a control channel: NtpClient serve [--interval <seconds>] [--control <port>] [--port <server port>] <address|hostname>...
+    // Polls the servers every interval (after an initial burst), and publishes a snapshot after each Process() for
+    // "NtpClient status <port>" (or ntpq) to query (control port 123 by default).
+    if (argc > 1 && std::string_view(argv[1]) == "serve") {
+        std::chrono::seconds interval{ 64 };
+        uint16_t control_port{ 123 }, server_port{ 123 };
+        std::vector<std::string> specifications{};
+        for (int i = 2; i < argc; ++i) {
+            const std::string_view argument(argv[i]);
+            if (argument == "--interval" && i + 1 < argc) {
+                interval = std::chrono::seconds(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--control" && i + 1 < argc) {
+                control_port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--port" && i + 1 < argc) {
+                server_port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else {
+                specifications.emplace_back(argument);
+            }
+        }
+        if (specifications.empty()) {
+            specifications = { "time.google.com", "time.facebook.com", "time.apple.com" };
+        }
+
+        ntp_client::detail::WSA wsa{};
+        ntp_client::ClientEngine<ntp_client::UdpTransport> engine{};
+        if (wsa.Error() != 0 || engine.GetTransport().Error() != 0) {
+            std::cerr << "cannot open the client socket\n";
+            return 1;
+        }
+
+        for (const uint32_t address : ntp_client::ExpandTargets(specifications, ntp_client::SweepOptions{}.dns_timeout_)) {
+            engine.AddServer(ntp_client::Endpoint{ address, htons(server_port) });
+        }
+        if (engine.Peers().empty()) {
+            std::cerr << "no server resolved\n";
+            return 1;
+        }
+
+        ntp_client::Seqlock<ntp_client::EngineStatus> status{};
+        ntp_client::ControlServer control{ status, control_port };
+        if (control.Error() != 0) {
+            std::cerr << "cannot bind the control port " << control_port << " (error " << control.Error() << ")\n";
+            return 1;
+        }
+
+        // The polling thread owns the engine; the control server only ever reads the published snapshots.
+        std::jthread poller([&engine, &status, interval](const std::stop_token& stop) {
+            constexpr auto kMaxWait = std::chrono::milliseconds(100); // How quickly a stop request is noticed.
+
+            for (size_t i = 0; i < engine.Peers().size(); ++i) {
+                engine.Burst(i, 4, std::chrono::seconds(2));
+            }
+            engine.SetPollInterval(interval);
+
+            while (!stop.stop_requested()) {
+                const auto wait = std::min<std::chrono::microseconds>(kMaxWait, std::chrono::ceil<std::chrono::microseconds>(engine.NextTimeout()));
+                const unsigned events = engine.GetTransport().Wait(wait, stop) ? ntp_client::kReadable : ntp_client::kNoEvents;
+                engine.Process(events | ntp_client::kTimeout);
+                status.Publish(engine.Status());
+            }
+        });
+
+        std::cout << "polling " << engine.Peers().size() << " servers; status on port " << control.Port() << "; press Enter to stop\n";
+        std::cin.get();
+        return 0;
+    }
+
+    // Query a running engine's control channel (see ControlServer.h): NtpClient status [port]
+    if (argc > 1 && std::string_view(argv[1]) == "status") {
+        ntp_client::ControlClient client(static_cast<uint16_t>(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 123));
+        const auto system = client.Variables(0);
+        const auto associations = client.Associations();
+        if (!system || !associations) {
+            std::cerr << "no answer from the control channel\n";
+            return 1;
+        }
+
+        std::cout << *system << "\n";
+        for (const auto association : *associations) {
+            std::cout << association << ": " << client.Variables(association).value_or("(no answer)") << "\n";
+        }
+        return 0;
+    }
+
+    // Host time daemon: NtpClient discipline [--dry-run] [--interval <seconds>] [--rounds <n>] <hostname>...
+    // Slews (or steps) the system clock toward the servers (elevated process required). --dry-run disciplines a
+    // simulated clock instead, and only prints what it would do.
+    if (argc > 1 && std::string_view(argv[1]) == "discipline") {
+        bool dry_run{ false };
+        std::chrono::seconds interval{ 64 };
+        size_t rounds{ 0 };
+        std::vector<std::string> hostnames{};
+        for (int i = 2; i < argc; ++i) {
+            const std::string_view argument(argv[i]);
+            if (argument == "--dry-run") {
+                dry_run = true;
+            }
+            else if (argument == "--interval" && i + 1 < argc) {
+                interval = std::chrono::seconds(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if (argument == "--rounds" && i + 1 < argc) {
+                rounds = std::strtoul(argv[++i], nullptr, 10);
+            }
+            else {
+                hostnames.emplace_back(argument);
+            }
+        }
+        if (hostnames.empty()) {
+            hostnames = { "time.google.com", "time.facebook.com", "time.apple.com" };
+        }
+
+        if (dry_run) {
+            ntp_client::SimulatedClock clock{ std::chrono::system_clock::now().time_since_epoch() };
+            Discipline(clock, hostnames, interval, rounds);
+            return 0;
+        }
+
+        ntp_client::SystemClockAdjuster clock{};
+        if (clock.Error() != 0) {
+            std::cerr << "cannot adjust the system clock (error " << clock.Error() << "); run elevated, or use --dry-run\n";
+            return 1;
+        }
+        Discipline(clock, hostnames, interval, rounds);
+        return 0;
+    }
+
     // Test NTP client:
     std::cout << "test ntp client (several hosts):\n";
     for (const auto& hostname : { "time.google.com", "time.facebook.com", "time.apple.com" }) {
         std::cout << ntp_client::GetTime(hostname) << " (host: " << hostname << ")\n";
     }
+
+    // Fastest answer at startup: Ask all of them at once, and take the first valid reply:
+    if (const auto offset = ntp_client::Race({ "time.google.com", "time.facebook.com", "time.apple.com" }); offset) {
+        std::cout << "race: local clock offset " << std::chrono::duration_cast<std::chrono::microseconds>(*offset).count() << " us\n";
+    }
+    else {
+        std::cout << "race: no valid reply\n";
+    }
 }
 